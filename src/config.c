@@ -32,6 +32,7 @@
 #include "cluster.h"
 
 #include "rock_statsd.h"
+#include "rock_read.h"
 
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -2381,6 +2382,28 @@ static int is_hash_max_rock_entries_valid(long long val, const char **err)
     return 1;
 }
 
+static int is_rock_evict_low_watermark_valid(long long val, const char **err)
+{
+    if (val < server.rock_evict_high_watermark)
+        return 1;
+
+    static char msg[128];
+    sprintf(msg, "rock-evict-low-watermark must be less than rock-evict-high-watermark which is %d", server.rock_evict_high_watermark);
+    *err = msg;
+    return 0;
+}
+
+static int is_rock_evict_high_watermark_valid(long long val, const char **err)
+{
+    if (val > server.rock_evict_low_watermark)
+        return 1;
+
+    static char msg[128];
+    sprintf(msg, "rock-evict-high-watermark must be greater than rock-evict-low-watermark which is %d", server.rock_evict_low_watermark);
+    *err = msg;
+    return 0;
+}
+
 /*
 static int is_least_free_mem_valid(long long val, const char **err)
 {
@@ -2568,6 +2591,21 @@ standardConfig configs[] = {
     createIntConfig("databases", NULL, IMMUTABLE_CONFIG, 1, INT_MAX, server.dbnum, 16, INTEGER_CONFIG, NULL, NULL),
     createIntConfig("port", NULL, MODIFIABLE_CONFIG, 0, 65535, server.port, 6379, INTEGER_CONFIG, NULL, updatePort), /* TCP port. */
     createIntConfig("io-threads", NULL, IMMUTABLE_CONFIG, 1, 128, server.io_threads_num, 1, INTEGER_CONFIG, NULL, NULL), /* Single threaded by default */
+    createIntConfig("rock-read-threads", NULL, IMMUTABLE_CONFIG, 1, ROCK_READ_MAX_THREADS, server.rock_read_threads_num, 4, INTEGER_CONFIG, NULL, NULL), /* RocksDB read threads */
+    createIntConfig("rock-read-batch-max", NULL, MODIFIABLE_CONFIG, 1, ROCK_READ_MAX_BATCH, server.rock_read_batch_max, 64, INTEGER_CONFIG, NULL, NULL), /* Max keys of one RocksDB multi get */
+    createBoolConfig("rock-warm-restart", NULL, IMMUTABLE_CONFIG, server.rock_warm_restart, 0, NULL, NULL), /* Reuse RocksDB folder after a clean shutdown */
+    createBoolConfig("rock-marshal-in-write-thread", NULL, MODIFIABLE_CONFIG, server.rock_marshal_in_write_thread, 0, NULL, NULL), /* Serialize evicted values in write thread */
+    createSizeTConfig("rock-write-ring-buffer-size", NULL, MODIFIABLE_CONFIG, 1<<20, LONG_MAX, server.rock_write_ring_buffer_size, 64<<20, MEMORY_CONFIG, NULL, NULL), /* Max bytes waiting for RocksDB write */
+    createIntConfig("rock-segment-entries", NULL, MODIFIABLE_CONFIG, 0, INT_MAX, server.rock_segment_entries, 0, INTEGER_CONFIG, NULL, NULL), /* Split big list/set/zset in RocksDB, 0 for disable */
+    createBoolConfig("rock-load-sst", NULL, MODIFIABLE_CONFIG, server.rock_load_sst, 1, NULL, NULL), /* Load RDB to RocksDB by SST file ingestion */
+    createBoolConfig("rock-repl-sst", NULL, MODIFIABLE_CONFIG, server.rock_repl_sst, 1, NULL, NULL), /* Full sync cold keys to RedRock replicas as rows of RocksDB */
+    createBoolConfig("rock-evict-size-aware", NULL, MODIFIABLE_CONFIG, server.rock_evict_size_aware, 0, NULL, NULL), /* Eviction considers the size of value besides LRU/LFU */
+    createIntConfig("rock-evict-low-watermark", NULL, MODIFIABLE_CONFIG, 10, 99, server.rock_evict_low_watermark, 90, INTEGER_CONFIG, is_rock_evict_low_watermark_valid, NULL), /* Eviction stops under the percent of maxrockmem */
+    createIntConfig("rock-evict-high-watermark", NULL, MODIFIABLE_CONFIG, 11, 100, server.rock_evict_high_watermark, 100, INTEGER_CONFIG, is_rock_evict_high_watermark_valid, NULL), /* Eviction starts over the percent of maxrockmem */
+    createIntConfig("rock-admit-min-freq", NULL, MODIFIABLE_CONFIG, 0, 15, server.rock_admit_min_freq, 2, INTEGER_CONFIG, NULL, NULL), /* Min estimated frequency of cold reads to stay in memory, 0 for disable */
+    createIntConfig("rock-prefetch-window", NULL, MODIFIABLE_CONFIG, 0, 1024, server.rock_prefetch_window, 64, INTEGER_CONFIG, NULL, NULL), /* Pipelined commands parsed ahead to prefetch rock keys, 0 for disable */
+    createSizeTConfig("rock-cache-size", NULL, MODIFIABLE_CONFIG, 0, LONG_MAX, server.rock_cache_size, 0, MEMORY_CONFIG, NULL, NULL), /* Max memory of the compressed cache of values in RocksDB, 0 for disable */
+    createIntConfig("rock-zstd-dict-size", NULL, IMMUTABLE_CONFIG, 0, 1<<20, server.rock_zstd_dict_size, 0, MEMORY_CONFIG, NULL, NULL), /* Max zstd dictionary of RocksDB compression, 0 for LZ4 without dictionary */
     createIntConfig("auto-aof-rewrite-percentage", NULL, MODIFIABLE_CONFIG, 0, INT_MAX, server.aof_rewrite_perc, 100, INTEGER_CONFIG, NULL, NULL),
     createIntConfig("cluster-replica-validity-factor", "cluster-slave-validity-factor", MODIFIABLE_CONFIG, 0, INT_MAX, server.cluster_slave_validity_factor, 10, INTEGER_CONFIG, NULL, NULL), /* Slave max data age factor. */
     createIntConfig("list-max-ziplist-size", NULL, MODIFIABLE_CONFIG, INT_MIN, INT_MAX, server.list_max_ziplist_size, -2, INTEGER_CONFIG, NULL, NULL),
@@ -2620,6 +2658,7 @@ standardConfig configs[] = {
     /* Unsigned Long Long configs */
     createULongLongConfig("maxmemory", NULL, IMMUTABLE_CONFIG, 0, ULLONG_MAX, server.maxmemory, 0, MEMORY_CONFIG, NULL, updateMaxmemory),
     createULongLongConfig("maxrockmem", NULL, MODIFIABLE_CONFIG, 0, ULLONG_MAX, server.maxrockmem, 0, MEMORY_CONFIG, NULL, NULL),
+    createULongLongConfig("rock-total-mem", NULL, IMMUTABLE_CONFIG, 0, ULLONG_MAX, server.rock_total_mem, 0, MEMORY_CONFIG, NULL, NULL), /* One budget for Redis and RocksDB memory, 0 for disable */
 
     /* Size_t configs */
     createSizeTConfig("hash-max-ziplist-entries", NULL, MODIFIABLE_CONFIG, 0, LONG_MAX, server.hash_max_ziplist_entries, 64, INTEGER_CONFIG, NULL, update_hash_max_ziplist_entries),
@@ -33,7 +33,7 @@
 
 #include "rock.h"
 #include "rock_hash.h"
-// #include "rock_write.h"
+#include "rock_write.h"
 #include "rock_evict.h"
 
 #include <signal.h>
@@ -71,8 +71,10 @@ robj *lookupKey(redisDb *db, robj *key, int flags) {
 
         /* Update the access time for the ageing algorithm.
          * Don't do it if we have a saving child, as this will trigger
-         * a copy on write madness. */
-        if (!hasActiveChildProcess() && !(flags & LOOKUP_NOTOUCH)){
+         * a copy on write madness.
+         * NOTE: rock value is a shared object, so do not touch it
+         *       (e.g., TOUCH or EXPIRE a key whose value is in RocksDB) */
+        if (!hasActiveChildProcess() && !(flags & LOOKUP_NOTOUCH) && !is_rock_value(val)){
             if (server.maxmemory_policy & MAXMEMORY_FLAG_LFU) {
                 updateLFU(val);
             } else {
@@ -164,7 +166,10 @@ robj *lookupKeyRead(redisDb *db, robj *key) {
  * does not exist in the specified DB. */
 robj *lookupKeyWriteWithFlags(redisDb *db, robj *key, int flags) {
     expireIfNeeded(db,key);
-    return lookupKey(db,key,flags);
+    robj *val = lookupKey(db,key,flags);
+    /* The value could be modified, so its record in RocksDB is stale. */
+    if (val) on_db_write_key_for_rock_evict(db->id, key->ptr);
+    return val;
 }
 
 robj *lookupKeyWrite(redisDb *db, robj *key) {
@@ -243,6 +248,9 @@ void dbOverwrite(redisDb *db, robj *key, robj *val) {
     if (old->type == OBJ_HASH &&  old->encoding == OBJ_ENCODING_HT)
         old_field_cnt = dictSize((dict*)old->ptr);
 
+    // NOTE: must before the old is released and before the rock hash
+    on_db_del_or_overwrite_for_rock_tombstone(db->id, key->ptr, old);
+
     if (server.maxmemory_policy & MAXMEMORY_FLAG_LFU) {
         val->lru = old->lru;
     }
@@ -338,8 +346,11 @@ int dbSyncDelete(redisDb *db, robj *key) {
     //             which can call dbAsyncDelete() or dbSyncDelete()
     //             and for loop for delGenericCommand() could repeat the keys
     //       Only the first time call to here guarantee the key exist in redis db
-    if (dictFind(db->dict, key->ptr))
+    dictEntry *de_exist = dictFind(db->dict, key->ptr);
+    if (de_exist)
     {
+        // NOTE: must before the rock hash
+        on_db_del_or_overwrite_for_rock_tombstone(db->id, key->ptr, dictGetVal(de_exist));
         on_del_key_from_db_for_rock_hash(db->id, key->ptr);
         on_db_del_key_for_rock_evict(db->id, key->ptr);
     }
@@ -480,7 +491,7 @@ long long emptyDb(int dbnum, int flags, void(callback)(void*)) {
     /* We need empty the relavant values for rock hash, rock write and rock read */
     on_empty_db_for_hash(dbnum);
     on_empty_db_for_rock_evict(dbnum);
-    // on_empty_db_for_rock_write(dbnum);
+    on_empty_db_for_rock_write(dbnum);
     // NOTE: We do not need deal with rock read
     // because all read task won't recover 
     // (including 1. key not eixist in new db.
@@ -516,6 +527,9 @@ dbBackup *backupDb(void) {
         backup->dbarray[i] = server.db[i];
         server.db[i].dict = dictCreate(&dbDictType,NULL);
         server.db[i].expires = dictCreate(&dbExpiresDictType,NULL);
+        /* The rock metadata of the keys goes with them */
+        on_backup_db_for_rock_evict(backup->dbarray+i, i);
+        on_backup_db_for_hash(backup->dbarray+i, i);
     }
 
     /* Backup cluster slots to keys map if enable cluster. */
@@ -545,6 +559,8 @@ void discardDbBackup(dbBackup *buckup, int flags, void(callback)(void*)) {
     for (int i=0; i<server.dbnum; i++) {
         dictRelease(buckup->dbarray[i].dict);
         dictRelease(buckup->dbarray[i].expires);
+        release_rock_evict_of_db(buckup->dbarray+i);
+        release_rock_hash_of_db(buckup->dbarray+i);
     }
 
     /* Release slots to keys map backup if enable cluster. */
@@ -570,6 +586,8 @@ void restoreDbBackup(dbBackup *buckup) {
         serverAssert(dictSize(server.db[i].expires) == 0);
         dictRelease(server.db[i].dict);
         dictRelease(server.db[i].expires);
+        release_rock_evict_of_db(server.db+i);
+        release_rock_hash_of_db(server.db+i);
         server.db[i] = buckup->dbarray[i];
     }
 
@@ -547,58 +547,33 @@ void expireGenericCommand(client *c, long long basetime, int unit) {
     }
 }
 
+/* NOTE: EXPIRE, EXPIREAT, PEXPIRE, PEXPIREAT, TTL, PTTL, PERSIST and TOUCH
+ *       have no rock_proc in the command table (like TYPE and EXISTS).
+ *       They only touch the key in db->dict and the expire in db->expires,
+ *       so the value can stay as a rock value and we do not need
+ *       read it from RocksDB (and evict it again later).
+ */
+
 /* EXPIRE key seconds */
 void expireCommand(client *c) {
     expireGenericCommand(c,mstime(),UNIT_SECONDS);
 }
 
-list* expire_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
-{
-    UNUSED(hash_keys);
-    UNUSED(hash_fields);
-
-    return generic_get_one_key_for_rock(c, 1);
-}
-
 /* EXPIREAT key time */
 void expireatCommand(client *c) {
     expireGenericCommand(c,0,UNIT_SECONDS);
 }
 
-list* expireat_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
-{
-    UNUSED(hash_keys);
-    UNUSED(hash_fields);
-
-    return generic_get_one_key_for_rock(c, 1);
-}
-
 /* PEXPIRE key milliseconds */
 void pexpireCommand(client *c) {
     expireGenericCommand(c,mstime(),UNIT_MILLISECONDS);
 }
 
-list* pexpire_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
-{
-    UNUSED(hash_keys);
-    UNUSED(hash_fields);
-
-    return generic_get_one_key_for_rock(c, 1);
-}
-
 /* PEXPIREAT key ms_time */
 void pexpireatCommand(client *c) {
     expireGenericCommand(c,0,UNIT_MILLISECONDS);
 }
 
-list* pexpireat_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
-{
-    UNUSED(hash_keys);
-    UNUSED(hash_fields);
-
-    return generic_get_one_key_for_rock(c, 1);
-}
-
 /* Implements TTL and PTTL */
 void ttlGenericCommand(client *c, int output_ms) {
     long long expire, ttl = -1;
@@ -627,27 +602,11 @@ void ttlCommand(client *c) {
     ttlGenericCommand(c, 0);
 }
 
-list* ttl_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
-{
-    UNUSED(hash_keys);
-    UNUSED(hash_fields);
-
-    return generic_get_one_key_for_rock(c, 1);
-}
-
 /* PTTL key */
 void pttlCommand(client *c) {
     ttlGenericCommand(c, 1);
 }
 
-list* pttl_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
-{
-    UNUSED(hash_keys);
-    UNUSED(hash_fields);
-
-    return generic_get_one_key_for_rock(c, 1);
-}
-
 /* PERSIST key */
 void persistCommand(client *c) {
     if (lookupKeyWrite(c->db,c->argv[1])) {
@@ -664,14 +623,6 @@ void persistCommand(client *c) {
     }
 }
 
-list* persist_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
-{
-    UNUSED(hash_keys);
-    UNUSED(hash_fields);
-
-    return generic_get_one_key_for_rock(c, 1);
-}
-
 /* TOUCH key1 [key2 key3 ... keyN] */
 void touchCommand(client *c) {
     int touched = 0;
@@ -680,11 +631,3 @@ void touchCommand(client *c) {
     addReplyLongLong(c,touched);
 }
 
-list* touch_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
-{
-    UNUSED(hash_keys);
-    UNUSED(hash_fields);
-
-    return generic_get_multi_keys_for_rock(c, 1, 1);
-}
-
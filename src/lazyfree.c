@@ -5,6 +5,7 @@
 
 #include "rock_hash.h"
 #include "rock_evict.h"
+#include "rock_write.h"
 
 static redisAtomic size_t lazyfree_objects = 0;
 static redisAtomic size_t lazyfreed_objects = 0;
@@ -154,8 +155,11 @@ int dbAsyncDelete(redisDb *db, robj *key) {
     //             which can call dbAsyncDelete() or dbSyncDelete()
     //             and for loop for delGenericCommand() could repeat the keys
     //       Only the first time call to here guarantee the key exist in redis db
-    if (dictFind(db->dict, key->ptr))
+    dictEntry *de_exist = dictFind(db->dict, key->ptr);
+    if (de_exist)
     {
+        // NOTE: must before the rock hash
+        on_db_del_or_overwrite_for_rock_tombstone(db->id, key->ptr, dictGetVal(de_exist));
         on_del_key_from_db_for_rock_hash(db->id, key->ptr);
         on_db_del_key_for_rock_evict(db->id, key->ptr);
     }
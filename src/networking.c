@@ -417,6 +417,9 @@ void addReplyErrorLength(client *c, const char *s, size_t len) {
 
 /* Do some actions after an error reply was sent (Log if needed, updates stats, etc.) */
 void afterErrorReply(client *c, const char *s, size_t len) {
+    /* The fake client of rock prefetch, the command will reply the error when processed */
+    if (is_rock_prefetch_client(c)) return;
+
     /* Increment the global error counter */
     server.stat_total_error_replies++;
     /* Increment the error stats
@@ -35,6 +35,8 @@
 
 #include "rock_rdb_aof.h"
 #include "rock.h"
+#include "rock_warm.h"
+#include "rock_load.h"
 
 #include <math.h>
 #include <fcntl.h>
@@ -1165,6 +1167,9 @@ int rdbSaveInfoAuxFields(rio *rdb, int rdbflags, rdbSaveInfo *rsi) {
             == -1) return -1;
     }
     if (rdbSaveAuxFieldStrInt(rdb,"aof-preamble",aof_preamble) == -1) return -1;
+    /* Only the final save of shutdown has the token. Check rock_warm.c */
+    char *warm_token = (char*)get_warm_restart_token();
+    if (warm_token && rdbSaveAuxFieldStrStr(rdb,"rock-warm",warm_token) == -1) return -1;
     return 1;
 }
 
@@ -1234,6 +1239,7 @@ int rdbSaveRio(rio *rdb, int *error, int rdbflags, rdbSaveInfo *rsi) {
     if (rdbWriteRaw(rdb,magic,9) == -1) goto werr;
     if (rdbSaveInfoAuxFields(rdb,rdbflags,rsi) == -1) goto werr;
     if (rdbSaveModulesAux(rdb, REDISMODULE_AUX_BEFORE_RDB) == -1) goto werr;
+    if (rdbflags & RDBFLAGS_ROCK_SST) on_start_rock_sst_in_child_process();
 
     for (j = 0; j < server.dbnum; j++) {
         redisDb *db = server.db+j;
@@ -1262,6 +1268,12 @@ int rdbSaveRio(rio *rdb, int *error, int rdbflags, rdbSaveInfo *rsi) {
             initStaticStringObject(key,keystr);
             expire = getExpire(db,&key);
 
+            if ((rdbflags & RDBFLAGS_ROCK_SST) && is_rock_value(o)) {
+                // the value will be sent as rows of RocksDB by rdb_save_rock_rows()
+                if (rdb_save_rock_cold_key(rdb, j, &key, o, expire) == -1) goto werr;
+                continue;
+            }
+
             robj *check_o = get_value_if_exist_in_rock_for_rdb_afo(o, j, keystr);
             // if (rdbSaveKeyValuePair(rdb,&key,o,expire) == -1) goto werr;
             if (rdbSaveKeyValuePair(rdb, &key, check_o, expire) == -1)
@@ -1320,6 +1332,7 @@ int rdbSaveRio(rio *rdb, int *error, int rdbflags, rdbSaveInfo *rsi) {
     }
 
     if (rdbSaveModulesAux(rdb, REDISMODULE_AUX_AFTER_RDB) == -1) goto werr;
+    if ((rdbflags & RDBFLAGS_ROCK_SST) && rdb_save_rock_rows(rdb) == -1) goto werr;
 
     /* EOF opcode */
     if (rdbSaveType(rdb,RDB_OPCODE_EOF) == -1) goto werr;
@@ -1345,7 +1358,7 @@ werr:
  * While the suffix is the 40 bytes hex string we announced in the prefix.
  * This way processes receiving the payload can understand when it ends
  * without doing any processing of the content. */
-int rdbSaveRioWithEOFMark(rio *rdb, int *error, rdbSaveInfo *rsi) {
+int rdbSaveRioWithEOFMark(rio *rdb, int *error, int rdbflags, rdbSaveInfo *rsi) {
     char eofmark[RDB_EOF_MARK_SIZE];
 
     startSaving(RDBFLAGS_REPLICATION);
@@ -1354,7 +1367,7 @@ int rdbSaveRioWithEOFMark(rio *rdb, int *error, rdbSaveInfo *rsi) {
     if (rioWrite(rdb,"$EOF:",5) == 0) goto werr;
     if (rioWrite(rdb,eofmark,RDB_EOF_MARK_SIZE) == 0) goto werr;
     if (rioWrite(rdb,"\r\n",2) == 0) goto werr;
-    if (rdbSaveRio(rdb,error,RDBFLAGS_NONE,rsi) == C_ERR) goto werr;
+    if (rdbSaveRio(rdb,error,rdbflags,rsi) == C_ERR) goto werr;
     if (rioWrite(rdb,eofmark,RDB_EOF_MARK_SIZE) == 0) goto werr;
     stopSaving(1);
     return C_OK;
@@ -2408,6 +2421,18 @@ int rdbLoadRio(rio *rdb, int rdbflags, rdbSaveInfo *rsi) {
             if ((qword = rdbLoadLen(rdb,NULL)) == RDB_LENERR) goto eoferr;
             lru_idle = qword;
             continue; /* Read next opcode. */
+        } else if (type == RDB_OPCODE_ROCK_COLD) {
+            /* ROCK_COLD: a key of RedRock master whose value is in RocksDB. */
+            if (rdb_load_rock_cold_key(rdb,db,rdbflags,expiretime) == -1)
+                goto eoferr;
+            expiretime = -1;
+            lfu_freq = -1;
+            lru_idle = -1;
+            continue; /* Read next opcode. */
+        } else if (type == RDB_OPCODE_ROCK_ROW) {
+            /* ROCK_ROW: a row of RocksDB of RedRock master for ROCK_COLD keys. */
+            if (rdb_load_rock_row(rdb) == -1) goto eoferr;
+            continue; /* Read next opcode. */
         } else if (type == RDB_OPCODE_EOF) {
             /* EOF: End of file, exit the main loop. */
             break;
@@ -2485,6 +2510,8 @@ int rdbLoadRio(rio *rdb, int rdbflags, rdbSaveInfo *rsi) {
                 if (haspreamble) serverLog(LL_NOTICE,"RDB has an AOF tail");
             } else if (!strcasecmp(auxkey->ptr,"redis-bits")) {
                 /* Just ignored. */
+            } else if (!strcasecmp(auxkey->ptr,"rock-warm")) {
+                on_rdb_aux_for_warm_restart(auxval->ptr, rdbflags);
             } else {
                 /* We ignore fields we don't understand, as by AUX field
                  * contract. */
@@ -2575,8 +2602,9 @@ int rdbLoadRio(rio *rdb, int rdbflags, rdbSaveInfo *rsi) {
             robj keyobj;
             initStaticStringObject(keyobj,key);
 
-            robj *replaced_val = NULL;
-            if (zmalloc_used_memory() > get_max_rock_mem_of_os())
+            /* For warm restart, the key may be already in RocksDB */
+            robj *replaced_val = db_add_warm_rockval_when_load_rdb(db, key, val, rdbflags, &keyobj);
+            if (replaced_val == NULL && zmalloc_used_memory() > get_max_rock_mem_of_os())
             {
                 // If free mem of OS is not enough, we need add the val as rock value
                 replaced_val = db_add_rockval_when_load_rdb(db, key, val, rdbflags, &keyobj);
@@ -2645,6 +2673,9 @@ int rdbLoadRio(rio *rdb, int rdbflags, rdbSaveInfo *rsi) {
         lfu_freq = -1;
         lru_idle = -1;
     }
+    finish_rock_load();     // for RedRock, the keys loaded to RocksDB by SST files
+    release_skipped_rock_cold_keys();
+
     /* Verify the checksum if RDB version is >= 5 */
     if (rdbver >= 5) {
         uint64_t cksum, expected = rdb->cksum;
@@ -2671,6 +2702,8 @@ int rdbLoadRio(rio *rdb, int rdbflags, rdbSaveInfo *rsi) {
      * the RDB file from a socket during initial SYNC (diskless replica mode),
      * we'll report the error to the caller, so that we can retry. */
 eoferr:
+    finish_rock_load();     // for RedRock
+    release_skipped_rock_cold_keys();
     serverLog(LL_WARNING,
         "Short read or OOM loading DB. Unrecoverable error, aborting now.");
     rdbReportReadError("Unexpected EOF reading RDB file");
@@ -2831,10 +2864,13 @@ int rdbSaveToSlavesSockets(rdbSaveInfo *rsi) {
     server.rdb_pipe_conns = zmalloc(sizeof(connection *)*listLength(server.slaves));
     server.rdb_pipe_numconns = 0;
     server.rdb_pipe_numconns_writing = 0;
+    /* Cold keys are sent as rows of RocksDB only if all the target replicas are RedRock. */
+    int rdbflags = server.rock_repl_sst ? RDBFLAGS_ROCK_SST : RDBFLAGS_NONE;
     listRewind(server.slaves,&li);
     while((ln = listNext(&li))) {
         client *slave = ln->value;
         if (slave->replstate == SLAVE_STATE_WAIT_BGSAVE_START) {
+            if (!(slave->slave_capa & SLAVE_CAPA_ROCK_SST)) rdbflags = RDBFLAGS_NONE;
             server.rdb_pipe_conns[server.rdb_pipe_numconns++] = slave->conn;
             replicationSetupSlaveForFullResync(slave,getPsyncInitialOffset());
         }
@@ -2851,7 +2887,7 @@ int rdbSaveToSlavesSockets(rdbSaveInfo *rsi) {
         redisSetProcTitle("redis-rdb-to-slaves");
         redisSetCpuAffinity(server.bgsave_cpulist);
 
-        retval = rdbSaveRioWithEOFMark(&rdb,NULL,rsi);
+        retval = rdbSaveRioWithEOFMark(&rdb,NULL,rdbflags,rsi);
         if (retval == C_OK && rioFlush(&rdb) == 0)
             retval = C_ERR;
 
@@ -32,6 +32,7 @@
 #include "server.h"
 #include "cluster.h"
 #include "bio.h"
+#include "rock_evict.h"
 
 #include <sys/time.h>
 #include <unistd.h>
@@ -955,6 +956,8 @@ void replconfCommand(client *c) {
                 c->slave_capa |= SLAVE_CAPA_EOF;
             else if (!strcasecmp(c->argv[j+1]->ptr,"psync2"))
                 c->slave_capa |= SLAVE_CAPA_PSYNC2;
+            else if (!strcasecmp(c->argv[j+1]->ptr,"rock-sst-v2"))
+                c->slave_capa |= SLAVE_CAPA_ROCK_SST;
         } else if (!strcasecmp(c->argv[j]->ptr,"ack")) {
             /* REPLCONF ACK is used by slave to inform the master the amount
              * of replication stream that it processed so far. It is an
@@ -1517,8 +1520,19 @@ static int useDisklessLoad() {
 
 /* Helper function for readSyncBulkPayload() to make backups of the current
  * databases before socket-loading the new ones. The backups may be restored
- * by disklessLoadRestoreBackup or freed by disklessLoadDiscardBackup later. */
+ * by disklessLoadRestoreBackup or freed by disklessLoadDiscardBackup later.
+ *
+ * For rock, the values in RocksDB can not be backed up, because the new
+ * data are loaded (and evicted) to the same rock keys in RocksDB. So if any
+ * value is in RocksDB, no backup is made (NULL is returned) and the old data
+ * is flushed like repl-diskless-load on-empty-db. */
 dbBackup *disklessLoadMakeBackup(void) {
+    if (has_rock_value_in_disk()) {
+        serverLog(LL_WARNING,
+            "MASTER <-> REPLICA sync: Some values are in RocksDB, "
+            "the current data can not be backed up for swapdb and is flushed");
+        return NULL;
+    }
     return backupDb();
 }
 
@@ -1764,7 +1778,7 @@ void readSyncBulkPayload(connection *conn) {
              * an empty replica. */
             emptyDb(-1,empty_db_flags,replicationEmptyDbCallback);
 
-            if (server.repl_diskless_load == REPL_DISKLESS_LOAD_SWAPDB) {
+            if (diskless_load_backup) {
                 /* Restore the backed up databases. */
                 disklessLoadRestoreBackup(diskless_load_backup);
             }
@@ -1776,7 +1790,7 @@ void readSyncBulkPayload(connection *conn) {
         }
 
         /* RDB loading succeeded if we reach this point. */
-        if (server.repl_diskless_load == REPL_DISKLESS_LOAD_SWAPDB) {
+        if (diskless_load_backup) {
             /* Delete the backup databases we created before starting to load
              * the new RDB. Now the RDB was loaded with success so the old
              * data is useless. */
@@ -2333,10 +2347,13 @@ void syncWithMaster(connection *conn) {
          *
          * EOF: supports EOF-style RDB transfer for diskless replication.
          * PSYNC2: supports PSYNC v2, so understands +CONTINUE <new repl ID>.
+         * ROCK-SST-V2: RedRock replica, can load the cold keys of a RedRock
+         *           master as rows of RocksDB, check rock-repl-sst.
+         *           The version is ROCK_KEY_FORMAT_VERSION of the rows.
          *
          * The master will ignore capabilities it does not understand. */
         err = sendCommand(conn,"REPLCONF",
-                "capa","eof","capa","psync2",NULL);
+                "capa","eof","capa","psync2","capa","rock-sst-v2",NULL);
         if (err) goto write_error;
 
         server.repl_state = REPL_STATE_RECEIVE_AUTH_REPLY;
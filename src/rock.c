@@ -48,6 +48,9 @@
 #include "rock_hash.h"
 #include "rock_marshal.h"
 #include "rock_evict.h"
+#include "rock_warm.h"
+#include "rock_load.h"
+#include "rock_admit.h"
 
 #include <dirent.h>
 #include <ftw.h>
@@ -158,6 +161,113 @@ static sds get_rocksdb_folder()
     return folder;
 }
 
+/* The prefix extractor of RocksDB for the rock keys of hash fields and segments.
+ * Both have the same layout of the prefix, i.e., type + dbid + key length (varint) + redis key,
+ * check encode_rock_key_for_hash() and encode_rock_key_for_segment(), 
+ * so all fields of a hash (or all segments of a value) share the prefix.
+ * The rock keys for db keys are out of the domain (whole key filtering for them).
+ * 
+ * With the prefix bloom filter, the scan of a whole hash (check rock_read.c) 
+ * can skip the SST files without the hash.
+ */
+static unsigned char rock_prefix_in_domain(void *state, const char *key, size_t length)
+{
+    UNUSED(state);
+
+    if (length < 2 + 1)
+        return 0;
+
+    if (!(key[0] == ROCK_KEY_FOR_HASH || key[0] == ROCK_KEY_FOR_SEGMENT))
+        return 0;
+
+    size_t key_len;
+    const size_t len_sz = decode_rock_key_len((const unsigned char*)key+2, length-2, &key_len);
+    return len_sz != 0 && length - 2 - len_sz >= key_len;
+}
+
+static char* rock_prefix_transform(void *state, const char *key, size_t length, size_t *dst_length)
+{
+    UNUSED(state);
+
+    size_t key_len;
+    const size_t len_sz = decode_rock_key_len((const unsigned char*)key+2, length-2, &key_len);
+    *dst_length = 2 + len_sz + key_len;
+    return (char*)key;
+}
+
+static unsigned char rock_prefix_in_range(void *state, const char *key, size_t length)
+{
+    UNUSED(state);
+    UNUSED(key);
+    UNUSED(length);
+    return 0;
+}
+
+// RocksDB calls it when the prefix extractor is destroyed, no state to free
+static void rock_prefix_destructor(void *state)
+{
+    UNUSED(state);
+}
+
+/* NOTE: RocksDB saves the name in SST files, 
+ *       change it only when the layout of the prefix changes (e.g., ROCK_KEY_FORMAT_VERSION) */
+static const char* rock_prefix_name(void *state)
+{
+    UNUSED(state);
+    return "redrock.HashPrefix.v2";
+}
+
+// the block cache of RocksDB, for the memory usage of RocksDB, check update_rocksdb_mem_in_cron()
+static rocksdb_cache_t *rocksdb_block_cache = NULL;
+
+/* The capacity of the block cache of RocksDB.
+ * 256M by default. With rock-total-mem, it is 1/8 of the total (at least 32M), 
+ * so the node can be sized by one number. Check get_max_rock_mem_of_os().
+ */
+static size_t get_block_cache_size()
+{
+    if (server.rock_total_mem == 0)
+        return 256<<20;
+
+    const size_t size = server.rock_total_mem / 8;
+    return size < (32<<20) ? (32<<20) : size;
+}
+
+/* The max size of the zstd dictionary for the compression of RocksDB, 0 for LZ4 without dictionary.
+ * Small values (e.g., JSON strings of hundreds bytes) share a lot of structure 
+ * but one block of them is too small for LZ4 to find it, the dictionary trained from samples helps.
+ * It needs RocksDB with zstd, check BUILD_ZSTD in Makefile.
+ */
+static int get_zstd_dict_size()
+{
+#ifdef USE_ZSTD
+    return server.rock_zstd_dict_size;
+#else
+    if (server.rock_zstd_dict_size)
+        serverLog(LL_WARNING, "rock-zstd-dict-size is ignored because RedRock is not built with BUILD_ZSTD=yes");
+    return 0;
+#endif
+}
+
+/* The max bytes of the samples for the training of the zstd dictionary.
+ * RocksDB recommends 100 times of the dictionary, but the samples are buffered in memory 
+ * by each compaction (for each output file), so it is capped by ZSTD_MAX_TRAIN_BYTES
+ * and by 1/64 of rock-total-mem if set (check get_block_cache_size()), 
+ * but no less than the dictionary.
+ */
+#define ZSTD_MAX_TRAIN_BYTES    (16<<20)
+static size_t get_zstd_max_train_bytes(const int zstd_dict_size)
+{
+    size_t bytes = (size_t)zstd_dict_size * 100;
+    if (bytes > ZSTD_MAX_TRAIN_BYTES)
+        bytes = ZSTD_MAX_TRAIN_BYTES;
+
+    if (server.rock_total_mem && bytes > server.rock_total_mem / 64)
+        bytes = server.rock_total_mem / 64;
+
+    return bytes < (size_t)zstd_dict_size ? (size_t)zstd_dict_size : bytes;
+}
+
 /* Init the global rocksdb handler, i.e., rockdb. */
 #define ROCKSDB_LEVEL_NUM   7
 void init_rocksdb(/*const char* folder_original_path*/)
@@ -166,8 +276,11 @@ void init_rocksdb(/*const char* folder_original_path*/)
 
     atomicSet(rock_threads_loop_forever, 1);
 
+    // for warm restart, keep the RocksDB folder if the manifest is valid. Check rock_warm.c
+    const int warm = load_warm_restart_manifest(folder_path);
+
     // nftw(folder_path, unlink_cb, 64, FTW_DEPTH | FTW_PHYS);
-    DIR *dir = opendir(folder_path);
+    DIR *dir = warm ? NULL : opendir(folder_path);
     if (dir)
     {
         closedir(dir);
@@ -180,21 +293,21 @@ void init_rocksdb(/*const char* folder_original_path*/)
         serverLog(LL_NOTICE, "finish removal of the whole RocksDB folder = %s", folder_path);
     }
     // check again
-    DIR *check_dir = opendir(folder_path);
+    DIR *check_dir = warm ? NULL : opendir(folder_path);
     if (check_dir)
     {
         closedir(check_dir);
         serverLog(LL_WARNING, "rocksdb folder still exists = %s", folder_path);
         exit(1);
     } 
-    else if (ENOENT != errno)
+    else if (!warm && ENOENT != errno)
     {
         serverLog(LL_WARNING, "opendir(%s) failed for errono = %d", folder_path, errno);
         exit(1);
     }
     // mkdir 
     mode_t mode = 0777;
-    if (mkdir(folder_path, mode)) 
+    if (!warm && mkdir(folder_path, mode)) 
     {
         if (errno == ENOENT) 
         {
@@ -215,14 +328,22 @@ void init_rocksdb(/*const char* folder_original_path*/)
     const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
     rocksdb_options_increase_parallelism(options, (int)(cpus));
     rocksdb_options_optimize_level_style_compaction(options, 0); 
-    // create the DB as a new one
+    // create the DB as a new one (or open the existing one for warm restart)
     rocksdb_options_set_create_if_missing(options, 1);
-    rocksdb_options_set_error_if_exists(options, 1);
+    rocksdb_options_set_error_if_exists(options, warm ? 0 : 1);
     // file size
     rocksdb_options_set_target_file_size_base(options, 4<<20);
     // memtable
     rocksdb_options_set_write_buffer_size(options, 32<<20);     // 32M memtable size
     rocksdb_options_set_max_write_buffer_number(options, 2);    // memtable number
+    // prefix for hash fields and segments, and the prefix bloom of memtable
+    rocksdb_slicetransform_t *prefix_extractor = rocksdb_slicetransform_create(NULL, rock_prefix_destructor, 
+                                                                               rock_prefix_transform,
+                                                                               rock_prefix_in_domain,
+                                                                               rock_prefix_in_range,
+                                                                               rock_prefix_name);
+    rocksdb_options_set_prefix_extractor(options, prefix_extractor);
+    rocksdb_options_set_memtable_prefix_bloom_size_ratio(options, 0.02);
     // WAL
     // rocksdb_options_set_manual_wal_flush(options, 1);    // current RocksDB API 6.20.3 not support
     // compaction (using Universal Compaction)
@@ -230,6 +351,7 @@ void init_rocksdb(/*const char* folder_original_path*/)
     rocksdb_options_set_num_levels(options, ROCKSDB_LEVEL_NUM);   
     rocksdb_options_set_level0_file_num_compaction_trigger(options, 4);
     // set each level compression types (reference RocksDB API of compression_type.h)
+    const int zstd_dict_size = get_zstd_dict_size();
     int compression_level_types[ROCKSDB_LEVEL_NUM];
     for (int i = 0; i < ROCKSDB_LEVEL_NUM; ++i) 
     {
@@ -239,10 +361,18 @@ void init_rocksdb(/*const char* folder_original_path*/)
         } 
         else 
         {
-            compression_level_types[i] = 0x04;      // kLZ4Compression
+            compression_level_types[i] = zstd_dict_size ? 0x07 : 0x04;      // kZSTD : kLZ4Compression
         }
     }
     rocksdb_options_set_compression_per_level(options, compression_level_types, ROCKSDB_LEVEL_NUM);
+    if (zstd_dict_size)
+    {
+        // window bits, level, strategy (default of RocksDB except the level) and the max dictionary size.
+        // The dictionary is trained from the samples of each output file (check get_zstd_max_train_bytes()) 
+        // and saved in the file, so it is retrained by every compaction.
+        rocksdb_options_set_compression_options(options, -14, 3, 0, zstd_dict_size);
+        rocksdb_options_set_compression_options_zstd_max_train_bytes(options, (int)get_zstd_max_train_bytes(zstd_dict_size));
+    }
     // table options
     rocksdb_options_set_max_open_files(options, 1024);      // if default is -1, no limit, and too many open files consume memory
     rocksdb_options_set_table_cache_numshardbits(options, 4);        // shards for table cache
@@ -254,8 +384,8 @@ void init_rocksdb(/*const char* folder_original_path*/)
     rocksdb_block_based_options_set_block_size(table_options, 16<<10);
 #endif
     // block cache
-    rocksdb_cache_t *lru_cache = rocksdb_cache_create_lru(256<<20);        // 256M lru cache
-    rocksdb_block_based_options_set_block_cache(table_options, lru_cache);
+    rocksdb_block_cache = rocksdb_cache_create_lru(get_block_cache_size());
+    rocksdb_block_based_options_set_block_cache(table_options, rocksdb_block_cache);
     // index in cache and partitioned index filter (https://github.com/facebook/rocksdb/wiki/Partitioned-Index-Filters)
     rocksdb_block_based_options_set_index_type(table_options, rocksdb_block_based_table_index_type_two_level_index_search);
     rocksdb_block_based_options_set_partition_filters(table_options, 1);
@@ -270,6 +400,8 @@ void init_rocksdb(/*const char* folder_original_path*/)
     // bloom filter
     rocksdb_filterpolicy_t *bloom = rocksdb_filterpolicy_create_bloom_full(10);
     rocksdb_block_based_options_set_filter_policy(table_options, bloom);
+    // both the whole keys (for point lookups) and the prefixes (for hash scans) are in the filter
+    rocksdb_block_based_options_set_whole_key_filtering(table_options, 1);
     // need invest, maybe mix with rocksdb_options_optimize_level_style_compaction()
     // rocksdb_options_set_max_background_jobs(options, 3);     
 
@@ -285,6 +417,9 @@ void init_rocksdb(/*const char* folder_original_path*/)
         exit(1);
     }
 
+    // SST files for loading RDB, check rock_load.c
+    init_rock_load(folder_path, options);
+
     sdsfree(folder_path);
 }
 
@@ -357,6 +492,64 @@ sds encode_rock_key_for_db(const int dbid, sds redis_to_rock_key)
     return redis_to_rock_key;
 }
 
+/* Encode the length of the redis key in the rock keys for hash and segment to buf,
+ * buf needs ROCK_KEY_LEN_MAX_SIZE bytes at least. Return the encoded bytes.
+ *
+ * The encoded length is portable (no size_t of the host and no endianness)
+ * and order-preserving, i.e., the byte-wise order of the encoded lengths 
+ * is the same as the order of the lengths, so the layout of the rock keys in RocksDB
+ * does not depend on the machine.
+ * 
+ * If the length is less than ROCK_KEY_LEN_ONE_BYTE_LIMIT, it is one byte of the length (most keys).
+ * Otherwise, it is one byte of (ROCK_KEY_LEN_ONE_BYTE_LIMIT + n - 1), 
+ * then n bytes of the length in big endian, where n (1 - 8) is the minimal bytes for the length.
+ */
+size_t encode_rock_key_len(unsigned char *buf, const size_t len)
+{
+    if (len < ROCK_KEY_LEN_ONE_BYTE_LIMIT)
+    {
+        buf[0] = (unsigned char)len;
+        return 1;
+    }
+
+    const uint64_t v = len;
+    size_t n = 1;
+    while (n < sizeof(uint64_t) && (v >> (8*n)) != 0)
+        ++n;
+
+    buf[0] = (unsigned char)(ROCK_KEY_LEN_ONE_BYTE_LIMIT + n - 1);
+    for (size_t i = 0; i < n; ++i)
+        buf[1+i] = (unsigned char)(v >> (8*(n-1-i)));
+
+    return 1 + n;
+}
+
+/* Decode the length from buf with buf_len bytes, check encode_rock_key_len().
+ * Return the bytes of the encoded length, or 0 if buf is not a valid encoded length.
+ */
+size_t decode_rock_key_len(const unsigned char *buf, const size_t buf_len, size_t *len)
+{
+    if (buf_len == 0)
+        return 0;
+
+    if (buf[0] < ROCK_KEY_LEN_ONE_BYTE_LIMIT)
+    {
+        *len = buf[0];
+        return 1;
+    }
+
+    const size_t n = buf[0] - ROCK_KEY_LEN_ONE_BYTE_LIMIT + 1;
+    if (n > sizeof(uint64_t) || buf_len < 1 + n)
+        return 0;
+
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; ++i)
+        v = (v << 8) | buf[1+i];
+
+    *len = (size_t)v;
+    return 1 + n;
+}
+
 /* Encode the dbid with the input key and field for the hash.
  *
  * The first byte is the flag indicating the rock key is for hash, 
@@ -365,6 +558,8 @@ sds encode_rock_key_for_db(const int dbid, sds redis_to_rock_key)
  * dbid will be encoded in one byte and be inserted in the second byte of the key, 
  * so dbid must greater than 0 and less than dbnum and 255.
  * 
+ * Then the length of the hash key (check encode_rock_key_len()), the hash key and the field.
+ * 
  * NOTE: hash_key_to_rock_key's memory may be different after the calling which means 
  *       you need to use the return sds value for key in futrue.
  */
@@ -373,18 +568,20 @@ sds encode_rock_key_for_hash(const int dbid, sds hash_key_to_rock_key, const sds
     serverAssert(dbid >= 0 && dbid < server.dbnum && dbid <= 255);
     size_t key_len = sdslen(hash_key_to_rock_key);
     size_t field_len = sdslen(hash_field);
-    hash_key_to_rock_key = sdsMakeRoomFor(hash_key_to_rock_key, 2 + sizeof(size_t) + field_len);
-    memmove(hash_key_to_rock_key+2+sizeof(size_t), hash_key_to_rock_key, key_len);
+    unsigned char len_buf[ROCK_KEY_LEN_MAX_SIZE];
+    const size_t len_sz = encode_rock_key_len(len_buf, key_len);
+    hash_key_to_rock_key = sdsMakeRoomFor(hash_key_to_rock_key, 2 + len_sz + field_len);
+    memmove(hash_key_to_rock_key+2+len_sz, hash_key_to_rock_key, key_len);
     unsigned char* p = (unsigned char*)hash_key_to_rock_key;
     *p = ROCK_KEY_FOR_HASH;
     ++p;
     *p = (unsigned char)dbid;
     ++p;
-    *((size_t*)p) = key_len;
-    p += sizeof(size_t);
+    memcpy(p, len_buf, len_sz);
+    p += len_sz;
     p += key_len;
     memcpy(p, hash_field, field_len);
-    sdsIncrLen(hash_key_to_rock_key, 2 + sizeof(size_t) + field_len);
+    sdsIncrLen(hash_key_to_rock_key, 2 + len_sz + field_len);
 
     return hash_key_to_rock_key;
 }
@@ -411,15 +608,81 @@ void decode_rock_key_for_hash(const sds rock_key, int *dbid,
                               const char **key, size_t *key_sz,
                               const char **field, size_t *field_sz)
 {
-    serverAssert(sdslen(rock_key) >= 2 + sizeof(size_t));
+    serverAssert(sdslen(rock_key) >= 2 + 1);
     serverAssert(rock_key[0] == ROCK_KEY_FOR_HASH);
     *dbid = rock_key[1];
-    size_t key_len = *((size_t*)(rock_key+2));
-    serverAssert(sdslen(rock_key) >= 2 + sizeof(size_t) + key_len);
-    *key = rock_key + 2 + sizeof(size_t);
+    size_t key_len;
+    const size_t len_sz = decode_rock_key_len((const unsigned char*)rock_key+2, sdslen(rock_key)-2, &key_len);
+    serverAssert(len_sz != 0 && sdslen(rock_key) >= 2 + len_sz + key_len);
+    *key = rock_key + 2 + len_sz;
+    *key_sz = key_len;
+    *field = rock_key + 2 + len_sz + key_len;
+    *field_sz = sdslen(rock_key) - 2 - len_sz - key_len;
+}
+
+/* Encode the dbid and the redis key as the prefix of all segments of a segmented value.
+ * Check rock_segment.c for segmented value.
+ *
+ * The first byte is the flag indicating the rock key is for segment,
+ * then one byte for dbid (like encode_rock_key_for_db()), 
+ * then the key length (varint) and the key (like encode_rock_key_for_hash()),
+ * so no other redis key has the same prefix and we can delete all segments by range.
+ * 
+ * NOTE: unlike encode_rock_key_for_db(), the input is not consumed 
+ *       and the return is a new allocated sds.
+ */
+sds encode_rock_key_prefix_for_segment(const int dbid, const char *redis_key, const size_t key_sz)
+{
+    serverAssert(dbid >= 0 && dbid < server.dbnum && dbid <= 255);
+
+    unsigned char len_buf[ROCK_KEY_LEN_MAX_SIZE];
+    const size_t len_sz = encode_rock_key_len(len_buf, key_sz);
+    sds prefix = sdsMakeRoomFor(sdsempty(), 2 + len_sz + key_sz + sizeof(uint32_t));
+    unsigned char* p = (unsigned char*)prefix;
+    *p = ROCK_KEY_FOR_SEGMENT;
+    ++p;
+    *p = (unsigned char)dbid;
+    ++p;
+    memcpy(p, len_buf, len_sz);
+    p += len_sz;
+    memcpy(p, redis_key, key_sz);
+    sdsIncrLen(prefix, 2 + len_sz + key_sz);
+
+    return prefix;
+}
+
+/* Encode the segment index to the prefix (from encode_rock_key_prefix_for_segment()) in place.
+ * The index is in big endian so the segments of a key are in order in RocksDB.
+ * 
+ * NOTE: prefix's memory may be different after the calling.
+ */
+sds encode_rock_key_for_segment(sds prefix, const uint32_t index)
+{
+    unsigned char be[sizeof(uint32_t)];
+    be[0] = (index >> 24) & 0xFF;
+    be[1] = (index >> 16) & 0xFF;
+    be[2] = (index >> 8) & 0xFF;
+    be[3] = index & 0xFF;
+    return sdscatlen(prefix, be, sizeof(uint32_t));
+}
+
+/* Decode the input rock_key as a segment key.
+ * dbid, key, key_sz, index are the pointer to the result,
+ * No memory allocation and the caller needs to guarantee the safety of rock_key.
+ */
+void decode_rock_key_for_segment(const sds rock_key, int *dbid, 
+                                 const char **key, size_t *key_sz, uint32_t *index)
+{
+    serverAssert(sdslen(rock_key) >= 2 + 1 + sizeof(uint32_t));
+    serverAssert(rock_key[0] == ROCK_KEY_FOR_SEGMENT);
+    *dbid = rock_key[1];
+    size_t key_len;
+    const size_t len_sz = decode_rock_key_len((const unsigned char*)rock_key+2, sdslen(rock_key)-2, &key_len);
+    serverAssert(len_sz != 0 && sdslen(rock_key) == 2 + len_sz + key_len + sizeof(uint32_t));
+    *key = rock_key + 2 + len_sz;
     *key_sz = key_len;
-    *field = rock_key + 2 + sizeof(size_t) + key_len;
-    *field_sz = sdslen(rock_key) - 2 - sizeof(size_t) - key_len;
+    const unsigned char *be = (const unsigned char*)(rock_key + 2 + len_sz + key_len);
+    *index = ((uint32_t)be[0] << 24) | ((uint32_t)be[1] << 16) | ((uint32_t)be[2] << 8) | (uint32_t)be[3];
 }
 
 /* for client id to client* hash table and rock.c readCandidatesDictType */
@@ -547,6 +810,252 @@ static list* get_keys_in_rock_for_command(const client *c, list **hash_keys, lis
 }
 
 
+/* Record the cold reads of a command for the admission, check rock_admit.c
+ * If is_prefetch != 0, they are from the look-ahead prefetch and counted later
+ * when the command is processed.
+ */
+static void on_cold_reads_for_rock_admit(const int dbid, const list *redis_keys, 
+                                         const list *hash_keys, const list *hash_fields,
+                                         const int is_prefetch)
+{
+    void (*on_read)(const int, const sds, const sds) = 
+        is_prefetch ? on_prefetch_for_rock_admit : on_cold_read_for_rock_admit;
+
+    listIter li;
+    listNode *ln;
+    if (redis_keys)
+    {
+        listRewind((list*)redis_keys, &li);
+        while ((ln = listNext(&li)))
+            on_read(dbid, listNodeValue(ln), NULL);
+    }
+
+    if (hash_keys)
+    {
+        listIter li_field;
+        listNode *ln_field;
+        listRewind((list*)hash_keys, &li);
+        listRewind((list*)hash_fields, &li_field);
+        while ((ln = listNext(&li)))
+        {
+            ln_field = listNext(&li_field);
+            on_read(dbid, listNodeValue(ln), listNodeValue(ln_field));
+        }
+    }
+}
+
+/* The look-ahead prefetch for the pipelined commands of a client.
+ *
+ * When a client pipelines commands, the query buffer has the following commands
+ * after the current one. Without prefetch, each cold key of them costs 
+ * a round trip of the read threads one after another.
+ * 
+ * When the current command is going to wait for rock values (async mode),
+ * we parse ahead the query buffer (up to rock-prefetch-window commands) without processing them,
+ * get their rock keys and rock fields by the rock_proc of the commands (with a fake client),
+ * and submit them to the read threads with the current command's as one batch. 
+ * Check begin_batch_of_rock_reads() in rock_read.c.
+ *
+ * The prefetch is only a hint. The values are recovered in Redis DB like other async reads,
+ * but no client waits for them. When the commands are processed later, 
+ * they check their rock values again as usual.
+ */
+static client *prefetch_client = NULL;
+
+/* Parse a line like "*3\r\n" or "$5\r\n" in buf from *pos for the prefix.
+ * Return 1 with the number in *val and *pos moved to the next line.
+ * Return 0 if the line is not complete or not valid.
+ */
+static int parse_ahead_number_line(const sds buf, size_t *pos, const char prefix, long long *val)
+{
+    const size_t len = sdslen(buf);
+    if (*pos >= len || buf[*pos] != prefix)
+        return 0;
+
+    const char *start = buf + *pos + 1;
+    const char *newline = memchr(start, '\r', len - *pos - 1);
+    if (newline == NULL || (size_t)(newline - buf) + 1 >= len)
+        return 0;       // no '\n' yet
+
+    if (string2ll(start, newline - start, val) == 0)
+        return 0;
+
+    *pos = (size_t)(newline - buf) + 2;
+    return 1;
+}
+
+/* Parse ahead one multibulk command in buf from *pos, like processMultibulkBuffer() 
+ * in networking.c but without any change to the client.
+ * Return the number of arguments and *argv (the caller needs to free them),
+ * and *pos goes to the next command.
+ * Return 0 if there is no complete multibulk command (e.g., not received yet or inline command).
+ */
+static int parse_ahead_one_command(const sds buf, size_t *pos, robj ***argv)
+{
+    size_t cur = *pos;
+    long long argc;
+    if (!parse_ahead_number_line(buf, &cur, '*', &argc) || argc <= 0 || argc > INT_MAX/(long long)sizeof(robj*))
+        return 0;
+
+    // check the whole command is in buf before creating any argument
+    const size_t args_start = cur;
+    for (long long i = 0; i < argc; ++i)
+    {
+        long long bulk_len;
+        if (!parse_ahead_number_line(buf, &cur, '$', &bulk_len) || 
+            bulk_len < 0 || bulk_len > server.proto_max_bulk_len ||
+            sdslen(buf) - cur < (size_t)bulk_len + 2)
+            return 0;
+
+        cur += (size_t)bulk_len + 2;
+    }
+
+    robj **args = zmalloc(sizeof(robj*) * argc);
+    cur = args_start;
+    for (long long i = 0; i < argc; ++i)
+    {
+        long long bulk_len;
+        serverAssert(parse_ahead_number_line(buf, &cur, '$', &bulk_len));
+        args[i] = createStringObject(buf + cur, (size_t)bulk_len);
+        cur += (size_t)bulk_len + 2;
+    }
+
+    *pos = cur;
+    *argv = args;
+    return (int)argc;
+}
+
+/* Get the rock keys and rock fields of one parsed command by the fake client and prefetch them.
+ * The visit statistics (check generic_get_one_key_for_rock()), the error stats 
+ * (check is_rock_prefetch_client()) and the admission (check rock_admit.c) are not changed 
+ * because the command will be counted when it is processed.
+ */
+static void prefetch_rock_keys_for_one_command(const client *c, const int argc, robj **argv)
+{
+    struct redisCommand *cmd = lookupCommand(argv[0]->ptr);
+    if (cmd == NULL || cmd->rock_proc == NULL)
+        return;
+
+    if ((cmd->arity > 0 && cmd->arity != argc) || argc < -cmd->arity)
+        return;     // processCommand() will reply the error
+
+    client *fc = prefetch_client;
+    fc->db = c->db;
+    fc->user = c->user;
+    fc->argc = argc;
+    fc->argv = argv;
+    fc->cmd = cmd;
+
+    int acl_errpos;
+    if (ACLCheckAllPerm(fc, &acl_errpos) != ACL_OK)
+        return;
+
+    const long long saved_key_total = stat_key_total;
+    const long long saved_key_rock = stat_key_rock;
+    const long long saved_field_total = stat_field_total;
+    const long long saved_field_rock = stat_field_rock;
+    list *hash_keys = NULL;
+    list *hash_fields = NULL;
+    list *redis_keys = cmd->rock_proc(fc, &hash_keys, &hash_fields);
+    stat_key_total = saved_key_total;
+    stat_key_rock = saved_key_rock;
+    stat_field_total = saved_field_total;
+    stat_field_rock = saved_field_rock;
+
+    if (redis_keys == shared.rock_cmd_fail)
+    {
+        // The error reply is dropped because the fake client has no connection 
+        // and it is not counted (check afterErrorReply() in networking.c)
+        if (hash_keys) listRelease(hash_keys);
+        if (hash_fields) listRelease(hash_fields);
+        return;
+    }
+
+    on_cold_reads_for_rock_admit(fc->db->id, redis_keys, hash_keys, hash_fields, 1);
+
+    if (redis_keys)
+    {
+        prefetch_rock_keys_for_db(fc->db->id, redis_keys);
+        listRelease(redis_keys);
+    }
+
+    if (hash_keys)
+    {
+        prefetch_rock_fields_for_hashes(fc->db->id, hash_keys, hash_fields);
+        listRelease(hash_keys);
+        listRelease(hash_fields);
+    }
+}
+
+/* When the rock_proc of a command fails by the fake client of the prefetch, 
+ * the error will be replied (and counted) when the command is processed.
+ * So afterErrorReply() in networking.c skips it.
+ */
+int is_rock_prefetch_client(const client *c)
+{
+    return prefetch_client != NULL && c == prefetch_client;
+}
+
+/* The value is in memory when the command is processed. 
+ * It could be recovered by the prefetch and need to be counted for the admission.
+ */
+static void on_hot_read_for_command(const client *c, const sds key, const sds field)
+{
+    if (!is_rock_prefetch_client(c))
+        on_hot_read_for_rock_admit(c->db->id, key, field);
+}
+
+/* The commands which change the db (or the keyspace of dbs) or the transaction context.
+ * The following commands in the pipeline could be for another db or in a transaction,
+ * so the look-ahead of the prefetch stops at them.
+ */
+static int is_barrier_for_prefetch(const robj *cmd_name)
+{
+    static const char *barriers[] = {"select", "swapdb", "move", "copy", "reset",
+                                     "flushdb", "flushall",
+                                     "multi", "exec", "discard", "watch", "unwatch"};
+
+    for (size_t i = 0; i < sizeof(barriers) / sizeof(barriers[0]); ++i)
+    {
+        if (!strcasecmp(cmd_name->ptr, barriers[i]))
+            return 1;
+    }
+    return 0;
+}
+
+static void prefetch_rock_keys_for_pipeline(client *c)
+{
+    if (server.rock_prefetch_window == 0 || c->querybuf == NULL || c->qb_pos >= sdslen(c->querybuf))
+        return;
+
+    if (prefetch_client == NULL)
+        prefetch_client = createClient(NULL);   // like the lua client, no connection and no reply
+
+    size_t pos = c->qb_pos;
+    for (int i = 0; i < server.rock_prefetch_window; ++i)
+    {
+        robj **argv;
+        const int argc = parse_ahead_one_command(c->querybuf, &pos, &argv);
+        if (argc == 0)
+            break;
+
+        const int is_barrier = is_barrier_for_prefetch(argv[0]);
+        if (!is_barrier)
+            prefetch_rock_keys_for_one_command(c, argc, argv);
+
+        for (int j = 0; j < argc; ++j)
+            decrRefCount(argv[j]);
+        zfree(argv);
+
+        if (is_barrier)
+            break;
+    }
+
+    prefetch_client->argc = 0;
+    prefetch_client->argv = NULL;
+    prefetch_client->cmd = NULL;
+}
+
 /* This is called in main thread by processCommand() before going into call().
  * Return value has three options:
  *
@@ -586,6 +1095,11 @@ int check_and_set_rock_status_in_processCommand(client *c)
         return CHECK_ROCK_CMD_FAIL;
     }
 
+    on_cold_reads_for_rock_admit(c->db->id, redis_keys, hash_keys, hash_fields, 0);
+
+    // the rock keys of the command and the prefetch go to the read threads together
+    begin_batch_of_rock_reads();
+
     // MUST deal with redis_keys first
     // because c.rock_key_num =
     if (redis_keys)
@@ -606,7 +1120,13 @@ int check_and_set_rock_status_in_processCommand(client *c)
         listRelease(hash_fields);
     }
 
-    return is_client_in_waiting_rock_value_state(c) ? CHECK_ROCK_ASYNC_WAIT : CHECK_ROCK_GO_ON_TO_CALL;
+    const int async_wait = is_client_in_waiting_rock_value_state(c);
+    if (async_wait)
+        prefetch_rock_keys_for_pipeline(c);
+
+    end_batch_of_rock_reads();
+
+    return async_wait ? CHECK_ROCK_ASYNC_WAIT : CHECK_ROCK_GO_ON_TO_CALL;
 }
 
 /* For script and module. Before the call(), we need check the command's rock value 
@@ -638,6 +1158,8 @@ int check_and_recover_rock_value_in_sync_mode(client *c)
         return 0;
     }
 
+    on_cold_reads_for_rock_admit(c->db->id, redis_keys, hash_keys, hash_fields, 0);
+
     // NOTE: unlike the above, if (redis_keys) and if (hash_keys) can has any order
 
     if (redis_keys)
@@ -678,7 +1200,10 @@ list* generic_get_one_key_for_rock(const client *c, const int index)
 
     robj *o = dictGetVal(de);
     if (!is_rock_value(o))
+    {
+        on_hot_read_for_command(c, key, NULL);
         return NULL;
+    }
 
     list *keys = listCreate();
     listAddNodeTail(keys, key);
@@ -686,6 +1211,21 @@ list* generic_get_one_key_for_rock(const client *c, const int index)
     return keys;
 }
 
+/* Like generic_get_one_key_for_rock() but for the commands 
+ * which only need the cardinality of the value, e.g., LLEN <key>.
+ * If we know the cardinality of the rock value (check rock_evict.c rockMetaDictType),
+ * the command can reply from memory and we do not need to recover the value.
+ */
+list* generic_get_one_key_for_cardinality_for_rock(const client *c, const int index)
+{
+    serverAssert(index >= 1 && c->argc > index);
+
+    if (has_cardinality_of_rock_value(c->db->id, c->argv[index]->ptr))
+        return NULL;
+
+    return generic_get_one_key_for_rock(c, index);
+}
+
 /* Get one field for a hash from client's argv.
  * like HGET <key> <field>
  */
@@ -718,7 +1258,10 @@ void generic_get_one_field_for_rock(const client *c, const sds key, const int in
 
     const sds val = dictGetVal(de_hash);
     if (val != shared.hash_rock_val_for_field)
+    {
+        on_hot_read_for_command(c, key, field);
         return;
+    }
 
     list *join_keys = *hash_keys;
     list *join_fields = *hash_fields;
@@ -776,7 +1319,10 @@ void generic_get_multi_fields_for_rock(const client *c, const sds key, const int
         
         const sds val = dictGetVal(de_hash);
         if (val != shared.hash_rock_val_for_field)
+        {
+            on_hot_read_for_command(c, key, field);
             continue;
+        }
 
         if (join_keys == NULL)
         {
@@ -839,6 +1385,10 @@ void generic_get_all_fields_for_rock(const client *c, const sds key, list **hash
             listAddNodeTail(join_fields, field);
             ++stat_field_rock;
         }
+        else
+        {
+            on_hot_read_for_command(c, key, field);
+        }
     }
     dictReleaseIterator(di);
 
@@ -870,7 +1420,10 @@ list* generic_get_multi_keys_for_rock_in_range(const client *c, const int start,
         
         robj *o = dictGetVal(de);
         if (!is_rock_value(o))
+        {
+            on_hot_read_for_command(c, key, NULL);
             continue;
+        }
 
         if (keys == NULL)
             keys = listCreate();
@@ -910,7 +1463,10 @@ list* generic_get_multi_keys_for_rock_exclude_tails(const client *c, const int i
 
         robj *o = dictGetVal(de);
         if (!is_rock_value(o))
+        {
+            on_hot_read_for_command(c, key, NULL);
             continue;
+        }
 
         if (keys == NULL)
             keys = listCreate();
@@ -961,6 +1517,10 @@ list* generic_get_zset_num_for_rock(const client *c, const int have_dest)
                 listAddNodeTail(keys, dest);
                 ++stat_key_rock;
             }
+            else
+            {
+                on_hot_read_for_command(c, dest, NULL);
+            }
         }
     }
     else
@@ -985,7 +1545,10 @@ list* generic_get_zset_num_for_rock(const client *c, const int have_dest)
 
         robj *o = dictGetVal(de);
         if (!is_rock_value(o))
+        {
+            on_hot_read_for_command(c, key, NULL);
             continue;
+        }
 
         if (keys == NULL)
             keys = listCreate();
@@ -1033,6 +1596,9 @@ void wait_rock_threads_exit()
 
     join_purge_thread();
 
+    // NOTE: must after all rock threads exit
+    save_warm_restart_manifest_before_exit();
+
     if (rockdb)
         rocksdb_close(rockdb);
 }
@@ -1511,8 +2077,86 @@ static size_t get_max_process_mem_in_bytes()
     }
 }
 
+/* The memory of RocksDB sampled in cron, check update_rocksdb_mem_in_cron() */
+static size_t rocksdb_mem_block_cache = 0;      // including the pinned index and filter blocks
+static size_t rocksdb_mem_block_cache_pinned = 0;
+static size_t rocksdb_mem_memtables = 0;
+static size_t rocksdb_mem_table_readers = 0;
+
+static size_t get_rocksdb_int_property(const char *name)
+{
+    uint64_t val;
+    if (rocksdb_property_int(rockdb, name, &val) != 0)
+        return 0;
+
+    return (size_t)val;
+}
+
+/* Called in main thread cron to sample the memory of RocksDB out of zmalloc, i.e.,
+ * the block cache (the index and filter blocks are in it too because cache_index_and_filter_blocks),
+ * the memtables, and the table readers (e.g., the top level index which is not in cache).
+ */
+void update_rocksdb_mem_in_cron()
+{
+    if (rockdb == NULL || rocksdb_block_cache == NULL)
+        return;
+
+    rocksdb_mem_block_cache = rocksdb_cache_get_usage(rocksdb_block_cache);
+    rocksdb_mem_block_cache_pinned = rocksdb_cache_get_pinned_usage(rocksdb_block_cache);
+    rocksdb_mem_memtables = get_rocksdb_int_property("rocksdb.cur-size-all-mem-tables");
+    rocksdb_mem_table_readers = get_rocksdb_int_property("rocksdb.estimate-table-readers-mem");
+}
+
+size_t get_rocksdb_mem()
+{
+    return rocksdb_mem_block_cache + rocksdb_mem_memtables + rocksdb_mem_table_readers;
+}
+
+sds cat_rocksdb_mem_info(sds info)
+{
+    info = sdscatprintf(info,
+                        "rock_total_mem:%llu\r\n"
+                        "rocksdb_mem:%zu\r\n"
+                        "rocksdb_mem_block_cache:%zu\r\n"
+                        "rocksdb_mem_block_cache_pinned:%zu\r\n"
+                        "rocksdb_mem_block_cache_capacity:%zu\r\n"
+                        "rocksdb_mem_memtables:%zu\r\n"
+                        "rocksdb_mem_table_readers:%zu\r\n",
+                        server.rock_total_mem,
+                        get_rocksdb_mem(),
+                        rocksdb_mem_block_cache,
+                        rocksdb_mem_block_cache_pinned,
+                        get_block_cache_size(),
+                        rocksdb_mem_memtables,
+                        rocksdb_mem_table_readers);
+    return info;
+}
+
+/* With rock-total-mem, the memory of Redis (i.e., zmalloc) gets what RocksDB does not use,
+ * so the memtables and the blocks in cache push the eviction of values to RocksDB,
+ * and the process memory is in one budget.
+ * But it is at least a half of the total, so a burst of memtables can not starve the values.
+ * maxrockmem, if set, is still the upper limit for Redis.
+ */
+static unsigned long long get_max_rock_mem_of_total()
+{
+    const unsigned long long total = server.rock_total_mem;
+    const unsigned long long rocksdb_mem = get_rocksdb_mem();
+    unsigned long long max_mem = total > rocksdb_mem ? total - rocksdb_mem : 0;
+    if (max_mem < total / 2)
+        max_mem = total / 2;
+
+    if (server.maxrockmem != 0 && server.maxrockmem < max_mem)
+        max_mem = server.maxrockmem;
+
+    return max_mem;
+}
+
 unsigned long long get_max_rock_mem_of_os()
 {
+    if (server.rock_total_mem != 0)
+        return get_max_rock_mem_of_total();
+
     if (server.maxrockmem != 0)
         return server.maxrockmem;       // used-defined
 
@@ -1587,16 +2231,19 @@ void rock_stat(client *c)
     char used_memory_rss_hmem[64];
     const size_t rss_mem = server.cron_malloc_stats.process_rss;
     bytesToHuman(used_memory_rss_hmem, rss_mem);
-    const size_t rocksdb_mem = rss_mem > redis_used_mem ? rss_mem - redis_used_mem : 0;
+    const size_t rocksdb_mem = get_rocksdb_mem();
     char rocksdb_hmem[64];
     bytesToHuman(rocksdb_hmem, rocksdb_mem);
+    const size_t other_mem = rss_mem > redis_used_mem + rocksdb_mem ? rss_mem - redis_used_mem - rocksdb_mem : 0;
+    char other_hmem[64];
+    bytesToHuman(other_hmem, other_mem);
     s = sdscatprintf(s, 
                     "used_human = %s, used_peak_human = %s, sys_human = %s, "
                     "free_hmem = %s, max_ps_hmem = %s, max_rock_human = %s, "
-                    "rss_hmem = %s, rocksdb(and other) = %s", 
+                    "rss_hmem = %s, rocksdb = %s, other = %s", 
                     hmem, peak_hmem, total_system_hmem, 
                     free_hmem, max_ps_hmem, max_rock_hmem,
-                    used_memory_rss_hmem, rocksdb_hmem);
+                    used_memory_rss_hmem, rocksdb_hmem, other_hmem);
     addReplyBulkCString(c, s);
     sdsfree(s);
 
@@ -2212,26 +2859,127 @@ void rock_mem(client *c)
     addReplyBulkSds(c, result);
 }
 
-static robj* add_whole_key_to_redis(redisDb *db, sds key, robj *val, int rdbflags, robj *key_if_need_delete)
+/* Called in main thread when loading RDB before the value of key is written to RocksDB.
+ * If the key exists in db and RDBFLAGS_ALLOW_DUP (e.g., DEBUG RELOAD MERGE), 
+ * delete the old one like rdbLoadRio(). Otherwise, a duplicated key is fatal.
+ *
+ * NOTE: If the old one is rock value (or rock hash), deleting it queues tombstones 
+ *       to ring buffer for the same rock keys as the new value,
+ *       check on_db_del_or_overwrite_for_rock_tombstone().
+ *       The new value is written to RocksDB directly (or by SST ingestion) not through ring buffer,
+ *       so we wait for the tombstones written first, otherwise they would delete the new records.
+ */
+static void delete_dup_key_when_load_rdb(redisDb *db, sds key, int rdbflags, robj *key_if_need_delete,
+                                         const char *caller)
+{
+    if (dictFind(db->dict, key) == NULL)
+        return;
+
+    if (!(rdbflags & RDBFLAGS_ALLOW_DUP))
+    {
+        serverLog(LL_WARNING, "RDB has duplicated key '%s' in DB %d for %s()", key, db->id, caller);
+        serverPanic("Duplicated key found in RDB file when %s()", caller);
+    }
+
+    dbSyncDelete(db, key_if_need_delete);
+    wait_rock_write_ring_buf_drained();
+}
+
+/* The caller guarantees no duplicated key in db by delete_dup_key_when_load_rdb() */
+static robj* add_whole_key_to_redis(redisDb *db, sds key, robj *val)
 {
     // add the key and rock value to the real database of redis
     robj *rock_val = get_match_rock_value(val);
-    if (dictAdd(db->dict, key, rock_val) != DICT_OK)
+    serverAssert(dictAdd(db->dict, key, rock_val) == DICT_OK);
+    return rock_val;
+}
+
+/* When loading from a RedRock master with RDBFLAGS_ROCK_SST, 
+ * the value of the key is already in RocksDB (or will be ingested by rock_load.c),
+ * so we only need to add the key with the matched rock value.
+ * Check rdb_load_rock_cold_key() in rock_rdb_aof.c.
+ */
+void db_add_cold_key_when_load_rdb(redisDb *db, sds key, const int type, const int encoding, 
+                                   int rdbflags, robj *key_if_need_delete)
+{
+    robj o;
+    o.type = type;
+    o.encoding = encoding;
+    delete_dup_key_when_load_rdb(db, key, rdbflags, key_if_need_delete, "db_add_cold_key_when_load_rdb");
+    add_whole_key_to_redis(db, key, &o);
+}
+
+/* When loading from rdb for warm restart, check rock_warm.c,
+ * if the key (or some fields of the hash) is already in RocksDB with the same value, 
+ * add it as rock value (or rock fields) without writing to RocksDB again.
+ * 
+ * Return the replaced robj (like db_add_rockval_when_load_rdb()) if added to the db.
+ * Otherwise, return NULL, meaning no addition for the db.
+ */
+robj* db_add_warm_rockval_when_load_rdb(redisDb *db, sds key, robj *val, int rdbflags, robj *key_if_need_delete)
+{
+    if (!is_warm_restart_loading())
+        return NULL;
+
+    if (!is_rock_type(val) || is_shared_value(val))
+        return NULL;
+
+    sds rock_key = encode_rock_key_for_db(db->id, sdsdup(key));
+    const int whole_key_in_disk = take_from_warm_restart_index(rock_key);
+    sdsfree(rock_key);
+    if (whole_key_in_disk)
     {
-        // Check rdbLoadRio() for more infomation. Use similar code
-        if (rdbflags & RDBFLAGS_ALLOW_DUP)
-        {
-            dbSyncDelete(db, key_if_need_delete);
-            serverAssert(dictAdd(db->dict, key, rock_val) == DICT_OK);
-        }
-        else
+        delete_dup_key_when_load_rdb(db, key, rdbflags, key_if_need_delete, "db_add_warm_rockval_when_load_rdb");
+        return add_whole_key_to_redis(db, key, val);
+    }
+
+    // check the fields of the hash which will be in rock hash. Check init_rock_hash_before_enter_event_loop()
+    const size_t threshold = server.hash_max_rock_entries;
+    if (!(threshold != 0 && val->type == OBJ_HASH && val->encoding == OBJ_ENCODING_HT))
+        return NULL;
+    dict *src = val->ptr;
+    if (dictSize(src) <= threshold)
+        return NULL;
+
+    robj *in_redis = NULL;
+    dictIterator *di = dictGetIterator(src);
+    dictEntry *de;
+    while ((de = dictNext(di)))
+    {
+        const sds field = dictGetKey(de);
+        rock_key = encode_rock_key_for_hash(db->id, sdsdup(key), field);
+        const int field_in_disk = take_from_warm_restart_index(rock_key);
+        sdsfree(rock_key);
+        if (!field_in_disk)
+            continue;
+
+        if (in_redis == NULL)
         {
-            serverLog(LL_WARNING,
-                      "RDB has duplicated key '%s' in DB %d for db_add_rockval_when_load_rdb()", key, db->id);
-            serverPanic("Duplicated key found in RDB file when db_add_rockval_when_load_rdb()");
+            // the first rock field, make a copy of the hash and set the rock fields to it
+            in_redis = create_pure_empty_hash_object(dictSize(src));
+            in_redis->encoding = OBJ_ENCODING_HT;
+            dict *dst = in_redis->ptr;
+            dictIterator *di_copy = dictGetIterator(src);
+            dictEntry *de_copy;
+            while ((de_copy = dictNext(di_copy)))
+                serverAssert(dictAdd(dst, sdsdup(dictGetKey(de_copy)), sdsdup(dictGetVal(de_copy))) == DICT_OK);
+            dictReleaseIterator(di_copy);
         }
+
+        dictEntry *de_dst = dictFind((dict*)in_redis->ptr, field);
+        serverAssert(de_dst);
+        sdsfree(dictGetVal(de_dst));
+        dictGetVal(de_dst) = shared.hash_rock_val_for_field;
     }
-    return rock_val;
+    dictReleaseIterator(di);
+
+    if (in_redis == NULL)
+        return NULL;    // no field in disk, go on as normal
+
+    delete_dup_key_when_load_rdb(db, key, rdbflags, key_if_need_delete, "db_add_warm_rockval_when_load_rdb");
+    serverAssert(dictAdd(db->dict, key, in_redis) == DICT_OK);
+
+    return in_redis;
 }
 
 /* When loading from rdb and the caller finds it needs to add the key and val
@@ -2246,6 +2994,9 @@ robj* db_add_rockval_when_load_rdb(redisDb *db, sds key, robj *val, int rdbflags
     if (!is_rock_type(val) || is_shared_value(val))
         return NULL;
 
+    // the old one must be deleted (and its tombstones written) before writing the new one to RocksDB
+    delete_dup_key_when_load_rdb(db, key, rdbflags, key_if_need_delete, "db_add_rockval_when_load_rdb");
+
     // write the key and value to RocksDB and add the replaced value to redis
 
     int add_as_whoke_key = 1;
@@ -2260,26 +3011,15 @@ robj* db_add_rockval_when_load_rdb(redisDb *db, sds key, robj *val, int rdbflags
     if (add_as_whoke_key)
     {
         // add as whole key
-        write_to_rocksdb_in_main_for_key_when_load(db, key, val);
-        return add_whole_key_to_redis(db, key, val, rdbflags, key_if_need_delete);
+        if (server.rock_load_sst)
+            load_key_to_rocksdb_by_sst(db, key, val);
+        else
+            write_to_rocksdb_in_main_for_key_when_load(db, key, val);
+        return add_whole_key_to_redis(db, key, val);
     }
     else
     {
         // add as hash + field
-        if (dictFind(db->dict, key))
-        {
-            if (rdbflags & RDBFLAGS_ALLOW_DUP)
-            {
-                dbSyncDelete(db, key_if_need_delete);
-            }
-            else
-            {
-                serverLog(LL_WARNING,
-                            "RDB has duplicated key '%s' in DB %d for db_add_rockval_when_load_rdb()",key,db->id);
-                serverPanic("Duplicated key found in RDB file when db_add_rockval_when_load_rdb()");
-            }
-        }
-
         robj *in_redis = create_pure_empty_hash_object(dictSize((dict*)val->ptr));
         in_redis->encoding = OBJ_ENCODING_HT;
         serverAssert(dictAdd(db->dict, key, in_redis) == DICT_OK);        
@@ -2293,7 +3033,10 @@ robj* db_add_rockval_when_load_rdb(redisDb *db, sds key, robj *val, int rdbflags
             sds field = sdsdup(dictGetKey(de));     // need a copy of field
             sds field_val = dictGetVal(de);
 
-            write_to_rocksdb_in_main_for_hash_when_load(db, key, field, field_val);
+            if (server.rock_load_sst)
+                load_field_to_rocksdb_by_sst(db, key, field, field_val);
+            else
+                write_to_rocksdb_in_main_for_hash_when_load(db, key, field, field_val);
             serverAssert(dictAdd(dst, field, shared.hash_rock_val_for_field) == DICT_OK);
         }
         dictReleaseIterator(di);
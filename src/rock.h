@@ -40,6 +40,17 @@
 
 #define ROCK_KEY_FOR_DB     0
 #define ROCK_KEY_FOR_HASH   1
+#define ROCK_KEY_FOR_SEGMENT    2       // check rock_segment.c
+#define ROCK_KEY_FOR_HASH_SCAN  3       // only for the tasks of read threads, not in RocksDB, check rock_read.c
+#define ROCK_KEY_FOR_DB_RANGE   4       // only for the tombstone of whole db(s) in write ring buffer, not in RocksDB, check rock_write.c
+
+/* The version of the layout of the rock keys in RocksDB. 
+ * 1: native size_t for the key length of hash and segment
+ * 2: varint (check encode_rock_key_len()) for the key length of hash and segment
+ * Check rock_warm.c and rock-repl-sst of replication for the reuse of rock keys. */
+#define ROCK_KEY_FORMAT_VERSION     2
+#define ROCK_KEY_LEN_ONE_BYTE_LIMIT 240
+#define ROCK_KEY_LEN_MAX_SIZE       (1 + sizeof(uint64_t))
 
 void wait_rock_threads_exit();
 
@@ -52,17 +63,24 @@ void create_shared_object_for_rock();
 void init_rocksdb();
 void check_mem_requirement_on_startup();
 
+size_t encode_rock_key_len(unsigned char *buf, const size_t len);
+size_t decode_rock_key_len(const unsigned char *buf, const size_t buf_len, size_t *len);
 sds encode_rock_key_for_db(const int dbid, sds redis_to_rock_key);
 sds encode_rock_key_for_hash(const int dbid, sds hash_key_to_rock_key, const sds hash_field);
 void decode_rock_key_for_db(const sds rock_key, int *dbid, const char **redis_key, size_t *key_sz);
 void decode_rock_key_for_hash(const sds rock_key, int *dbid, 
                               const char **key, size_t *key_sz,
                               const char **field, size_t *field_sz);
+sds encode_rock_key_prefix_for_segment(const int dbid, const char *redis_key, const size_t key_sz);
+sds encode_rock_key_for_segment(sds prefix, const uint32_t index);
+void decode_rock_key_for_segment(const sds rock_key, int *dbid, 
+                                 const char **key, size_t *key_sz, uint32_t *index);
 
 void init_client_id_table();
 client* lookup_client_from_id(const uint64_t client_id);
 void on_add_a_new_client(client* const c);
 void on_del_a_destroy_client(const client* const c);
+int is_rock_prefetch_client(const client *c);     // for networking.c
 
 void init_stat_rock_key_and_field();
 
@@ -76,9 +94,15 @@ void rock_mem(client *c);
 
 int check_free_mem_for_command(const client *c, const int is_denyoom_command);
 unsigned long long get_max_rock_mem_of_os();    // for rock_evict.c
+void update_rocksdb_mem_in_cron();
+size_t get_rocksdb_mem();
+sds cat_rocksdb_mem_info(sds info);
 size_t get_free_mem_of_os();       // for server.c and rock.c and rock_statsd.c
 
 robj* db_add_rockval_when_load_rdb(redisDb *db, sds key, robj *val, int rdbflags, robj *key_if_need_delete);     // for rdb.c
+robj* db_add_warm_rockval_when_load_rdb(redisDb *db, sds key, robj *val, int rdbflags, robj *key_if_need_delete);     // for rdb.c
+void db_add_cold_key_when_load_rdb(redisDb *db, sds key, const int type, const int encoding, 
+                                   int rdbflags, robj *key_if_need_delete);     // for rock_rdb_aof.c
 
 void get_rock_info(int *no_zero_dbnum,
                    size_t *total_key_num, 
@@ -174,6 +198,7 @@ inline int is_client_in_waiting_rock_value_state(const client *c)
 
 // generic API for key or field for the following data structures
 list* generic_get_one_key_for_rock(const client *c, const int index);
+list* generic_get_one_key_for_cardinality_for_rock(const client *c, const int index);
 list* generic_get_multi_keys_for_rock(const client *c, const int index, const int step);
 list* generic_get_multi_keys_for_rock_exclude_tails(const client *c, const int index, 
                                                     const int step, const int tail_cnt);
@@ -316,22 +341,15 @@ list* copy_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
 list* rename_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
 list* renamenx_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
 
-// expire.c
-list* expire_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
-list* expireat_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
-list* pexpire_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
-list* pexpireat_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
-list* ttl_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
-list* touch_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
-list* pttl_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
-list* persist_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
-
 // multi.c
 list* exec_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
 
 // sort.c
 list* sort_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
 
+// scripting.c
+list* eval_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
+
 // debug.c
 list* debug_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields);
 
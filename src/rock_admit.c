@@ -0,0 +1,297 @@
+/* RedRock is based on Redis, coded by Tony. The copyright is same as Redis.
+ *
+ * Copyright (c) 2018, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Admission of the cold values recovered from RocksDB (or ring buffer) into memory.
+ *
+ * Without admission, every cold access recovers the value into db->dict and 
+ * it stays there until the eviction picks it. So a one-off scan of cold keys 
+ * (e.g., SCAN + GET for analytics) pushes out the real hot set and causes an eviction storm.
+ * 
+ * We estimate the access frequency of cold keys (and fields of rock hash) 
+ * by a Count-Min sketch with 4 rows of small saturated counters like TinyLFU. 
+ * The sketch ages by halving all counters every ADMIT_SAMPLE_SIZE accesses,
+ * so the frequency is for recent accesses.
+ * 
+ * When memory is under pressure (check is_rock_mem_under_pressure() in rock_evict.c),
+ * a cold access whose estimated frequency is less than rock-admit-min-freq is not admitted. 
+ * The value still has to be recovered into memory because the command runs on the robj in db,
+ * but after the command (in beforeSleep()), it goes back to rock value
+ * without any write because it is clean (check try_evict_one_key_to_rocksdb() in rock_write.c).
+ * If the command modifies it, it is not clean and stays in memory. 
+ */
+
+#include "rock_admit.h"
+#include "rock.h"
+#include "rock_evict.h"
+#include "rock_hash.h"
+#include "rock_read.h"
+#include "rock_write.h"
+
+#define ADMIT_SKETCH_ROWS       4
+#define ADMIT_SKETCH_WIDTH      (1<<18)                         // power of 2
+#define ADMIT_MAX_FREQ          15                              // 4 bits like TinyLFU
+#define ADMIT_SAMPLE_SIZE       (10 * ADMIT_SKETCH_WIDTH)       // the aging period
+
+static uint8_t *admit_sketch = NULL;
+static size_t admit_sample_cnt = 0;
+
+/* The not admitted cold values of current event loop, check demote_not_admitted_cold_reads() */
+typedef struct notAdmitted {
+    int dbid;
+    sds key;
+    sds field;      // NULL for the whole key
+} notAdmitted;
+static list *not_admitted = NULL;
+
+/* The cold reads submitted by the look-ahead prefetch (check rock.c) whose commands are not processed yet.
+ * The key is encoded like the rock key (check encode_rock_key_for_db() and encode_rock_key_for_hash()).
+ * They are counted when the commands are processed (the value could be already recovered by then),
+ * check on_hot_read_for_rock_admit().
+ */
+#define ADMIT_PREFETCHED_MAX_SIZE   (64<<10)
+static dict *prefetched_reads = NULL;
+
+/* Statistics for INFO, check cat_rock_admit_info() */
+static long long stat_admitted = 0;
+static long long stat_not_admitted = 0;
+static long long stat_demoted = 0;
+
+static void free_not_admitted(void *ptr)
+{
+    notAdmitted *na = ptr;
+    sdsfree(na->key);
+    if (na->field)
+        sdsfree(na->field);
+    zfree(na);
+}
+
+void init_rock_admit()
+{
+    admit_sketch = zcalloc(ADMIT_SKETCH_ROWS * ADMIT_SKETCH_WIDTH);
+    not_admitted = listCreate();
+    listSetFreeMethod(not_admitted, free_not_admitted);
+    prefetched_reads = dictCreate(&setDictType, NULL);
+}
+
+/* Halve all counters, check TinyLFU reset operation */
+static void age_sketch()
+{
+    for (size_t i = 0; i < ADMIT_SKETCH_ROWS * ADMIT_SKETCH_WIDTH; ++i)
+        admit_sketch[i] >>= 1;
+
+    admit_sample_cnt /= 2;
+}
+
+static uint64_t hash_for_sketch(const int dbid, const sds key, const sds field)
+{
+    uint64_t h = dictGenHashFunction(key, sdslen(key));
+    if (field)
+        h ^= dictGenHashFunction(field, sdslen(field)) * 0x9E3779B97F4A7C15ULL;
+
+    return h ^ ((uint64_t)dbid * 0xC2B2AE3D27D4EB4FULL);
+}
+
+/* Increase the counters of the sketch and return the estimated frequency (after the increase).
+ * We use the conservative update, i.e., only the counters equal to the minimum are increased.
+ */
+static int incr_sketch(const int dbid, const sds key, const sds field)
+{
+    const uint64_t h = hash_for_sketch(dbid, key, field);
+    const uint32_t h1 = (uint32_t)h;
+    const uint32_t h2 = (uint32_t)(h >> 32) | 1;
+
+    size_t indexes[ADMIT_SKETCH_ROWS];
+    int min = ADMIT_MAX_FREQ;
+    for (int i = 0; i < ADMIT_SKETCH_ROWS; ++i)
+    {
+        indexes[i] = (size_t)i * ADMIT_SKETCH_WIDTH + ((h1 + (uint32_t)i * h2) & (ADMIT_SKETCH_WIDTH - 1));
+        if (admit_sketch[indexes[i]] < min)
+            min = admit_sketch[indexes[i]];
+    }
+
+    if (min < ADMIT_MAX_FREQ)
+    {
+        for (int i = 0; i < ADMIT_SKETCH_ROWS; ++i)
+        {
+            if (admit_sketch[indexes[i]] == min)
+                ++admit_sketch[indexes[i]];
+        }
+        ++min;
+    }
+
+    if (++admit_sample_cnt >= ADMIT_SAMPLE_SIZE)
+        age_sketch();
+
+    return min;
+}
+
+static sds encode_prefetched_read(const int dbid, const sds key, const sds field)
+{
+    return field ? encode_rock_key_for_hash(dbid, sdsdup(key), field) : 
+                   encode_rock_key_for_db(dbid, sdsdup(key));
+}
+
+/* Return 1 if the read is submitted by the prefetch and not counted yet, and forget it. */
+static int forget_prefetched_read(const int dbid, const sds key, const sds field)
+{
+    if (dictSize(prefetched_reads) == 0)
+        return 0;
+
+    sds encoded = encode_prefetched_read(dbid, key, field);
+    const int found = dictDelete(prefetched_reads, encoded) == DICT_OK;
+    sdsfree(encoded);
+    return found;
+}
+
+static void admit_cold_read(const int dbid, const sds key, const sds field)
+{
+    const int freq = incr_sketch(dbid, key, field);
+    if (freq >= server.rock_admit_min_freq || !is_rock_mem_under_pressure())
+    {
+        ++stat_admitted;
+        return;
+    }
+
+    ++stat_not_admitted;
+    notAdmitted *na = zmalloc(sizeof(notAdmitted));
+    na->dbid = dbid;
+    na->key = sdsdup(key);
+    na->field = field ? sdsdup(field) : NULL;
+    listAddNodeTail(not_admitted, na);
+}
+
+/* Called in main thread when a client needs a cold whole key (field is NULL) 
+ * or a cold field of rock hash for a command, check rock.c.
+ * 
+ * If the cold value is not admitted, it is recorded 
+ * and will be demoted after the command in beforeSleep().
+ */
+void on_cold_read_for_rock_admit(const int dbid, const sds key, const sds field)
+{
+    if (server.rock_admit_min_freq == 0)
+        return;
+
+    forget_prefetched_read(dbid, key, field);
+    admit_cold_read(dbid, key, field);
+}
+
+/* Called in main thread when the look-ahead prefetch submits a cold read 
+ * for a command not processed yet, check rock.c.
+ *
+ * It is not counted now, but when the command is processed.
+ * If there are too many commands prefetched but never processed (e.g., the client is gone),
+ * we forget them all.
+ */
+void on_prefetch_for_rock_admit(const int dbid, const sds key, const sds field)
+{
+    if (server.rock_admit_min_freq == 0)
+        return;
+
+    if (dictSize(prefetched_reads) >= ADMIT_PREFETCHED_MAX_SIZE)
+        dictEmpty(prefetched_reads, NULL);
+
+    sds encoded = encode_prefetched_read(dbid, key, field);
+    if (dictAdd(prefetched_reads, encoded, NULL) != DICT_OK)
+        sdsfree(encoded);
+}
+
+/* Called in main thread when a command is processed and finds a value in memory, check rock.c.
+ * If the value was recovered by the prefetch for the command, it is counted now like a cold read.
+ */
+void on_hot_read_for_rock_admit(const int dbid, const sds key, const sds field)
+{
+    if (server.rock_admit_min_freq == 0)
+        return;
+
+    if (forget_prefetched_read(dbid, key, field))
+        admit_cold_read(dbid, key, field);
+}
+
+/* Called in main thread by beforeSleep(), i.e., after the commands of this event loop.
+ * 
+ * If the not admitted value has been recovered and is still clean, 
+ * set it back to rock value and release it without any write.
+ * If it is not recovered yet for async mode, keep it for the next event loop.
+ * Otherwise (e.g., modified or deleted), forget it.
+ * 
+ * NOTE: We do not demote right after the command, 
+ *       because other clients waiting for the same key resume in the same event loop.
+ */
+void demote_not_admitted_cold_reads()
+{
+    if (not_admitted == NULL || listLength(not_admitted) == 0)
+        return;
+
+    listIter li;
+    listNode *ln;
+    listRewind(not_admitted, &li);
+    while ((ln = listNext(&li)))
+    {
+        notAdmitted *na = listNodeValue(ln);
+        if (na->field == NULL)
+        {
+            // the read thread is still reading it for async mode, check it in the next event loop
+            if (already_in_candidates_for_db(na->dbid, na->key))
+                continue;
+
+            if (is_clean_key_for_rock_evict(na->dbid, na->key))
+            {
+                serverAssert(try_evict_one_key_to_rocksdb(na->dbid, na->key, NULL) == TRY_EVICT_ONE_SUCCESS);
+                ++stat_demoted;
+            }
+        }
+        else
+        {
+            if (already_in_candidates_for_hash(na->dbid, na->key, na->field))
+                continue;
+
+            if (is_clean_field_of_rock_hash(na->dbid, na->key, na->field))
+            {
+                serverAssert(try_evict_one_field_to_rocksdb(na->dbid, na->key, na->field, NULL) == TRY_EVICT_ONE_SUCCESS);
+                ++stat_demoted;
+            }
+        }
+        listDelNode(not_admitted, ln);
+    }
+}
+
+sds cat_rock_admit_info(sds info)
+{
+    info = sdscatprintf(info,
+                        "rock_admit_min_freq:%d\r\n"
+                        "rock_admit_admitted:%lld\r\n"
+                        "rock_admit_not_admitted:%lld\r\n"
+                        "rock_admit_demoted:%lld\r\n",
+                        server.rock_admit_min_freq,
+                        stat_admitted,
+                        stat_not_admitted,
+                        stat_demoted);
+    return info;
+}
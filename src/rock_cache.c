@@ -0,0 +1,274 @@
+/* RedRock is based on Redis, coded by Tony. The copyright is same as Redis.
+ *
+ * Copyright (c) 2018, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* The compressed cache (opt-in by config rock-cache-size) of the values in RocksDB.
+ *
+ * Without it, a cold value is either in the write ring buffer (check rock_write.c),
+ * or it needs a RocksDB read by the read threads, i.e., the client waits for 
+ * the hand-off to read thread and the I/O of RocksDB.
+ * For the warm keys (read again soon after the eviction), it is the most of the latency.
+ *
+ * With it, when the main thread reclaims a written slot of the ring buffer,
+ * the value (the marshal value for a key, or the field value of a rock hash), 
+ * which is the same as the one in RocksDB now, is compressed by LZF and kept here
+ * instead of being freed, so the ring buffer and the cache make two tiers before RocksDB.
+ * A cold read checks the ring buffer, then the cache, and recovers the value 
+ * in main thread (sync mode) if found. Otherwise, it goes to the read threads as before.
+ *
+ * It is a write-through cache, i.e., the value is always written to RocksDB first, 
+ * so the eviction of an entry (LRU, when the memory is over rock-cache-size) is just a free.
+ *
+ * The entry is always the same as RocksDB because all writes to RocksDB for a rock key 
+ * go through the ring buffer (the reclaim of the newest slot updates or deletes the entry),
+ * except the loading (SST ingestion, warm restart) which happens after emptyDb() 
+ * (which clears the cache) or at the startup.
+ *
+ * NOTE: The memory of the cache is part of the used memory, i.e., it counts for maxrockmem.
+ */
+
+#include "rock_cache.h"
+#include "lzf.h"
+
+#define CACHE_MIN_COMPRESS_LEN      64      // smaller value is not worth compressing
+#define CACHE_ENTRY_OVERHEAD        64      // for the dict entry, list node and so on
+
+typedef struct cacheEntry {
+    sds key;            // the rock key
+    sds data;           // the compressed (or raw if not compressed) value
+    size_t raw_len;     // the length of the value. If equals to sdslen(data), not compressed
+    size_t mem;         // memory of the entry, check entry_mem()
+    listNode *node;     // in the LRU list
+} cacheEntry;
+
+/* rock key -> cacheEntry*, the key is owned by the entry */
+static dictType rockCacheDictType = {
+    dictSdsHash,                /* hash function */
+    NULL,                       /* key dup */
+    NULL,                       /* val dup */
+    dictSdsKeyCompare,          /* key compare */
+    NULL,                       /* key destructor */
+    NULL,                       /* val destructor */
+    NULL                        /* allow to expand */
+};
+
+static dict *cache_index = NULL;
+static list *cache_lru = NULL;      // head is the least recently used, only in main thread
+static size_t cache_mem = 0;
+static size_t cache_raw_bytes = 0;
+
+/* Statistics for INFO, check cat_rock_cache_info() */
+static long long stat_hits = 0;
+static long long stat_misses = 0;
+static long long stat_puts = 0;
+static long long stat_evicted = 0;
+
+void init_rock_cache()
+{
+    cache_index = dictCreate(&rockCacheDictType, NULL);
+    cache_lru = listCreate();
+}
+
+static size_t entry_mem(const cacheEntry *e)
+{
+    return sizeof(cacheEntry) + CACHE_ENTRY_OVERHEAD + sdsAllocSize(e->key) + sdsAllocSize(e->data);
+}
+
+static void free_entry(cacheEntry *e)
+{
+    serverAssert(dictDelete(cache_index, e->key) == DICT_OK);
+    listDelNode(cache_lru, e->node);
+    cache_mem -= e->mem;
+    cache_raw_bytes -= e->raw_len;
+    sdsfree(e->key);
+    sdsfree(e->data);
+    zfree(e);
+}
+
+static void evict_entries_over_limit(const size_t limit)
+{
+    while (cache_mem > limit)
+    {
+        listNode *ln = listFirst(cache_lru);
+        serverAssert(ln);
+        free_entry(listNodeValue(ln));
+        ++stat_evicted;
+    }
+}
+
+/* Compress the val for the cache. It consumes val and returns the data. */
+static sds compress_val(sds val)
+{
+    const size_t raw_len = sdslen(val);
+    if (raw_len < CACHE_MIN_COMPRESS_LEN)
+        return val;
+
+    // lzf_compress() fails if the output is not less than raw_len - 1, i.e., not worth it
+    sds data = sdsnewlen(SDS_NOINIT, raw_len - 1);
+    const unsigned int len = lzf_compress(val, raw_len, data, raw_len - 1);
+    if (len == 0)
+    {
+        sdsfree(data);
+        return val;
+    }
+
+    sdsfree(val);
+    sdssetlen(data, len);
+    data[len] = '\0';
+    return sdsRemoveFreeSpace(data);
+}
+
+/* Called in main thread when the slot of the rock key is reclaimed from the write ring buffer
+ * and the slot is the newest one of the rock key, i.e., val is the same as RocksDB.
+ * The cache takes the ownership of val.
+ */
+void put_to_rock_cache(const sds rock_key, sds val)
+{
+    const size_t limit = server.rock_cache_size;
+    if (limit == 0)
+    {
+        sdsfree(val);
+        if (dictSize(cache_index))
+            clear_rock_cache();
+        return;
+    }
+
+    del_from_rock_cache(rock_key);
+
+    // a too big value would flush the whole cache for one key
+    const size_t raw_len = sdslen(val);
+    if (raw_len > limit / 8)
+    {
+        sdsfree(val);
+        return;
+    }
+
+    cacheEntry *e = zmalloc(sizeof(cacheEntry));
+    e->key = sdsdup(rock_key);
+    e->data = compress_val(val);
+    e->raw_len = raw_len;
+    e->mem = entry_mem(e);
+    listAddNodeTail(cache_lru, e);
+    e->node = listLast(cache_lru);
+    serverAssert(dictAdd(cache_index, e->key, e) == DICT_OK);
+    cache_mem += e->mem;
+    cache_raw_bytes += raw_len;
+    ++stat_puts;
+
+    evict_entries_over_limit(limit);
+}
+
+/* Called in main thread when the value in RocksDB for the rock key is deleted, 
+ * i.e., the tombstone slot is reclaimed from the write ring buffer */
+void del_from_rock_cache(const sds rock_key)
+{
+    dictEntry *de = dictFind(cache_index, rock_key);
+    if (de)
+        free_entry(dictGetVal(de));
+}
+
+/* Called in main thread when the db(s) are emptied, check on_empty_db_for_rock_write() */
+void clear_rock_cache()
+{
+    while (listLength(cache_lru))
+        free_entry(listNodeValue(listFirst(cache_lru)));
+
+    serverAssert(cache_mem == 0 && cache_raw_bytes == 0);
+}
+
+int is_rock_cache_empty()
+{
+    return dictSize(cache_index) == 0;
+}
+
+/* Called in main thread for a cold read after the ring buffer is checked.
+ * If found, return the value (decompressed and the caller owns it), otherwise NULL.
+ *
+ * NOTE: The entry is kept, because the value could be evicted again without write 
+ *       (e.g., not admitted, check rock_admit.c) and read again soon.
+ */
+sds get_val_from_rock_cache(const sds rock_key)
+{
+    if (server.rock_cache_size == 0)
+    {
+        if (dictSize(cache_index))
+            clear_rock_cache();
+        return NULL;
+    }
+
+    dictEntry *de = dictFind(cache_index, rock_key);
+    if (de == NULL)
+    {
+        ++stat_misses;
+        return NULL;
+    }
+
+    cacheEntry *e = dictGetVal(de);
+    sds val;
+    if (e->raw_len == sdslen(e->data))
+    {
+        val = sdsdup(e->data);
+    }
+    else
+    {
+        val = sdsnewlen(SDS_NOINIT, e->raw_len);
+        if (lzf_decompress(e->data, sdslen(e->data), val, e->raw_len) != e->raw_len)
+            serverPanic("get_val_from_rock_cache() decompress failed!");
+    }
+
+    // most recently used
+    listDelNode(cache_lru, e->node);
+    listAddNodeTail(cache_lru, e);
+    e->node = listLast(cache_lru);
+    ++stat_hits;
+
+    return val;
+}
+
+sds cat_rock_cache_info(sds info)
+{
+    info = sdscatprintf(info,
+                        "rock_cache_size:%zu\r\n"
+                        "rock_cache_used_memory:%zu\r\n"
+                        "rock_cache_raw_bytes:%zu\r\n"
+                        "rock_cache_entries:%lu\r\n"
+                        "rock_cache_hits:%lld\r\n"
+                        "rock_cache_misses:%lld\r\n"
+                        "rock_cache_puts:%lld\r\n"
+                        "rock_cache_evicted:%lld\r\n",
+                        server.rock_cache_size,
+                        cache_mem,
+                        cache_raw_bytes,
+                        dictSize(cache_index),
+                        stat_hits,
+                        stat_misses,
+                        stat_puts,
+                        stat_evicted);
+    return info;
+}
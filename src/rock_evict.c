@@ -36,7 +36,9 @@
 /* For rockEvictDictType, each db has just one instance.
  * For each key which can be evicted to RocksDB, it store a key and value.
  * The key is redis db key, shared with db->dict, so do not need key destructor.
- * The value is the time.
+ * The value is NULL, or ROCK_EVICT_CLEAN_KEY if the key is clean, i.e.,
+ * it is recovered from RocksDB (or ring buffer) and has not been looked up for write since,
+ * so the record in RocksDB is the same and the eviction of it needs no write.
  * 
  * NOTE: The rockEvictDictType is not the only object for eviction to RocksDB,
  *       we have one more for each db, it is rock hash.
@@ -52,6 +54,8 @@
  * value is pointer to a dict with valid lru (which has not been evicted to RocksDB). 
  *     Check fieldLruDictType for more info.
  */
+#define ROCK_EVICT_CLEAN_KEY    ((void*)1)
+
 int dictExpandAllowed(size_t moreMem, double usedRatio);    // declaration in server.c
 dictType rockEvictDictType = {
     dictSdsHash,                /* hash function */
@@ -63,6 +67,29 @@ dictType rockEvictDictType = {
     dictExpandAllowed           /* allow to expand */
 };
 
+/* For rockMetaDictType, each db has just one instance.
+ * For each key whose whole value has been evicted to RocksDB (i.e., rock value), 
+ * it stores the cardinality of the value when it is evicted,
+ * i.e., the element count for list, set, zset and hash and the length for string.
+ * The key is redis db key, shared with db->dict, so do not need key destructor.
+ * The value is the cardinality (unsigned integer value of dictEntry).
+ * 
+ * So LLEN, SCARD, ZCARD, HLEN and STRLEN can reply a rock value from memory
+ * without reading RocksDB.
+ * 
+ * NOTE: The rock value loaded from RDB (e.g., rock-warm-restart) has no cardinality,
+ *       so these commands need to recover the value like other commands.
+ */
+dictType rockMetaDictType = {
+    dictSdsHash,                /* hash function */
+    NULL,                       /* key dup */
+    NULL,                       /* val dup */
+    dictSdsKeyCompare,          /* key compare */
+    NULL,                       /* key destructor */
+    NULL,                       /* val destructor */
+    dictExpandAllowed           /* allow to expand */
+};
+
 /* API for server initianization of db->rock_hash for each redisDB, 
  * like db->dict, db->expires */
 dict* init_rock_evict_dict(const int dbid)
@@ -70,9 +97,70 @@ dict* init_rock_evict_dict(const int dbid)
     redisDb *db = server.db + dbid;
     db->rock_key_in_disk_cnt = 0;
     db->rock_field_in_disk_cnt = 0;
+    db->rock_meta = dictCreate(&rockMetaDictType, NULL);
     return dictCreate(&rockEvictDictType, NULL);
 }
 
+static size_t get_cardinality_of_object(robj *o)
+{
+    switch(o->type)
+    {
+    case OBJ_STRING:
+        return stringObjectLen(o);
+    case OBJ_LIST:
+        return listTypeLength(o);
+    case OBJ_SET:
+        return setTypeSize(o);
+    case OBJ_ZSET:
+        return zsetLength(o);
+    case OBJ_HASH:
+        return hashTypeLength(o);
+    default:
+        serverPanic("get_cardinality_of_object() unknown type = %d", o->type);
+    }
+}
+
+/* Called in main thread by the rock_proc of LLEN, SCARD, ZCARD, HLEN and STRLEN.
+ * Return 1 if the key is a rock value and we know the cardinality of it.
+ * Otherwise, return 0 and the caller needs to recover the value from RocksDB.
+ */
+int has_cardinality_of_rock_value(const int dbid, const sds key)
+{
+    redisDb *db = server.db + dbid;
+    return dictFind(db->rock_meta, key) != NULL;
+}
+
+/* Called in main thread by the command like LLEN when the value is a rock value.
+ * The caller guarantees has_cardinality_of_rock_value() is true
+ * because the rock_proc of the command check it.
+ */
+size_t get_cardinality_of_rock_value(const int dbid, const sds key)
+{
+    redisDb *db = server.db + dbid;
+    dictEntry *de = dictFind(db->rock_meta, key);
+    serverAssert(de);
+    return dictGetUnsignedIntegerVal(de);
+}
+
+/* Called in main thread when loading a cold key from a RedRock master by rows of RocksDB.
+ * Check rdb_load_rock_cold_key() in rock_rdb_aof.c.
+ *
+ * NOTE: We must use the internal key of redis db.
+ */
+void set_cardinality_of_rock_value_when_load(const int dbid, const sds internal_key, const size_t card)
+{
+    redisDb *db = server.db + dbid;
+    dictEntry *de = dictAddOrFind(db->rock_meta, internal_key);
+    dictSetUnsignedIntegerVal(de, card);
+}
+
+static void del_cardinality_of_rock_value(const int dbid, const sds key)
+{
+    redisDb *db = server.db + dbid;
+    // NOTE: could exist in rock meta or not, e.g., loaded from RDB
+    dictDelete(db->rock_meta, key);
+}
+
 /* When redis server start and finish loading RDB/AOF,
  * we need to add the matched key to rock evict.
  * 
@@ -180,6 +268,9 @@ void on_db_del_key_for_rock_evict(const int dbid, const sds key)
     const sds internal_key = dictGetKey(de);
     robj *o = dictGetVal(de);
 
+    if (is_rock_value(o))
+        del_cardinality_of_rock_value(dbid, internal_key);
+
 #if defined RED_ROCK_DEBUG
     if (is_rock_value(o))
     {
@@ -230,6 +321,7 @@ void on_db_overwrite_key_for_rock_evict(const int dbid, const sds key, const int
     {
         serverAssert(db->rock_key_in_disk_cnt > 0);
         --db->rock_key_in_disk_cnt;
+        del_cardinality_of_rock_value(dbid, key);
     }
 
     dictEntry *de = dictFind(db->dict, key);
@@ -276,13 +368,19 @@ void on_db_visit_key_for_rock_evict(const int dbid, const sds key)
 
 /* When rock_write.c already set one whole keys's value to rock value,
  * it needs delete the key from rock evict.
+ * The evicted_o is the original value (not the rock value) which is still alive,
+ * and we record its cardinality in rock meta.
  */
-void on_rockval_key_for_rock_evict(const int dbid, const sds internal_key)
+void on_rockval_key_for_rock_evict(const int dbid, const sds internal_key, robj *evicted_o)
 {
     redisDb *db = server.db + dbid;
 
     serverAssert(dictDelete(db->rock_evict, internal_key) == DICT_OK);    
     ++db->rock_key_in_disk_cnt;
+
+    dictEntry *de = dictAddRaw(db->rock_meta, internal_key, NULL);
+    serverAssert(de);
+    dictSetUnsignedIntegerVal(de, get_cardinality_of_object(evicted_o));
 }
 
 /* When rock_read.c already recover a whole key from RocksDB or ring buffer, 
@@ -300,9 +398,34 @@ void on_recover_key_for_rock_evict(const int dbid, const sds internal_key)
     serverAssert(dictGetKey(de) == internal_key);
 #endif
 
-    serverAssert(dictAdd(db->rock_evict, internal_key, NULL) == DICT_OK);
+    // the record in RocksDB (or ring buffer) is the same as the recovered value
+    serverAssert(dictAdd(db->rock_evict, internal_key, ROCK_EVICT_CLEAN_KEY) == DICT_OK);
     serverAssert(db->rock_key_in_disk_cnt > 0);
     --db->rock_key_in_disk_cnt;
+    del_cardinality_of_rock_value(dbid, internal_key);
+}
+
+/* Called in main thread by lookupKeyWrite() when the key exists.
+ * The value could be modified in place by the command, so it is not clean anymore.
+ * 
+ * NOTE: It is conservative, e.g., EXPIRE or a failed command makes the key dirty too. 
+ */
+void on_db_write_key_for_rock_evict(const int dbid, const sds key)
+{
+    redisDb *db = server.db + dbid;
+    dictEntry *de = dictFind(db->rock_evict, key);
+    if (de)
+        dictGetVal(de) = NULL;
+}
+
+/* Called in main thread for eviction or purge of a whole key.
+ * Return 1 if the key is in memory and clean, check ROCK_EVICT_CLEAN_KEY.
+ */
+int is_clean_key_for_rock_evict(const int dbid, const sds key)
+{
+    redisDb *db = server.db + dbid;
+    dictEntry *de = dictFind(db->rock_evict, key);
+    return de != NULL && dictGetVal(de) == ROCK_EVICT_CLEAN_KEY;
 }
 
 /* When flushdb or flushalldb, it will empty the db(s).
@@ -326,20 +449,72 @@ void on_empty_db_for_rock_evict(const int dbnum)
         redisDb *db = server.db + dbid;
         dict *rock_evict = db->rock_evict;
         dictEmpty(rock_evict, NULL);
+        dictEmpty(db->rock_meta, NULL);
         db->rock_key_in_disk_cnt = 0;
     }
 }
 
+/* Return 1 if any whole key or any field of rock hash of any db is in RocksDB. 
+ * Check disklessLoadMakeBackup() in replication.c.
+ */
+int has_rock_value_in_disk()
+{
+    for (int dbid = 0; dbid < server.dbnum; ++dbid)
+    {
+        const redisDb *db = server.db + dbid;
+        if (db->rock_key_in_disk_cnt != 0 || db->rock_field_in_disk_cnt != 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Called in main thread by backupDb() in db.c after the db of dbid is moved to backup_db
+ * (for repl-diskless-load swapdb). The rock evict goes with the backup and the db gets a new one.
+ *
+ * The caller guarantees no value of the backup is in RocksDB (check has_rock_value_in_disk()).
+ * But the records in RocksDB are dropped before the new data is loaded (check emptyDb()),
+ * so no key of the backup is clean anymore.
+ */
+void on_backup_db_for_rock_evict(redisDb *backup_db, const int dbid)
+{
+    serverAssert(backup_db->rock_key_in_disk_cnt == 0 && backup_db->rock_field_in_disk_cnt == 0);
+
+    dictIterator *di = dictGetIterator(backup_db->rock_evict);
+    dictEntry *de;
+    while ((de = dictNext(di)))
+        dictGetVal(de) = NULL;
+    dictReleaseIterator(di);
+
+    server.db[dbid].rock_evict = init_rock_evict_dict(dbid);
+}
+
+/* Called in main thread by discardDbBackup() for the backup 
+ * and by restoreDbBackup() for the emptied db in db.c. 
+ */
+void release_rock_evict_of_db(redisDb *db)
+{
+    dictRelease(db->rock_evict);
+    dictRelease(db->rock_meta);
+}
+
 /*                                              */
 /* The following is for eviction pool operation */
 /*                                              */
 
-#define EVPOOL_SIZE             16      // like Redis eviction pool size
+/* Redis uses 16 for the pool and samples 5 keys each time.
+ * When rock-evict-size-aware is enabled, the score also considers the size of value,
+ * so a bigger pool and more samples keep more good candidates across the samples.
+ * Otherwise, the sizes are the same as Redis, check get_evict_pool_size().
+ * The pools are allocated with the max size, so the config can be changed at any time.
+ */
+#define EVPOOL_MAX_SIZE         64
+#define EVPOOL_REDIS_SIZE       16
+#define EVPOOL_REDIS_SAMPLES    5
 #define EVPOOL_CACHED_SDS_SIZE  255
 
 struct evictKeyPoolEntry 
 {
-    unsigned long long idle;    /* Object idle time (inverse frequency for LFU) */
+    unsigned long long score;   /* Bigger is better to evict, check score_for_eviction() */
     sds key;                    /* Key name. */
     sds cached;                 /* Cached SDS object for key name. */
     int dbid;                   /* Key DB number. */
@@ -347,7 +522,7 @@ struct evictKeyPoolEntry
 
 struct evictHashPoolEntry 
 {
-    unsigned long long idle;
+    unsigned long long score;
     sds field;
     sds cached_field;       /* Cached SDS object for field. */
     sds hash_key;
@@ -363,11 +538,11 @@ static struct evictHashPoolEntry *evict_hash_pool = NULL;
 static void evict_key_pool_alloc(void) 
 {
     struct evictKeyPoolEntry *ep = 
-           zmalloc(sizeof(struct evictKeyPoolEntry) * EVPOOL_SIZE);
+           zmalloc(sizeof(struct evictKeyPoolEntry) * EVPOOL_MAX_SIZE);
 
-    for (int i = 0; i < EVPOOL_SIZE; ++i) 
+    for (int i = 0; i < EVPOOL_MAX_SIZE; ++i) 
     {
-        ep[i].idle = 0;
+        ep[i].score = 0;
         ep[i].key = NULL;
         ep[i].cached = sdsnewlen(NULL,EVPOOL_CACHED_SDS_SIZE);
         ep[i].dbid = 0;
@@ -379,11 +554,11 @@ static void evict_key_pool_alloc(void)
 /* Create a new eviction pool for rock hash. */
 static void evict_hash_pool_alloc(void) {
     struct evictHashPoolEntry *ep = 
-           zmalloc(sizeof(struct evictHashPoolEntry) * EVPOOL_SIZE);
+           zmalloc(sizeof(struct evictHashPoolEntry) * EVPOOL_MAX_SIZE);
 
-    for (int i = 0; i < EVPOOL_SIZE; ++i) 
+    for (int i = 0; i < EVPOOL_MAX_SIZE; ++i) 
     {
-        ep[i].idle = 0;
+        ep[i].score = 0;
         ep[i].field = NULL;
         ep[i].hash_key = NULL;
         ep[i].cached_field = sdsnewlen(NULL,EVPOOL_CACHED_SDS_SIZE);
@@ -417,22 +592,66 @@ static int same_key_in_evict_pool(const sds key, struct evictKeyPoolEntry *pool,
     return 0;
 }
 
+/* Like estimateObjectIdleTime() in evict.c but for the lru clock of a field in rock hash */
+static unsigned long long estimate_idle_time_of_lru_clock(const unsigned int lru)
+{
+    const unsigned long long lruclock = LRU_CLOCK();
+    if (lruclock >= lru)
+        return (lruclock - lru) * LRU_CLOCK_RESOLUTION;
+    else
+        return (lruclock + (LRU_CLOCK_MAX - lru)) * LRU_CLOCK_RESOLUTION;
+}
+
+/* The score of a candidate for eviction when rock-evict-size-aware is enabled.
+ * Bigger score is better to evict.
+ * 
+ * The benefit of an eviction is the memory freed, i.e., mem.
+ * The cost is the read from RocksDB if the value is accessed again,
+ * the chance of which is inverse to the idle time (or the frequency for LFU).
+ * A cold miss costs about ROCK_READ_COST_BYTES (e.g., one block of RocksDB 
+ * and the round trip of the read thread) plus the size of the value.
+ * So the score is idle * mem / (mem + ROCK_READ_COST_BYTES), 
+ * e.g., a 10 MB value is about 200 times better than a 20 bytes value with the same idle time. 
+ * 
+ * The score is scaled by 1024 for the precision of small values.
+ */
+#define ROCK_READ_COST_BYTES    4096
+#define SCORE_SIZE_SAMPLES      8       // for objectComputeSize()
+static unsigned long long score_for_eviction(const unsigned long long idle, const size_t mem)
+{
+    return (unsigned long long)((long double)idle * 1024 * mem / (mem + ROCK_READ_COST_BYTES));
+}
+
+/* The pool size and the sample number in use, check EVPOOL_MAX_SIZE */
+static int get_evict_pool_size()
+{
+    return server.rock_evict_size_aware ? EVPOOL_MAX_SIZE : EVPOOL_REDIS_SIZE;
+}
+
+static unsigned int get_evict_sample_number(const unsigned int size_aware_number)
+{
+    return server.rock_evict_size_aware ? size_aware_number : EVPOOL_REDIS_SAMPLES;
+}
+
 /* Check evcit.c evictionPoolPopulate() for more details.
  * We use the similiar algorithm for eviction so it needs to populate
  * the eviction pool and use some tricks for optimization of cached sds.
  * 
  * Return the number of populated key.
  */
-#define SAMPLE_KEY_NUMBER           5       // like Redis sample number
+#define SAMPLE_KEY_NUMBER           10      // the max, check get_evict_sample_number()
 static size_t evict_key_pool_populate(const int dbid)
 {
+    size_t objectComputeSize(robj *o, size_t sample_size);  // declaration in object.c
+
     // first, sample some keys from rock_evict
     redisDb *db = server.db + dbid;
     if (dictSize(db->rock_evict) == 0)
         return 0;
 
+    const int pool_size = get_evict_pool_size();
     dictEntry* sample_des[SAMPLE_KEY_NUMBER];
-    const unsigned int count = dictGetSomeKeys(db->rock_evict, sample_des, SAMPLE_KEY_NUMBER);
+    const unsigned int count = dictGetSomeKeys(db->rock_evict, sample_des, get_evict_sample_number(SAMPLE_KEY_NUMBER));
     if (count == 0)
         return 0;       // NOTE dictGetSomeKeys could return zero if dict size is very low
 
@@ -448,27 +667,29 @@ static size_t evict_key_pool_populate(const int dbid)
         serverAssert(de_db);
         robj *o = dictGetVal(de_db);
 
-        if (same_key_in_evict_pool(dictGetKey(de_db), pool, EVPOOL_SIZE))
+        if (same_key_in_evict_pool(dictGetKey(de_db), pool, EVPOOL_MAX_SIZE))
             continue;
         
-        unsigned long long idle = server.maxmemory_policy & MAXMEMORY_FLAG_LFU ? 
-                                  255 - (o->lru & 255) : estimateObjectIdleTime(o);
+        const unsigned long long idle = server.maxmemory_policy & MAXMEMORY_FLAG_LFU ? 
+                                        255 - (o->lru & 255) : estimateObjectIdleTime(o);
+        const unsigned long long score = server.rock_evict_size_aware ? 
+                                         score_for_eviction(idle, objectComputeSize(o, SCORE_SIZE_SAMPLES)) : idle;
 
         /* Insert the element inside the pool.
          * First, find the first empty bucket or the first populated
-         * bucket that has an idle time smaller than our idle time. */
+         * bucket that has a score smaller than our score. */
         int k = 0;
-        while (k < EVPOOL_SIZE &&
+        while (k < pool_size &&
                pool[k].key &&
-               pool[k].idle < idle) k++;
+               pool[k].score < score) k++;
 
-        if (k == 0 && pool[EVPOOL_SIZE-1].key != NULL) 
+        if (k == 0 && pool[pool_size-1].key != NULL) 
         {
             /* Can't insert if the element is < the worst element we have
              * and there are no empty buckets. */
             continue;
         } 
-        else if (k < EVPOOL_SIZE && pool[k].key == NULL) 
+        else if (k < pool_size && pool[k].key == NULL) 
         {
             /* Inserting into empty position. No setup needed before insert. */
         } 
@@ -476,15 +697,15 @@ static size_t evict_key_pool_populate(const int dbid)
         {
             /* Inserting in the middle. Now k points to the first element
              * greater than the element to insert.  */
-            if (pool[EVPOOL_SIZE-1].key == NULL) 
+            if (pool[pool_size-1].key == NULL) 
             {
                 /* Free space on the right? Insert at k shifting
                  * all the elements from k to end to the right. */
 
                 /* Save SDS before overwriting. */
-                sds cached = pool[EVPOOL_SIZE-1].cached;
+                sds cached = pool[pool_size-1].cached;
                 memmove(pool+k+1, pool+k,
-                    sizeof(pool[0])*(EVPOOL_SIZE-k-1));
+                    sizeof(pool[0])*(pool_size-k-1));
                 pool[k].cached = cached;
             } 
             else 
@@ -492,7 +713,7 @@ static size_t evict_key_pool_populate(const int dbid)
                 /* No free space on right? Insert at k-1 */
                 k--;
                 /* Shift all elements on the left of k (included) to the
-                 * left, so we discard the element with smaller idle time. */
+                 * left, so we discard the element with smaller score. */
                 sds cached = pool[0].cached; /* Save SDS before overwriting. */
                 if (pool[0].key != pool[0].cached) sdsfree(pool[0].key);
                 memmove(pool, pool+1, sizeof(pool[0])*k);
@@ -517,7 +738,7 @@ static size_t evict_key_pool_populate(const int dbid)
             pool[k].key = pool[k].cached;
         }
 
-        pool[k].idle = idle;
+        pool[k].score = score;
         pool[k].dbid = dbid;
     }
 
@@ -544,7 +765,7 @@ static int same_fieldin_evict_pool(const sds hash_key, const sds field,
  * The algorithm is similiar. 
  */
 #define SAMPLE_HASH_KEY_NUMBER     5
-#define SAMPLE_HASH_FIELD_NUMBER    5
+#define SAMPLE_HASH_FIELD_NUMBER    10      // the max, check get_evict_sample_number()
 static size_t evict_hash_pool_populate(const int dbid)
 {
     // first, sample some fields from rock_hash
@@ -585,21 +806,33 @@ static size_t evict_hash_pool_populate(const int dbid)
     if (dictSize(lrus) == 0)
         return 0;   
 
+    const int pool_size = get_evict_pool_size();
     dictEntry* sample_field_des[SAMPLE_HASH_FIELD_NUMBER];
-    const unsigned int field_count = dictGetSomeKeys(lrus, sample_field_des, SAMPLE_HASH_FIELD_NUMBER);
+    const unsigned int field_count = dictGetSomeKeys(lrus, sample_field_des, 
+                                                     get_evict_sample_number(SAMPLE_HASH_FIELD_NUMBER));
     if (field_count == 0)
         return 0;   // NOTE dictGetSomeKeys could return zero if dict size is very slow
 
     size_t insert_cnt = 0;
     struct evictHashPoolEntry *pool = evict_hash_pool;
 
+    dict *dict_hash = NULL;
+    if (server.rock_evict_size_aware)
+    {
+        dictEntry *de_db = dictFind(db->dict, hash_key);
+        serverAssert(de_db);
+        robj *o = dictGetVal(de_db);
+        serverAssert(o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT);
+        dict_hash = o->ptr;
+    }
+
     for (int j = 0; j < (int)field_count; j++) 
     {
         dictEntry *de_field = sample_field_des[j];
         const sds field = dictGetKey(de_field);
         const unsigned int lru = (uint64_t)dictGetVal(de_field);
 
-        if (same_fieldin_evict_pool(hash_key, field, pool, EVPOOL_SIZE))
+        if (same_fieldin_evict_pool(hash_key, field, pool, EVPOOL_MAX_SIZE))
             continue;
 
         #if defined RED_ROCK_DEBUG
@@ -611,24 +844,34 @@ static size_t evict_hash_pool_populate(const int dbid)
         serverAssert(dictSize(lrus) <= dictSize(dict_hash));
         #endif
         
-        unsigned long long idle = server.maxmemory_policy & MAXMEMORY_FLAG_LFU ? 
-                                  255 - (lru & 255) : lru;
+        unsigned long long score = server.maxmemory_policy & MAXMEMORY_FLAG_LFU ? 
+                                   255 - (lru & 255) : lru;
+        if (dict_hash)
+        {
+            // NOTE: for LRU, it is the clock, not the idle time. Check rock_hash.c
+            const unsigned long long idle = server.maxmemory_policy & MAXMEMORY_FLAG_LFU ? 
+                                            score : estimate_idle_time_of_lru_clock(lru);
+            dictEntry *de_hash = dictFind(dict_hash, field);
+            serverAssert(de_hash);
+            const size_t mem = sdsAllocSize(field) + sdsAllocSize(dictGetVal(de_hash)) + sizeof(dictEntry);
+            score = score_for_eviction(idle, mem);
+        }
 
         /* Insert the element inside the pool.
          * First, find the first empty bucket or the first populated
-         * bucket that has an idle time smaller than our idle time. */
+         * bucket that has a score smaller than our score. */
         int k = 0;
-        while (k < EVPOOL_SIZE &&
+        while (k < pool_size &&
                pool[k].field &&
-               pool[k].idle < idle) k++;
+               pool[k].score < score) k++;
 
-        if (k == 0 && pool[EVPOOL_SIZE-1].field != NULL) 
+        if (k == 0 && pool[pool_size-1].field != NULL) 
         {
             /* Can't insert if the element is < the worst element we have
              * and there are no empty buckets. */
             continue;
         } 
-        else if (k < EVPOOL_SIZE && pool[k].field == NULL) 
+        else if (k < pool_size && pool[k].field == NULL) 
         {
             /* Inserting into empty position. No setup needed before insert. */
         } 
@@ -636,16 +879,16 @@ static size_t evict_hash_pool_populate(const int dbid)
         {
             /* Inserting in the middle. Now k points to the first element
              * greater than the element to insert.  */
-            if (pool[EVPOOL_SIZE-1].field == NULL) 
+            if (pool[pool_size-1].field == NULL) 
             {
                 /* Free space on the right? Insert at k shifting
                  * all the elements from k to end to the right. */
 
                 /* Save SDS before overwriting. */
-                sds cached_field = pool[EVPOOL_SIZE-1].cached_field;
-                sds cached_hash_key = pool[EVPOOL_SIZE-1].cached_hash_key;
+                sds cached_field = pool[pool_size-1].cached_field;
+                sds cached_hash_key = pool[pool_size-1].cached_hash_key;
                 memmove(pool+k+1, pool+k,
-                    sizeof(pool[0])*(EVPOOL_SIZE-k-1));
+                    sizeof(pool[0])*(pool_size-k-1));
                 pool[k].cached_field = cached_field;
                 pool[k].cached_hash_key = cached_hash_key;
             } 
@@ -654,7 +897,7 @@ static size_t evict_hash_pool_populate(const int dbid)
                 /* No free space on right? Insert at k-1 */
                 k--;
                 /* Shift all elements on the left of k (included) to the
-                 * left, so we discard the element with smaller idle time. */
+                 * left, so we discard the element with smaller score. */
                 sds cached_field = pool[0].cached_field; /* Save SDS before overwriting. */
                 sds cached_hash_key = pool[0].cached_hash_key;
                 if (pool[0].field != pool[0].cached_field) sdsfree(pool[0].field);
@@ -693,7 +936,7 @@ static size_t evict_hash_pool_populate(const int dbid)
             pool[k].hash_key = pool[k].cached_hash_key;
         }
 
-        pool[k].idle = idle;
+        pool[k].score = score;
         pool[k].dbid = dbid;
     }
 
@@ -715,7 +958,7 @@ static void pick_best_key_from_key_pool(int *best_dbid, sds *best_key)
     struct evictKeyPoolEntry *pool = evict_key_pool;
 
     /* Go backward from best to worst element to evict. */
-    for (int k = EVPOOL_SIZE-1; k >= 0; k--) 
+    for (int k = EVPOOL_MAX_SIZE-1; k >= 0; k--) 
     {
         if (pool[k].key == NULL) continue;
 
@@ -729,7 +972,7 @@ static void pick_best_key_from_key_pool(int *best_dbid, sds *best_key)
             sdsfree(pool[k].key);
 
         pool[k].key = NULL;
-        pool[k].idle = 0;
+        pool[k].score = 0;
 
         /* Check ghost key.
          * What is the situation for ghost key?
@@ -766,7 +1009,7 @@ static void pick_best_field_from_hash_pool(int *best_dbid, sds *best_field, sds
     struct evictHashPoolEntry *pool = evict_hash_pool;
 
     /* Go backward from best to worst element to evict. */
-    for (int k = EVPOOL_SIZE-1; k >= 0; k--) {
+    for (int k = EVPOOL_MAX_SIZE-1; k >= 0; k--) {
         if (pool[k].field == NULL) continue;
 
         const int dbid = pool[k].dbid;
@@ -791,7 +1034,7 @@ static void pick_best_field_from_hash_pool(int *best_dbid, sds *best_field, sds
 
         pool[k].hash_key = NULL;
         pool[k].field = NULL;
-        pool[k].idle = 0;
+        pool[k].score = 0;
 
         /* Check ghost field.
          * What is the situation for ghost field?
@@ -1121,6 +1364,16 @@ static size_t perform_field_eviction(const size_t want_to_free, const unsigned i
     return free_total;
 }
 
+/* The evicted objects handed over to write thread will be freed soon,
+ * so we treat them as freed. Check rock-marshal-in-write-thread and rock_write.c
+ */
+static size_t get_used_mem_for_eviction()
+{
+    const size_t used = zmalloc_used_memory();
+    const size_t not_freed = get_evicted_mem_not_freed_by_write_thread();
+    return used > not_freed ? used - not_freed : 0;
+}
+
 /* return 1 to choose key eviction, 0 to choose field eviction. -1 means key and field are all empty */
 static int choose_key_or_field_eviction()
 {
@@ -1144,6 +1397,143 @@ static int choose_key_or_field_eviction()
     return key_cnt >= field_cnt;
 }
 
+/* Watermarks and the rate controller for the eviction.
+ *
+ * When used memory goes over the high watermark (rock-evict-high-watermark percent of maxrockmem),
+ * the eviction becomes active and evicts until used memory is under the low watermark
+ * (rock-evict-low-watermark percent of maxrockmem), then it becomes inactive.
+ *
+ * While active, the eviction runs not only in cron but also in beforeSleep(),
+ * i.e., between event loop iterations, with a small time budget for each round.
+ * The size for each round is from the rate controller:
+ *     the allocation rate (bytes per second, measured in cron) * the elapsed time since last round
+ *     + a part (1/EVICTION_CATCH_UP_ROUNDS) of the gap between used memory and the low watermark
+ * so the eviction throughput follows the write bursts instead of 
+ * the memory overshooting maxrockmem before the next cron.
+ *
+ * If used memory is over maxrockmem, the size is the whole gap to the low watermark,
+ * like the old cron-only eviction.
+ */
+#define EVICTION_BEFORE_SLEEP_TIMEOUT_US (1<<8)     // about 0.25 ms
+#define EVICTION_CATCH_UP_ROUNDS 8
+
+static int evict_active = 0;
+static monotime last_round_time = 0;
+
+// the rate controller, measured in cron, check update_rate_of_eviction_in_cron()
+static size_t alloc_rate = 0;           // bytes per second
+static size_t evict_rate = 0;           // bytes per second
+static size_t freed_since_sample = 0;
+
+/* Statistics for INFO, check cat_rock_evict_info() */
+static size_t stat_freed_in_cron = 0;
+static size_t stat_freed_before_sleep = 0;
+static long long stat_over_max_in_cron = 0;
+
+static size_t get_watermark_of_rock_mem(const unsigned long long max_rock_mem, const int percent)
+{
+    return max_rock_mem / 100 * percent;
+}
+
+/* NOTE: config guarantees rock-evict-low-watermark < rock-evict-high-watermark */
+static size_t get_low_watermark()
+{
+    return get_watermark_of_rock_mem(get_max_rock_mem_of_os(), server.rock_evict_low_watermark);
+}
+
+static size_t get_high_watermark()
+{
+    return get_watermark_of_rock_mem(get_max_rock_mem_of_os(), server.rock_evict_high_watermark);
+}
+
+/* Called in main thread by rock_admit.c.
+ * Return 1 if the used memory is over the low watermark,
+ * i.e., a new value in memory will cause the eviction of others soon.
+ */
+int is_rock_mem_under_pressure()
+{
+    return get_used_mem_for_eviction() >= get_low_watermark();
+}
+
+/* Called in cron to measure the allocation rate and the eviction rate.
+ * The allocation in the period is the increase of used memory plus what the eviction freed.
+ */
+static void update_rate_of_eviction_in_cron(const size_t used)
+{
+    static monotime last_sample_time = 0;
+    static size_t last_sample_used = 0;
+
+    if (last_sample_time == 0)
+    {
+        last_sample_time = getMonotonicUs();
+        last_sample_used = used;
+        freed_since_sample = 0;
+        return;
+    }
+
+    const uint64_t elapsed_us = getMonotonicUs() - last_sample_time;
+    if (elapsed_us == 0)
+        return;
+
+    const size_t increased = used + freed_since_sample;
+    const size_t allocated = increased > last_sample_used ? increased - last_sample_used : 0;
+    const size_t cur_alloc_rate = (size_t)((double)allocated * 1000000 / elapsed_us);
+    const size_t cur_evict_rate = (size_t)((double)freed_since_sample * 1000000 / elapsed_us);
+
+    // EWMA with weight 1/4 for the current sample 
+    alloc_rate = alloc_rate / 4 * 3 + cur_alloc_rate / 4;
+    evict_rate = evict_rate / 4 * 3 + cur_evict_rate / 4;
+
+    last_sample_time = getMonotonicUs();
+    last_sample_used = used;
+    freed_since_sample = 0;
+}
+
+/* Return the size in bytes which this round of eviction wants to free. 
+ * 0 means no need for eviction.
+ */
+static size_t get_want_to_free_of_this_round(const size_t used)
+{
+    const size_t low = get_low_watermark();
+    if (evict_active)
+    {
+        if (used <= low)
+            evict_active = 0;
+    }
+    else
+    {
+        if (used >= get_high_watermark() || used >= get_max_rock_mem_of_os())
+            evict_active = 1;
+    }
+
+    const monotime now = getMonotonicUs();
+    const uint64_t elapsed_us = last_round_time == 0 ? 0 : now - last_round_time;
+    last_round_time = now;
+
+    if (!evict_active)
+        return 0;
+
+    const size_t gap = used - low;
+    if (used >= get_max_rock_mem_of_os())
+        return gap;
+
+    const size_t by_rate = (size_t)((double)alloc_rate * elapsed_us / 1000000);
+    const size_t want_to_free = by_rate + gap / EVICTION_CATCH_UP_ROUNDS;
+    return want_to_free > gap ? gap : want_to_free;
+}
+
+static size_t perform_one_round_of_eviction(const size_t want_to_free, const unsigned int timeout_us)
+{
+    const int choice_for_key = choose_key_or_field_eviction();
+    if (choice_for_key == -1)
+        return 0;     // all db empty for evictions
+
+    const size_t freed = choice_for_key ? perform_key_eviction(want_to_free, timeout_us) : 
+                                          perform_field_eviction(want_to_free, timeout_us);
+    freed_since_sample += freed;
+    return freed;
+}
+
 #define EVICTION_MIN_TIMEOUT_US (1<<10)             // about 1 ms
 #define EVICTION_MAX_TIMEOUT_US (1<<12)             // about 4 ms
 /* It is called in main thread cron to evict some memory.
@@ -1160,10 +1550,13 @@ int perform_rock_eviction_in_cron()
     static unsigned int timeout = EVICTION_MIN_TIMEOUT_US;
     static long long last_stat_numcommands = 0L;
     
-    const unsigned long long max_rock_mem = get_max_rock_mem_of_os();
+    const size_t used = get_used_mem_for_eviction();
+    update_rate_of_eviction_in_cron(used);
+    if (used >= get_max_rock_mem_of_os())
+        ++stat_over_max_in_cron;
 
-    const size_t used = zmalloc_used_memory();
-    if (used < max_rock_mem)
+    const size_t want_to_free = get_want_to_free_of_this_round(used);
+    if (want_to_free == 0)
     {
         #ifdef RED_ROCK_EVICT_INFO
         if (timing_in_process)
@@ -1172,7 +1565,7 @@ int perform_rock_eviction_in_cron()
         timing_in_process = 0;
         #endif        
         
-        return 0;     // memory usage is under limit, do nothing
+        return 0;     // memory usage is under watermark, do nothing
     }
 
     #ifdef RED_ROCK_EVICT_INFO
@@ -1183,8 +1576,6 @@ int perform_rock_eviction_in_cron()
     } 
     #endif
 
-    const size_t want_to_free = used - get_max_rock_mem_of_os();
-
     if (server.stat_numcommands != last_stat_numcommands)
     {
         // If there are some commands in the periood, i.e., server is busy, 
@@ -1200,24 +1591,62 @@ int perform_rock_eviction_in_cron()
             timeout = EVICTION_MAX_TIMEOUT_US;
     }
 
-    const int choice_for_key = choose_key_or_field_eviction();
-    if (choice_for_key == -1)
+    if (choose_key_or_field_eviction() == -1)
         return 0;     // all db empty for evictions
 
-    if (choice_for_key)
-    {
-        perform_key_eviction(want_to_free, timeout);
-    }
-    else
-    {
-        perform_field_eviction(want_to_free, timeout);
-    }
+    stat_freed_in_cron += perform_one_round_of_eviction(want_to_free, timeout);
     return 1;
 }
 
+/* It is called in main thread beforeSleep() to evict some memory 
+ * between event loop iterations when the eviction is active.
+ * Check the comments above for the watermarks and the rate controller.
+ */
+void perform_rock_eviction_before_sleep()
+{
+    const size_t used = get_used_mem_for_eviction();
+    if (!evict_active && used < get_high_watermark() && used < get_max_rock_mem_of_os())
+        return;     // fast path for most of the time
+
+    const size_t want_to_free = get_want_to_free_of_this_round(used);
+    if (want_to_free == 0)
+        return;
+
+    const unsigned int timeout = used >= get_max_rock_mem_of_os() ? 
+                                 EVICTION_MIN_TIMEOUT_US : EVICTION_BEFORE_SLEEP_TIMEOUT_US;
+    stat_freed_before_sleep += perform_one_round_of_eviction(want_to_free, timeout);
+}
+
+sds cat_rock_evict_info(sds info)
+{
+    const size_t used = get_used_mem_for_eviction();
+    info = sdscatprintf(info,
+                        "rock_evict_used_mem:%zu\r\n"
+                        "rock_evict_low_watermark:%zu\r\n"
+                        "rock_evict_high_watermark:%zu\r\n"
+                        "rock_evict_max_rock_mem:%llu\r\n"
+                        "rock_evict_active:%d\r\n"
+                        "rock_evict_alloc_rate:%zu\r\n"
+                        "rock_evict_evict_rate:%zu\r\n"
+                        "rock_evict_freed_in_cron:%zu\r\n"
+                        "rock_evict_freed_before_sleep:%zu\r\n"
+                        "rock_evict_over_max_in_cron:%lld\r\n",
+                        used,
+                        get_low_watermark(),
+                        get_high_watermark(),
+                        get_max_rock_mem_of_os(),
+                        evict_active,
+                        alloc_rate,
+                        evict_rate,
+                        stat_freed_in_cron,
+                        stat_freed_before_sleep,
+                        stat_over_max_in_cron);
+    return info;
+}
+
 static size_t get_freed_mem_for_rock_mem(const size_t start_used)
 {
-    size_t current_used = zmalloc_used_memory();
+    size_t current_used = get_used_mem_for_eviction();
     if (current_used < start_used)
     {
         return start_used - current_used;;
@@ -1241,7 +1670,7 @@ size_t perform_rock_eviction_for_rock_mem(const size_t want_to_free, const size_
 {
     monotime timer;
     elapsedStart(&timer);
-    size_t start_used = zmalloc_used_memory();
+    size_t start_used = get_used_mem_for_eviction();
 
     while (1)
     {
@@ -1260,7 +1689,7 @@ size_t perform_rock_eviction_for_rock_mem(const size_t want_to_free, const size_
         }
 
         // check memory usage
-        size_t current_used = zmalloc_used_memory();
+        size_t current_used = get_used_mem_for_eviction();
         if (current_used < start_used && start_used - current_used >= want_to_free)
             return start_used - current_used;
 
@@ -48,16 +48,28 @@ void on_db_del_key_for_rock_evict(const int dbid, const sds key);
 void on_db_overwrite_key_for_rock_evict(const int dbid, const sds key, const int is_old_rock_val, const robj *new_o);
 void on_transfer_to_rock_hash(const int dbid, const sds internal_key);
 void on_db_visit_key_for_rock_evict(const int dbid, const sds key);
-void on_rockval_key_for_rock_evict(const int dbid, const sds internal_key);
+void on_rockval_key_for_rock_evict(const int dbid, const sds internal_key, robj *evicted_o);
 void on_recover_key_for_rock_evict(const int dbid, const sds internal_key);
+void on_db_write_key_for_rock_evict(const int dbid, const sds key);
+int is_clean_key_for_rock_evict(const int dbid, const sds key);
 void on_empty_db_for_rock_evict(const int dbnum);
+int has_rock_value_in_disk();
+void on_backup_db_for_rock_evict(redisDb *backup_db, const int dbid);
+void release_rock_evict_of_db(redisDb *db);
+
+int has_cardinality_of_rock_value(const int dbid, const sds key);
+size_t get_cardinality_of_rock_value(const int dbid, const sds key);
+void set_cardinality_of_rock_value_when_load(const int dbid, const sds internal_key, const size_t card);
 
 void evict_pool_init();
+int is_rock_mem_under_pressure();
 
 // for test
 // size_t perform_key_eviction(const size_t want_to_free);
 // size_t perform_field_eviction(const size_t want_to_free);
 int perform_rock_eviction_in_cron();
+void perform_rock_eviction_before_sleep();
+sds cat_rock_evict_info(sds info);
 size_t perform_rock_eviction_for_rock_mem(const size_t want_to_free, const size_t timeout_in_ms);
 
 #endif
@@ -179,6 +179,14 @@ static void debug_check_rock_hash_field_cnt(const int dbid, const char *from)
 }
 #endif
 
+/* A bit above the 24 bits of lru in lrus. 
+ * If set, the field is recovered from RocksDB (or ring buffer) and not modified since, 
+ * i.e., the record in RocksDB is the same as the value in memory,
+ * so the eviction of it needs no write, check try_evict_one_field_to_rocksdb().
+ * Any overwrite of the field resets the lru without the bit.
+ */
+#define ROCK_HASH_FIELD_CLEAN   (1ULL<<32)
+
 /* Calculate the first lru info for rock hash.
  * Referecne object.c createObject()
  * For LFU, use default counter LFU_INIT_VAL which is 5.
@@ -456,7 +464,7 @@ void on_visit_field_of_hash_for_readonly(const int dbid, const sds redis_key, co
                 serverPanic("on_visit_field_of_hash() field in lrus but not in hash, field = %s", field);
             #endif
             const uint64_t old_lru = (uint64_t)dictGetVal(de_lru);
-            const uint64_t new_lru = get_update_lru_for_rock_hash(old_lru);
+            const uint64_t new_lru = get_update_lru_for_rock_hash(old_lru) | (old_lru & ROCK_HASH_FIELD_CLEAN);
             dictGetVal(de_lru) = (void*)new_lru;
         }
         #if defined RED_ROCK_DEBUG
@@ -501,7 +509,7 @@ void on_visit_all_fields_of_hash_for_readonly(const int dbid, const sds redis_ke
         while ((de_lrus = dictNext(di_lrus)))
         {
             const uint64_t old_lru = (uint64_t)dictGetVal(de_lrus);
-            const uint64_t new_lru = get_update_lru_for_rock_hash(old_lru);
+            const uint64_t new_lru = get_update_lru_for_rock_hash(old_lru) | (old_lru & ROCK_HASH_FIELD_CLEAN);
             dictGetVal(de_lrus) = (void*)new_lru;
         }
         dictReleaseIterator(di_lrus);
@@ -592,7 +600,8 @@ void on_recover_field_of_hash(const int dbid, const sds redis_key, const sds fie
     serverAssert(de_rock_hash);
     dict *lrus = dictGetVal(de_rock_hash);
 
-    uint64_t clock = get_init_lru_for_rock_hash();
+    // the field is clean until it is overwritten, check ROCK_HASH_FIELD_CLEAN
+    uint64_t clock = get_init_lru_for_rock_hash() | ROCK_HASH_FIELD_CLEAN;
     // internal_field must not exist in lrus becuase of on_rockval_field_of_hash()
     serverAssert(dictAdd(lrus, internal_field, (void*)clock) == DICT_OK); 
     ++db->rock_hash_field_cnt;
@@ -796,6 +805,79 @@ void on_empty_db_for_hash(const int dbnum)
     }
 }
 
+/* Called in main thread by backupDb() in db.c after the db of dbid is moved to backup_db.
+ * Like on_backup_db_for_rock_evict(), the rock hash goes with the backup 
+ * and no field of the backup is clean anymore.
+ */
+void on_backup_db_for_hash(redisDb *backup_db, const int dbid)
+{
+    serverAssert(backup_db->rock_field_in_disk_cnt == 0);
+
+    dictIterator *di_hash = dictGetIterator(backup_db->rock_hash);
+    dictEntry *de_hash;
+    while ((de_hash = dictNext(di_hash)))
+    {
+        dict *lrus = dictGetVal(de_hash);
+        dictIterator *di_lru = dictGetIterator(lrus);
+        dictEntry *de_lru;
+        while ((de_lru = dictNext(di_lru)))
+            dictGetVal(de_lru) = (void*)((uint64_t)dictGetVal(de_lru) & ~ROCK_HASH_FIELD_CLEAN);
+        dictReleaseIterator(di_lru);
+    }
+    dictReleaseIterator(di_hash);
+
+    redisDb *db = server.db + dbid;
+    db->rock_hash = init_rock_hash_dict();
+    db->rock_hash_field_cnt = 0;
+}
+
+/* Called in main thread by discardDbBackup() and restoreDbBackup() in db.c,
+ * check release_rock_evict_of_db().
+ */
+void release_rock_hash_of_db(redisDb *db)
+{
+    dictRelease(db->rock_hash);
+}
+
+/* Called in main thread for eviction or purge of a field of rock hash.
+ * Return 1 if the field is in memory and clean, check ROCK_HASH_FIELD_CLEAN.
+ */
+int is_clean_field_of_rock_hash(const int dbid, const sds redis_key, const sds field)
+{
+    redisDb *db = server.db + dbid;
+    dictEntry *de_rock_hash = dictFind(db->rock_hash, redis_key);
+    if (de_rock_hash == NULL)
+        return 0;
+
+    dict *lrus = dictGetVal(de_rock_hash);
+    dictEntry *de_lru = dictFind(lrus, field);
+    if (de_lru == NULL)
+        return 0;
+
+    return ((uint64_t)dictGetVal(de_lru) & ROCK_HASH_FIELD_CLEAN) != 0;
+}
+
+/* Called in main thread by rock_read.c.
+ * Return the number of fields whose values are in RocksDB for the rock hash.
+ * Every field not in lrus is a cold field, check debug_check_lru().
+ */
+size_t get_cold_field_num_of_rock_hash(const int dbid, const sds redis_key)
+{
+    redisDb *db = server.db + dbid;
+    dictEntry *de_rock_hash = dictFind(db->rock_hash, redis_key);
+    if (de_rock_hash == NULL)
+        return 0;
+
+    dict *lrus = dictGetVal(de_rock_hash);
+    dictEntry *de_db = dictFind(db->dict, redis_key);
+    serverAssert(de_db);
+    const robj *o = dictGetVal(de_db);
+    serverAssert(o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT);
+    const dict *hash = o->ptr;
+    serverAssert(dictSize(hash) >= dictSize(lrus));
+    return dictSize(hash) - dictSize(lrus);
+}
+
 /* If in rock hash, return 1.
  * Otherwise, return 0.
  */
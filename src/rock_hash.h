@@ -46,8 +46,12 @@ void on_overwrite_field_for_rock_hash(const int dbid, const sds redis_key, const
 void on_rockval_field_of_hash(const int dbid, const sds redis_key, const sds field);
 void on_recover_field_of_hash(const int dbid, const sds redis_key, const sds field);
 void on_empty_db_for_hash(const int dbnum);
+void on_backup_db_for_hash(redisDb *backup_db, const int dbid);
+void release_rock_hash_of_db(redisDb *db);
 
 int is_in_rock_hash(const int dbid, const sds redis_key);
+int is_clean_field_of_rock_hash(const int dbid, const sds redis_key, const sds field);
+size_t get_cold_field_num_of_rock_hash(const int dbid, const sds redis_key);
 
 dict* create_empty_lrus_for_rock_hash();
 
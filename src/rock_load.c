@@ -0,0 +1,381 @@
+/* RedRock is based on Redis, coded by Tony. The copyright is same as Redis.
+ *
+ * Copyright (c) 2018, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* When RDB is loaded (startup, replica full sync or the RDB part of AOF), 
+ * the values which can not stay in memory are written to RocksDB directly (check rock.c).
+ * 
+ * Writing them by rocksdb_write() key by key in main thread is slow for a big RDB, 
+ * because each write goes through the memtable (and the compaction later).
+ * 
+ * Instead, when rock-load-sst is enabled, main thread only collects the keys (and the objects)
+ * in a batch. When the batch is full, a loader thread marshals the objects, 
+ * sorts the rock keys, writes a SST file by the SST file writer of RocksDB,
+ * and ingests the SST file into RocksDB, which bypasses the memtable.
+ * At the same time, main thread goes on loading RDB for the next batch.
+ * 
+ * The last batch is ingested in finish_rock_load() when RDB load finishes,
+ * so all keys are in RocksDB before any client can read them.
+ */
+
+#include "rock_load.h"
+#include "rock.h"
+#include "rock_write.h"
+#include "rock_marshal.h"
+#include "rock_segment.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define LOAD_BATCH_MAX_KEYS  (16<<10)
+
+/* The batch is capped by bytes too, because the loader runs when memory is already over the limit 
+ * and the batch keeps the objects (and the marshalled copies) until the SST file is written.
+ * The cap is a fraction of the max memory for RedRock, check get_load_batch_max_bytes().
+ */
+#define LOAD_BATCH_BYTES_OF_MAX_MEM     64          // 1/64 of get_max_rock_mem_of_os()
+#define LOAD_BATCH_MIN_BYTES            (4<<20)
+#define LOAD_BATCH_MAX_BYTES            (256<<20)
+#define LOAD_OBJ_SIZE_SAMPLES           8           // for objectComputeSize()
+
+typedef struct loadBatch {
+    int cnt;
+    size_t bytes;                       // estimated memory of the keys and values (or objects)
+    sds rock_keys[LOAD_BATCH_MAX_KEYS];
+    robj *objs[LOAD_BATCH_MAX_KEYS];    // for whole key, marshalled in loader thread
+    sds vals[LOAD_BATCH_MAX_KEYS];      // for field, or the marshalled value of objs[i]
+    sds sst_path;
+} loadBatch;
+
+/* The key and value to write to SST file. 
+ * index is the order of the addition, because the later one wins for the same key */
+typedef struct sstEntry {
+    sds key;
+    sds val;
+    size_t index;
+} sstEntry;
+
+/* Only accessed by main thread. 
+ * The loader thread only accesses the batch handed over to it, i.e., loader_batch,
+ * and main thread accesses it after pthread_join(). */
+static rocksdb_options_t *sst_options = NULL;
+static sds sst_path_prefix = NULL;
+static unsigned long long sst_file_seq = 0;
+static loadBatch *current_batch = NULL;
+static loadBatch *loader_batch = NULL;
+static pthread_t loader_thread;
+
+/* Called in main thread after RocksDB is opened in init_rocksdb().
+ * The rocksdb_folder_path is like /opt/redrock/rocksdb6379/ 
+ * and the SST files are like /opt/redrock/rocksdb6379.load-1.sst
+ * NOTE: SST file writer needs the same options (e.g., comparator) of the RocksDB.
+ */
+void init_rock_load(const sds rocksdb_folder_path, rocksdb_options_t *options)
+{
+    serverAssert(sst_path_prefix == NULL);
+
+    size_t len = sdslen(rocksdb_folder_path);
+    serverAssert(len > 1);
+    if (rocksdb_folder_path[len-1] == '/')
+        --len;
+
+    sst_path_prefix = sdsnewlen(rocksdb_folder_path, len);
+    sst_path_prefix = sdscat(sst_path_prefix, ".load-");
+    sst_options = options;
+}
+
+static int cmp_sst_entry(const void *a, const void *b)
+{
+    const sstEntry *ea = a;
+    const sstEntry *eb = b;
+    const size_t la = sdslen(ea->key);
+    const size_t lb = sdslen(eb->key);
+
+    // RocksDB default comparator is bytewise
+    const int cmp = memcmp(ea->key, eb->key, la < lb ? la : lb);
+    if (cmp != 0)
+        return cmp;
+
+    if (la != lb)
+        return la < lb ? -1 : 1;
+
+    return ea->index < eb->index ? -1 : (ea->index > eb->index ? 1 : 0);
+}
+
+/* Called in loader thread to marshal the objects of the batch 
+ * and make the entries for SST file. The segments are split here too.
+ * Return the number of entries. The caller needs to free *entries.
+ */
+static size_t make_sst_entries_in_loader_thread(loadBatch *batch, sstEntry **entries)
+{
+    size_t cap = batch->cnt;
+    size_t cnt = 0;
+    sstEntry *es = zmalloc(sizeof(sstEntry) * cap);
+
+    for (int i = 0; i < batch->cnt; ++i)
+    {
+        if (batch->objs[i] != NULL)
+        {
+            batch->vals[i] = marshal_object(batch->objs[i]);
+            decrRefCount(batch->objs[i]);
+            batch->objs[i] = NULL;
+        }
+
+        sds head;
+        sds *seg_keys;
+        sds *seg_vals;
+        const uint32_t nseg = split_segments_for_load(batch->rock_keys[i], batch->vals[i], 
+                                                      (size_t)server.rock_segment_entries,
+                                                      &head, &seg_keys, &seg_vals);
+        if (cnt + nseg + 1 > cap)
+        {
+            cap = (cnt + nseg + 1) * 2;
+            es = zrealloc(es, sizeof(sstEntry) * cap);
+        }
+
+        for (uint32_t j = 0; j < nseg; ++j)
+        {
+            es[cnt].key = seg_keys[j];
+            es[cnt].val = seg_vals[j];
+            es[cnt].index = cnt;
+            ++cnt;
+        }
+
+        es[cnt].key = batch->rock_keys[i];
+        batch->rock_keys[i] = NULL;
+        if (nseg == 0)
+        {
+            es[cnt].val = batch->vals[i];
+        }
+        else
+        {
+            es[cnt].val = head;
+            sdsfree(batch->vals[i]);
+            zfree(seg_keys);
+            zfree(seg_vals);
+        }
+        batch->vals[i] = NULL;
+        es[cnt].index = cnt;
+        ++cnt;
+    }
+
+    *entries = es;
+    return cnt;
+}
+
+/* The main entrance of loader thread for one batch.
+ * Any error of RocksDB is fatal like write_to_rocksdb_in_main_for_key_when_load(),
+ * and the SST file is removed before the panic.
+ */
+static void* loader_thread_main(void *arg)
+{
+    loadBatch *batch = arg;
+
+    sstEntry *entries;
+    const size_t cnt = make_sst_entries_in_loader_thread(batch, &entries);
+    qsort(entries, cnt, sizeof(sstEntry), cmp_sst_entry);
+
+    char *err = NULL;
+    rocksdb_envoptions_t *env = rocksdb_envoptions_create();
+    rocksdb_sstfilewriter_t *writer = rocksdb_sstfilewriter_create(env, sst_options);
+    rocksdb_sstfilewriter_open(writer, batch->sst_path, &err);
+    if (err)
+    {
+        unlink(batch->sst_path);
+        serverPanic("loader_thread_main() open SST file %s failed reason = %s", batch->sst_path, err);
+    }
+
+    for (size_t i = 0; i < cnt; ++i)
+    {
+        // SST file needs the keys strictly increasing, only the last one of the same key is written
+        if (i + 1 < cnt && sdscmp(entries[i].key, entries[i+1].key) == 0)
+            continue;
+
+        rocksdb_sstfilewriter_put(writer, entries[i].key, sdslen(entries[i].key), 
+                                  entries[i].val, sdslen(entries[i].val), &err);
+        if (err)
+        {
+            unlink(batch->sst_path);
+            serverPanic("loader_thread_main() put to SST file failed reason = %s", err);
+        }
+    }
+
+    rocksdb_sstfilewriter_finish(writer, &err);
+    if (err)
+    {
+        unlink(batch->sst_path);
+        serverPanic("loader_thread_main() finish SST file %s failed reason = %s", batch->sst_path, err);
+    }
+    rocksdb_sstfilewriter_destroy(writer);
+    rocksdb_envoptions_destroy(env);
+
+    rocksdb_ingestexternalfileoptions_t *ingest = rocksdb_ingestexternalfileoptions_create();
+    rocksdb_ingestexternalfileoptions_set_move_files(ingest, 1);
+    const char *files[1] = {batch->sst_path};
+    rocksdb_ingest_external_file(rockdb, files, 1, ingest, &err);
+    rocksdb_ingestexternalfileoptions_destroy(ingest);
+    if (err)
+    {
+        unlink(batch->sst_path);
+        serverPanic("loader_thread_main() ingest SST file %s failed reason = %s", batch->sst_path, err);
+    }
+
+    // NOTE: with move_files, RocksDB removes the original file after a successful ingestion
+
+    for (size_t i = 0; i < cnt; ++i)
+    {
+        sdsfree(entries[i].key);
+        sdsfree(entries[i].val);
+    }
+    zfree(entries);
+
+    return NULL;
+}
+
+/* Called in main thread to wait the loader thread for the previous batch 
+ * and reclaim the batch.
+ */
+static void wait_loader_thread()
+{
+    if (loader_batch == NULL)
+        return;
+
+    serverAssert(pthread_join(loader_thread, NULL) == 0);
+
+    sdsfree(loader_batch->sst_path);
+    zfree(loader_batch);
+    loader_batch = NULL;
+}
+
+/* Called in main thread when current_batch is full or RDB load finishes.
+ * It hands over current_batch to a new loader thread 
+ * after the previous one finished, i.e., at most one loader thread at any time. 
+ */
+static void hand_over_current_batch()
+{
+    if (current_batch == NULL)
+        return;
+
+    wait_loader_thread();
+
+    // The tombstones in the write ring buffer (e.g., duplicated key for DEBUG RELOAD)
+    // are older than the keys in the batch. They must be written to RocksDB before the ingestion,
+    // otherwise, they will delete the newer keys in the SST file.
+    wait_rock_write_ring_buf_drained();
+
+    ++sst_file_seq;
+    current_batch->sst_path = sdscatfmt(sdsdup(sst_path_prefix), "%U.sst", sst_file_seq);
+    loader_batch = current_batch;
+    current_batch = NULL;
+
+    if (pthread_create(&loader_thread, NULL, loader_thread_main, loader_batch) != 0)
+        serverPanic("hand_over_current_batch() can not create loader thread!");
+}
+
+/* Called in main thread. The max bytes of a batch, check LOAD_BATCH_BYTES_OF_MAX_MEM */
+static size_t get_load_batch_max_bytes()
+{
+    const unsigned long long bytes = get_max_rock_mem_of_os() / LOAD_BATCH_BYTES_OF_MAX_MEM;
+    if (bytes < LOAD_BATCH_MIN_BYTES)
+        return LOAD_BATCH_MIN_BYTES;
+    if (bytes > LOAD_BATCH_MAX_BYTES)
+        return LOAD_BATCH_MAX_BYTES;
+    return (size_t)bytes;
+}
+
+/* NOTE: the full batch is handed over in the next call (or finish_rock_load()), not at once,
+ *       because the caller (rdbLoadRio()) releases its reference of the object after the call,
+ *       and the reference count can not be changed by main thread and loader thread at the same time.
+ *       The batch is full when it reaches LOAD_BATCH_MAX_KEYS or get_load_batch_max_bytes().
+ */
+static void add_to_current_batch(const sds rock_key, robj *o, const sds val)
+{
+    if (current_batch != NULL && 
+        (current_batch->cnt == LOAD_BATCH_MAX_KEYS || current_batch->bytes >= get_load_batch_max_bytes()))
+        hand_over_current_batch();
+
+    if (current_batch == NULL)
+    {
+        current_batch = zmalloc(sizeof(loadBatch));
+        current_batch->cnt = 0;
+        current_batch->bytes = 0;
+        current_batch->sst_path = NULL;
+    }
+
+    size_t objectComputeSize(robj *o, size_t sample_size);  // declaration in object.c
+    // the object is marshalled to a copy of about the same size in loader thread, so count it twice
+    const size_t val_bytes = o ? 2 * objectComputeSize(o, LOAD_OBJ_SIZE_SAMPLES) : sdslen(val);
+
+    const int i = current_batch->cnt;
+    current_batch->rock_keys[i] = rock_key;
+    current_batch->objs[i] = o;
+    current_batch->vals[i] = val;
+    current_batch->bytes += sdslen(rock_key) + val_bytes;
+    ++current_batch->cnt;
+}
+
+/* Called in main thread when loading RDB for a whole key which needs to be in RocksDB.
+ * It keeps a reference of redis_val, which is released by the loader thread after marshal. 
+ * So the caller can not modify redis_val after the call.
+ */
+void load_key_to_rocksdb_by_sst(redisDb *db, const sds redis_key, robj *redis_val)
+{
+    sds rock_key = sdsdup(redis_key);
+    rock_key = encode_rock_key_for_db(db->id, rock_key);
+    incrRefCount(redis_val);
+    add_to_current_batch(rock_key, redis_val, NULL);
+}
+
+/* Called in main thread when loading RDB for a field of a hash which needs to be in RocksDB.
+ */
+void load_field_to_rocksdb_by_sst(redisDb *db, const sds redis_key, const sds field, const sds field_val)
+{
+    sds rock_key = sdsdup(redis_key);
+    rock_key = encode_rock_key_for_hash(db->id, rock_key, field);
+    add_to_current_batch(rock_key, NULL, sdsdup(field_val));
+}
+
+/* Called in main thread when loading a row of RocksDB from a RedRock master.
+ * Check rdb_load_rock_row() in rock_rdb_aof.c.
+ * The rock_key and val are already encoded (or marshalled) by the master,
+ * and the caller transfers the ownership of them.
+ */
+void load_row_to_rocksdb_by_sst(const sds rock_key, const sds val)
+{
+    add_to_current_batch(rock_key, NULL, val);
+}
+
+/* Called in main thread when RDB load finishes (successfully or not) in rdbLoadRio().
+ * After the return, all keys of the load are in RocksDB.
+ */
+void finish_rock_load()
+{
+    hand_over_current_batch();
+    wait_loader_thread();
+}
@@ -46,6 +46,7 @@
 #define ROCK_TYPE_HASH_ZIPLIST      6
 #define ROCK_TYPE_ZSET_ZIPLIST      7
 #define ROCK_TYPE_ZSET_SKIPLIST     8
+#define ROCK_TYPE_SEGMENT_HEAD      9       // only in RocksDB, check rock_segment.c
 
 #define ROCK_TYPE_INVALID           127
 
@@ -936,3 +937,193 @@ int debug_check_type(const sds recover_val, const robj *shared_obj)
 
     return 0;
 }
+
+/*                                                          */
+/* The following is for segmented value, check rock_segment.c */
+/*                                                          */
+
+/* The segment head is saved in RocksDB for the rock key of the db (instead of the whole value),
+ * 1 byte for ROCK_TYPE_SEGMENT_HEAD
+ * 1 byte for the rock type of the whole value, i.e., ROCK_TYPE_LIST, ROCK_TYPE_SET_HT or ROCK_TYPE_ZSET_SKIPLIST
+ * 4 bytes (uint32_t) for the number of segments
+ * 8 bytes (uint64_t) for the number of elements 
+ */
+#define SEGMENT_HEAD_SIZE   (1 + 1 + sizeof(uint32_t) + sizeof(uint64_t))
+
+/* The elements of a list, a set (hash table) or a zset (skiplist) 
+ * in the marshal value start from the offset and each element has its own length,
+ * so the marshal value can be split to segments at the boundary of elements.
+ * Return 0 if the marshal value can not be split.
+ */
+static size_t offset_of_elements(const sds v, uint64_t *count)
+{
+    const unsigned char rock_type = v[0];
+    const char *buf = v + MARSHAL_HEAD_SIZE;
+
+    switch(rock_type)
+    {
+    case ROCK_TYPE_LIST:
+        *count = 0;     // unknown, need count by walking
+        return MARSHAL_HEAD_SIZE;
+
+    case ROCK_TYPE_SET_HT:
+        *count = *((size_t*)buf);
+        return MARSHAL_HEAD_SIZE + sizeof(size_t);
+
+    case ROCK_TYPE_ZSET_SKIPLIST:
+        *count = *((uint64_t*)buf);
+        return MARSHAL_HEAD_SIZE + sizeof(uint64_t);
+
+    default:
+        return 0;
+    }
+}
+
+/* The length of the element in the marshal value starting from p */
+static size_t len_of_element(const unsigned char rock_type, const char *p)
+{
+    switch(rock_type)
+    {
+    case ROCK_TYPE_LIST:
+        return sizeof(unsigned int) + *((unsigned int*)p);
+
+    case ROCK_TYPE_SET_HT:
+        return sizeof(size_t) + *((size_t*)p);
+
+    case ROCK_TYPE_ZSET_SKIPLIST:
+        return sizeof(size_t) + *((size_t*)p) + sizeof(double);
+
+    default:
+        serverPanic("len_of_element(), unknown rock_type = %d", (int)rock_type);
+    }
+}
+
+/* Split the marshal value v to segments with seg_entries elements for each (the last could be less).
+ *
+ * Return 0 if v does not need to be split, 
+ * i.e., not a list, a set (hash table) or a zset (skiplist), or the elements are not more than seg_entries.
+ * 
+ * Otherwise, return the number of segments and 
+ * *head is the new allocated segment head for the rock key of db,
+ * *segs and *seg_lens are new allocated arrays (by zmalloc) for the segments,
+ * the segments point to the memory of v, so v must be alive when using them.
+ * The caller needs to free *head, *segs and *seg_lens.
+ */
+uint32_t split_marshal_to_segments(const sds v, const size_t seg_entries, 
+                                   sds *head, const char ***segs, size_t **seg_lens)
+{
+    serverAssert(seg_entries > 0);
+    serverAssert(sdslen(v) >= MARSHAL_HEAD_SIZE);
+
+    uint64_t count;
+    const size_t offset = offset_of_elements(v, &count);
+    if (offset == 0)
+        return 0;
+
+    const unsigned char rock_type = v[0];
+    const char *start = v + offset;
+    const char *end = v + sdslen(v);
+
+    if (rock_type == ROCK_TYPE_LIST)
+    {
+        for (const char *p = start; p < end; p += len_of_element(rock_type, p))
+            ++count;
+    }
+
+    if (count <= seg_entries)
+        return 0;
+
+    const uint64_t seg_num = (count + seg_entries - 1) / seg_entries;
+    serverAssert(seg_num <= UINT32_MAX);
+    const uint32_t nseg = (uint32_t)seg_num;
+
+    *segs = zmalloc(sizeof(char*) * nseg);
+    *seg_lens = zmalloc(sizeof(size_t) * nseg);
+
+    const char *p = start;
+    for (uint32_t i = 0; i < nseg; ++i)
+    {
+        (*segs)[i] = p;
+        for (size_t j = 0; j < seg_entries && p < end; ++j)
+            p += len_of_element(rock_type, p);
+        (*seg_lens)[i] = p - (*segs)[i];
+    }
+    serverAssert(p == end);
+
+    sds h = sdsMakeRoomFor(sdsempty(), SEGMENT_HEAD_SIZE);
+    const unsigned char head_type = ROCK_TYPE_SEGMENT_HEAD;
+    h = sdscatlen(h, &head_type, 1);
+    h = sdscatlen(h, &rock_type, 1);
+    h = sdscatlen(h, &nseg, sizeof(uint32_t));
+    h = sdscatlen(h, &count, sizeof(uint64_t));
+    *head = h;
+
+    return nseg;
+}
+
+/* If the value read from RocksDB (for the rock key of db) is a segment head,
+ * return the number of segments. Otherwise, return 0.
+ */
+uint32_t get_segment_num_of_head(const char *v, const size_t len)
+{
+    if (len != SEGMENT_HEAD_SIZE || (unsigned char)v[0] != ROCK_TYPE_SEGMENT_HEAD)
+        return 0;
+
+    const uint32_t nseg = *((uint32_t*)(v + 2));
+    serverAssert(nseg > 0);
+    return nseg;
+}
+
+/* Assemble the marshal value (the same as before split_marshal_to_segments()) 
+ * from the segment head and all the segments read from RocksDB.
+ * Return the new allocated marshal value, which can be unmarshal_object().
+ */
+sds assemble_marshal_from_segments(const char *head, const size_t head_len, 
+                                   const uint32_t nseg, char **segs, const size_t *seg_lens)
+{
+    serverAssert(get_segment_num_of_head(head, head_len) == nseg);
+
+    const unsigned char rock_type = head[1];
+    const uint64_t count = *((uint64_t*)(head + 2 + sizeof(uint32_t)));
+
+    size_t room = MARSHAL_HEAD_SIZE + sizeof(uint64_t);
+    for (uint32_t i = 0; i < nseg; ++i)
+        room += seg_lens[i];
+
+    sds v = sdsMakeRoomFor(sdsempty(), room);
+    v = sdscatlen(v, &rock_type, 1);
+    switch(rock_type)
+    {
+    case ROCK_TYPE_LIST:
+        break;
+
+    case ROCK_TYPE_SET_HT:
+    {
+        const size_t set_count = count;
+        v = sdscatlen(v, &set_count, sizeof(size_t));
+        break;
+    }
+
+    case ROCK_TYPE_ZSET_SKIPLIST:
+        v = sdscatlen(v, &count, sizeof(uint64_t));
+        break;
+
+    default:
+        serverPanic("assemble_marshal_from_segments(), unknown rock_type = %d", (int)rock_type);
+    }
+
+    for (uint32_t i = 0; i < nseg; ++i)
+        v = sdscatlen(v, segs[i], seg_lens[i]);
+
+    return v;
+}
+
+/* For the tombstone of a rock value, 
+ * return 1 if the rock value could have been split to segments in RocksDB.
+ */
+int is_segmentable_rock_value(const robj *rock_val)
+{
+    return rock_val == shared.rock_val_list_quicklist ||
+           rock_val == shared.rock_val_set_ht ||
+           rock_val == shared.rock_val_zset_skiplist;
+}
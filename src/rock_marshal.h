@@ -39,4 +39,11 @@ int debug_check_type(const sds recover_val, const robj *shared_obj);
 robj* get_match_rock_value(const robj *o);
 robj* create_pure_empty_hash_object(const size_t future_size);
 
+uint32_t split_marshal_to_segments(const sds v, const size_t seg_entries, 
+                                   sds *head, const char ***segs, size_t **seg_lens);
+uint32_t get_segment_num_of_head(const char *v, const size_t len);
+sds assemble_marshal_from_segments(const char *head, const size_t head_len, 
+                                   const uint32_t nseg, char **segs, const size_t *seg_lens);
+int is_segmentable_rock_value(const robj *rock_val);
+
 #endif
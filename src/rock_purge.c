@@ -37,6 +37,8 @@
 #include "rock_purge.h"
 #include "rock.h"
 #include "rock_write.h"
+#include "rock_evict.h"
+#include "rock_hash.h"
 
 #ifdef RED_ROCK_MUTEX_DEBUG
 static pthread_mutexattr_t mattr_purge;
@@ -275,6 +277,23 @@ static void refresh_candidates(sds *last_rock_key)
             db_keys[db_cnt] = sdsnewlen(redis_key, key_sz);
             ++db_cnt;
         }
+        else if (rock_key[0] == ROCK_KEY_FOR_SEGMENT)
+        {
+            // segment is purged with its redis key as a db key, check rock_segment.c
+            // NOTE: the segments of a key are continuous, so skip the same key as the last one
+            int dbid;
+            const char *redis_key;
+            size_t key_sz;
+            uint32_t index;
+            decode_rock_key_for_segment(rock_key, &dbid, &redis_key, &key_sz, &index);
+            if (db_cnt > 0 && db_dbids[db_cnt-1] == dbid && 
+                sdslen(db_keys[db_cnt-1]) == key_sz && memcmp(db_keys[db_cnt-1], redis_key, key_sz) == 0)
+                continue;
+
+            db_dbids[db_cnt] = dbid;
+            db_keys[db_cnt] = sdsnewlen(redis_key, key_sz);
+            ++db_cnt;
+        }
         else
         {
             serverAssert(rock_key[0] == ROCK_KEY_FOR_HASH);
@@ -377,6 +396,7 @@ static void change_snapshot_for_iterator(sds last_refresh_rock_key)
     
     // change to current snapshot
     rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
+    rocksdb_readoptions_set_total_order_seek(readoptions, 1);   // iterate across prefixes, check rock_prefix_transform()
     serverAssert(rocksdb_it = rocksdb_create_iterator(rockdb, readoptions));     
     check_rocksdb_iterator_error("change_snapshot_for_iterator() call rocksdb_create_iterator for change snapshot");
     rocksdb_readoptions_destroy(readoptions);
@@ -424,6 +444,7 @@ static void init_iterator()
     serverAssert(rocksdb_it == NULL);
 
     rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
+    rocksdb_readoptions_set_total_order_seek(readoptions, 1);   // iterate across prefixes, check rock_prefix_transform()
     serverAssert(rocksdb_it = rocksdb_create_iterator(rockdb, readoptions));
     check_rocksdb_iterator_error("do_purge() call rocksdb_create_iterator");
     rocksdb_readoptions_destroy(readoptions);
@@ -621,6 +642,16 @@ void rock_purge_command(client *c)
     addReplyBulkCString(c, "RocksDB purge job started in background!");
 }
 
+/* Called in main thread to start the purge job without the command,
+ * e.g., the stale data in RocksDB after warm restart. Check rock_warm.c.
+ */
+void start_rocksdb_purge_in_background()
+{
+    rock_p_lock();
+    server.rocksdb_purge_working = 1;
+    rock_p_unlock();
+}
+
 /* This is called in main thread cron
  */
 void do_purge_in_cron()
@@ -682,8 +713,9 @@ void do_purge_in_cron()
         else
         {
             robj *o = dictGetVal(de);
-            if (!is_rock_value(o))
+            if (!is_rock_value(o) && !is_clean_key_for_rock_evict(dbid, key))
                 // found in db but not rock value
+                // NOTE: the record of a clean key is not stale, check rock_evict.c
                 need_delete = 1;
         }
 
@@ -740,8 +772,9 @@ void do_purge_in_cron()
                     else
                     {
                         sds field_val = dictGetVal(de_hash);
-                        if (field_val != shared.hash_rock_val_for_field)
-                            need_delete = 1;    // if field value is not rock field
+                        if (field_val != shared.hash_rock_val_for_field &&
+                            !is_clean_field_of_rock_hash(dbid, hash_key, hash_field))
+                            need_delete = 1;    // if field value is not rock field (and not clean)
                     }
                 }
             }
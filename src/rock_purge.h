@@ -43,5 +43,6 @@ void do_purge_in_cron();
 
 void set_can_refressh_new_purge_candidates_to_true();
 void rock_purge_command(client *c);
+void start_rocksdb_purge_in_background();
 
 #endif
@@ -51,6 +51,8 @@
 #include "rock_marshal.h"
 #include "rock_hash.h"
 #include "rock_evict.h"
+#include "rock_segment.h"
+#include "rock_load.h"
 
 #include <unistd.h>
 #include <pthread.h>
@@ -124,8 +126,7 @@ static pthread_mutex_t mutex_main_and_service = PTHREAD_MUTEX_INITIALIZER;
  * (when duplicating from ring buffer, also guarded by spin lock in rock_write.c)
  */
 static const rocksdb_snapshot_t *snapshot = NULL;  
-static sds child_ringbuf_keys[RING_BUFFER_LEN];
-static sds child_ringbuf_vals[RING_BUFFER_LEN];
+static dict *child_ringbuf = NULL;     // rock key -> val, check create_snapshot_of_ring_buf_for_child_process()
 
 /* It is only used in servie thread so no need to use safeguard.
  *
@@ -136,6 +137,46 @@ static sds child_ringbuf_vals[RING_BUFFER_LEN];
  */
 static sds request_content_for_service_thread = NULL;
 
+/* The following variables are only used in the main thread of child process.
+ *
+ * Child process does not request the values in disk one by one, 
+ * which costs one round trip of the pipes for each key (or field).
+ * Instead, it walks ahead of the caller (rdbSaveRio() or rewriteAppendOnlyFileRio(),
+ * which iterate db->dict) with child_prefetch_di, 
+ * collects at most CHILD_BATCH_MAX_KEYS rock keys whose values are in disk,
+ * and sends them to the service thread as one request (a batch).
+ * The service thread answers the batch by rocksdb_multi_get() as one response.
+ * 
+ * There is at most one batch in flight (child_in_flight_keys). When the caller
+ * needs a value which is not in child_prefetched, child process receives the in-flight batch 
+ * and sends the next batch immediately. So the service thread reads the next batch from RocksDB 
+ * while child process serializes the current batch to the rdb or aof file.
+ * 
+ * NOTE: only one request in pipe at any time. So the service thread does not need to 
+ *       deal with more than one request in a read and there is no deadlock for the pipes.
+ */
+#define CHILD_BATCH_MAX_KEYS    512
+static int child_rock_sst = 0;                          // check rdb_save_rock_cold_key()
+static int child_prefetch_dbid = -1;
+static int child_prefetch_done = 0;
+static dictIterator *child_prefetch_di = NULL;          // db->dict of child_prefetch_dbid
+static sds child_prefetch_hash_key = NULL;              // not owned, it is the key in db->dict
+static dictIterator *child_prefetch_field_di = NULL;    // the fields of child_prefetch_hash_key
+static dict *child_prefetched = NULL;                   // rock key -> val, hashDictType
+static sds *child_in_flight_keys = NULL;
+static int child_in_flight_cnt = 0;
+
+/* Read buffer of the pipes for service thread and child process. 
+ * Big enough for a batch of keys or values for less read() calls */
+#define PIPE_READ_BUF_LEN   (16*1024)
+
+/* The first byte of the content of a request from child process */
+#define CHILD_REQUEST_FOR_VALUES    0   // check send_batch_request_in_child_process()
+#define CHILD_REQUEST_FOR_SCAN      1   // check send_scan_request_in_child_process()
+
+/* The max bytes of the rows for one response of CHILD_REQUEST_FOR_SCAN */
+#define SCAN_PAGE_BYTES     (4<<20)
+
 /* The main thread in redis process use the cancel_service_thread to nofify
  * the service thread to exit when the mutex_main_and_service is locked.
  * It is a terminination flag for service thread.
@@ -161,11 +202,7 @@ void init_for_rdb_aof_service()
     pipe_response[0] = -1;
     pipe_response[1] = -1;
 
-    for (int i = 0; i < RING_BUFFER_LEN; ++i)
-    {
-        child_ringbuf_keys[i] = NULL;
-        child_ringbuf_vals[i] = NULL;
-    }       
+    child_ringbuf = NULL;
 
     serverAssert(pthread_mutex_unlock(&mutex_main_and_service) == 0);
 }
@@ -223,131 +260,108 @@ static void set_process_id_in_child_process_for_rock()
     child_process_id = getpid();
 }
 
-/* Called in child process to send a request of a whole key by dbid and key.
+/* Called in child process or service thread to write all data to the pipe fd.
+ * Big batch could be written partially by write(), so we write it repeatly.
+ * 
+ * Return True(1) if sucess, otherwise false(0).
+ */
+static int write_all_to_pipe(const int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        const ssize_t write_res = write(fd, data, len);
+        if (write_res < 0 && errno == EINTR)
+            continue;
+
+        if (write_res <= 0)
+            return 0;
+
+        data += write_res;
+        len -= (size_t)write_res;
+    }
+
+    return 1;
+}
+
+/* Called in child process to send a request of a batch of rock keys.
+ * A rock key could be for a whole key (encode_rock_key_for_db()) 
+ * or for one field of a hash (encode_rock_key_for_hash()).
  * 
  * The encoding of the request is:
  * 1. header: size of the following contnent
  * 2. content: follwing the header
  * 
- * For 2, the content:
- * is encoded of 
- * 2-1) one byte of true indicating it is for whole key
- * 2-2) one byte of dbid 
- * 2-3) the key.
+ * For 2, the content is
+ * 2-1) one byte of CHILD_REQUEST_FOR_VALUES
+ * 2-2) then cnt items of the rock key len and the rock key
  * 
  * Return True(1) if sucess, otherwise false(0).
  *
  * NOTE: For receiver (in service thread), 
  *       it only needs to save the content in the request_content_for_service_thread.
  */
-static int send_request_for_whole_key_in_child_process(const int dbid, const sds key)
+static int send_batch_request_in_child_process(const int cnt, const sds *rock_keys)
 {
     serverAssert(child_process_id != 0);
-    serverAssert(dbid >= 0 && dbid < server.dbnum && key);
+    serverAssert(cnt > 0 && cnt <= CHILD_BATCH_MAX_KEYS);
+
+    size_t content_sz = 1;
+    for (int i = 0; i < cnt; ++i)
+    {
+        content_sz += sizeof(size_t) + sdslen(rock_keys[i]);
+    }
 
     sds content = sdsempty();
-    content = sdsMakeRoomFor(content, 1 + 1 + sdslen(key));
+    content = sdsMakeRoomFor(content, sizeof(size_t) + content_sz);
+
+    // 1
+    content = sdscatlen(content, &content_sz, sizeof(size_t));
 
     // 2-1
-    const char is_whole_key = 1;
-    content = sdscatlen(content, &is_whole_key, 1);
+    const char request_type = CHILD_REQUEST_FOR_VALUES;
+    content = sdscatlen(content, &request_type, 1);
 
     // 2-2
-    const unsigned char c_dbid = (unsigned char)dbid;
-    content = sdscatlen(content, &c_dbid, 1);
-
-    // 2-3
-    content = sdscatlen(content, key, sdslen(key));
-
-    ssize_t write_res;
-    size_t content_sz = sdslen(content);
-    int ret = 0;
-
-    // first send header
-    write_res = write(pipe_request[1], &content_sz, sizeof(size_t));
-    if (write_res != sizeof(size_t))
-        goto reclaim;
-
-    // then the content
-    write_res = write(pipe_request[1], content, sdslen(content));
-    if (write_res < 0 || (size_t)write_res != sdslen(content))
-        goto reclaim;
-
-    ret = 1;    // succesfully
+    for (int i = 0; i < cnt; ++i)
+    {
+        const size_t rock_key_len = sdslen(rock_keys[i]);
+        content = sdscatlen(content, &rock_key_len, sizeof(size_t));
+        content = sdscatlen(content, rock_keys[i], rock_key_len);
+    }
 
-reclaim:
-    if (ret != 1)
-        serverLog(LL_WARNING, "send_request_for_whole_key_in_child_process() write failed!");
+    // header and content are sent together by one write for the pipe
+    const int ret = write_all_to_pipe(pipe_request[1], content, sdslen(content));
+    if (!ret)
+        serverLog(LL_WARNING, "send_batch_request_in_child_process() write failed!");
 
     sdsfree(content);
     return ret;
 }
 
-/* Called in child process to send a request of a field's value by dbid and key and field.
+/* Called in child process to send a request of scanning the snapshot of RocksDB 
+ * from the start key (inclusive). Check scan_snapshot_in_service_thread() for the response.
  *
  * The encoding of the request is:
  * 1. header: size of the following contnent
- * 2. content: follwing the header
- * 
- * For 2, the content:
- * 2-1) is encoded of one byte of false indicating it is for one field only
- * 2-2) one byte of dbid 
- * 2-3) key len
- * 2-4) the key
- * 2-5) field len
- * 2-6) the field.
+ * 2. content: one byte of CHILD_REQUEST_FOR_SCAN, then the start key
  * 
  * Return True(1) if sucess, otherwise false(0).
  */
-static int send_request_for_field_in_child_process(const int dbid, const sds key, const sds field)
+static int send_scan_request_in_child_process(const sds start)
 {
     serverAssert(child_process_id != 0);
-    serverAssert(dbid >= 0 && dbid < server.dbnum && key);
 
+    const size_t content_sz = 1 + sdslen(start);
     sds content = sdsempty();
-    content = sdsMakeRoomFor(content, 1 + 1 + sizeof(size_t) + sdslen(key) + sizeof(size_t) + sdslen(field));
-
-    // 2-1
-    const char is_whole_key = 0;
-    content = sdscatlen(content, &is_whole_key, 1);
-
-    // 2-2
-    const unsigned char c_dbid = (unsigned char)dbid;
-    content = sdscatlen(content, &c_dbid, 1);
-
-    // 2-3
-    const size_t key_len = sdslen(key);
-    content = sdscatlen(content, &key_len, sizeof(size_t));
-
-    // 2-4
-    content = sdscatlen(content, key, key_len);
-
-    // 2-5
-    const size_t field_len = sdslen(field);
-    content = sdscatlen(content, &field_len, sizeof(size_t));
-
-    // 2-6
-    content = sdscatlen(content, field, field_len);
-
-    ssize_t write_res;
-    size_t content_sz = sdslen(content);
-    int ret = 0;
-
-    // first send header
-    write_res = write(pipe_request[1], &content_sz, sizeof(size_t));
-    if (write_res != sizeof(size_t))
-        goto reclaim;
-
-    // then the content
-    write_res = write(pipe_request[1], content, sdslen(content));
-    if (write_res < 0 || (size_t)write_res != sdslen(content))
-        goto reclaim;
-
-    ret = 1;    // succesfully
+    content = sdsMakeRoomFor(content, sizeof(size_t) + content_sz);
+    content = sdscatlen(content, &content_sz, sizeof(size_t));
+    const char request_type = CHILD_REQUEST_FOR_SCAN;
+    content = sdscatlen(content, &request_type, 1);
+    content = sdscatlen(content, start, sdslen(start));
 
-reclaim:
-    if (ret != 1)
-        serverLog(LL_WARNING, "send_request_for_field_in_child_process() write failed!");
+    const int ret = write_all_to_pipe(pipe_request[1], content, sdslen(content));
+    if (!ret)
+        serverLog(LL_WARNING, "send_scan_request_in_child_process() write failed!");
 
     sdsfree(content);
     return ret;
@@ -369,7 +383,6 @@ static sds receive_response_in_child_process()
     serverAssert(child_process_id != 0);
 
     // first read the length of size of size_t
-    #define PIPE_READ_BUF_LEN 64
     char buf[PIPE_READ_BUF_LEN];
     
     char len_buf[sizeof(size_t)];
@@ -548,18 +561,10 @@ static int create_pipe()
  */
 static void clear_snapshot_of_ring_buffer()
 {
-    for (int i = 0; i <RING_BUFFER_LEN; ++i)
+    if (child_ringbuf != NULL)
     {
-        if (child_ringbuf_keys[i] != NULL)
-        {
-            serverAssert(child_ringbuf_vals[i] != NULL);
-
-            sdsfree(child_ringbuf_keys[i]);
-            sdsfree(child_ringbuf_keys[i]);
-
-            child_ringbuf_keys[i] = NULL;
-            child_ringbuf_vals[i] = NULL;
-        }
+        dictRelease(child_ringbuf);
+        child_ringbuf = NULL;
     }
 }
 
@@ -589,7 +594,7 @@ static int start_service_thread()
 static void terminate_service_thread(const char *reason)
 {
     serverAssert(snapshot == NULL);
-    serverAssert(child_ringbuf_keys[0] == NULL);
+    serverAssert(child_ringbuf == NULL);
 
     atomicSet(cancel_service_thread, 1);        // signal service thread to abort
 
@@ -764,8 +769,8 @@ void signal_child_process_already_running(const int child_pid)
     // NOTE: we need call ring buffer first, because write thread will 
     //       change ring buffer, we must guarantee no data loss for snapshot
     serverAssert(snapshot == NULL);
-    serverAssert(child_ringbuf_keys[0] == NULL);
-    create_snapshot_of_ring_buf_for_child_process(child_ringbuf_keys, child_ringbuf_vals);
+    serverAssert(child_ringbuf == NULL);
+    child_ringbuf = create_snapshot_of_ring_buf_for_child_process();
     snapshot = rocksdb_create_snapshot(rockdb);
     serverAssert(snapshot != NULL);
 
@@ -804,6 +809,9 @@ static robj* direct_read_one_key_val_from_rocksdb(const int dbid, const sds key)
         serverPanic("direct_read_one_key_val_from_rocksdb() not found for key = %s", key);
     
     sds v = sdsnewlen(db_val, db_val_len);
+    v = assemble_if_segment_head(rock_key, v, NULL);
+    if (v == NULL)
+        serverPanic("direct_read_one_key_val_from_rocksdb() segment not found for key = %s", key);
     robj *o = unmarshal_object(v);
 
     // reclaim resource
@@ -870,82 +878,78 @@ static robj* read_from_disk_for_key_in_redis_process(const int dbid, const sds k
  */
 static sds read_from_snapshot_of_ring_buffer(const sds rock_key)
 {
-    const size_t rock_len = sdslen(rock_key);
-    sds found = NULL;
-    for (int i = 0; i < RING_BUFFER_LEN; ++i)
-    {
-        if (child_ringbuf_keys[i] == NULL)
-            break;
-
-        if (sdslen(child_ringbuf_keys[i]) == rock_len && sdscmp(child_ringbuf_keys[i], rock_key) == 0)
-        {
-            found = child_ringbuf_vals[i];
-            break;
-        }
-    }
+    dictEntry *de = dictFind(child_ringbuf, rock_key);
+    sds found = de ? dictGetVal(de) : NULL;
     return found == NULL ? NULL : sdsdup(found);       // NOTE: return duplication because caller will free it
 }
 
-/* This is called in service thread to find the value in snapshot 
- * of RocksDB for rock_key.
- * If found, return the value.
- * Otherwise, return NULL.
+/* This is called in service thread to read a batch of rock keys from snapshots.
+ * First from the snapshot of ring buffer, 
+ * then the left from the snapshot of RocksDB in one rocksdb_multi_get().
+ * 
+ * NOTE: vals[i] is NULL if not found and the caller needs to free vals[i].
  */
-static sds read_from_snapshot_of_rocksdb(const sds rock_key)
-{
-    size_t db_val_len;
-    char *err = NULL;
-    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
-    serverAssert(snapshot != NULL);
-    rocksdb_readoptions_set_snapshot(readoptions, snapshot);
-    char *db_val = rocksdb_get(rockdb, readoptions, rock_key, sdslen(rock_key), &db_val_len, &err);
-    rocksdb_readoptions_destroy(readoptions);
-
-    if (err)
-        serverPanic("read_from_snapshot_of_rocksdb(), err = %s", err);
-
-    if (db_val == NULL)
-        // NOT FOUND, but it is illegal, but we make the caller deal with that
-        return NULL;
-    
-    const sds read = sdsnewlen(db_val, db_val_len);
-    rocksdb_free(db_val);
-    return read;
-}
-
-static sds read_from_snapshot_first_ringbuf_then_rocksdb(const sds rock_key)
+static void read_batch_from_snapshot_in_service_thread(const int cnt, const sds *rock_keys, sds *vals)
 {
-    const sds val = read_from_snapshot_of_ring_buffer(rock_key);
-    if (val != NULL)
-        return val;
-    
-    return read_from_snapshot_of_rocksdb(rock_key);
-}
+    int left_cnt = 0;
+    int *left_indexs = zmalloc(sizeof(int) * cnt);
+    const char **left_keys = zmalloc(sizeof(char*) * cnt);
+    size_t *left_key_sizes = zmalloc(sizeof(size_t) * cnt);
 
-/* This is for client/server mode in service thead in redis process for one whole key's value */
-static sds read_from_snapshot_for_whole_key_in_service_thread(const int dbid, const char *key, const size_t key_len)
-{
-    sds rock_key = sdsnewlen(key, key_len);
-    rock_key = encode_rock_key_for_db(dbid, rock_key);
-
-    const sds val = read_from_snapshot_first_ringbuf_then_rocksdb(rock_key);
-
-    sdsfree(rock_key);
+    for (int i = 0; i < cnt; ++i)
+    {
+        vals[i] = read_from_snapshot_of_ring_buffer(rock_keys[i]);
+        if (vals[i] == NULL)
+        {
+            left_indexs[left_cnt] = i;
+            left_keys[left_cnt] = rock_keys[i];
+            left_key_sizes[left_cnt] = sdslen(rock_keys[i]);
+            ++left_cnt;
+        }
+    }
 
-    return val;
-}
+    if (left_cnt != 0)
+    {
+        char **db_vals = zmalloc(sizeof(char*) * left_cnt);
+        size_t *db_val_sizes = zmalloc(sizeof(size_t) * left_cnt);
+        char **errs = zmalloc(sizeof(char*) * left_cnt);
+        for (int i = 0; i < left_cnt; ++i)
+        {
+            errs[i] = NULL;
+        }
 
-/* This is for client/server mode in service thead in redis process for one field's value */
-static sds read_from_snapshot_for_hash_field_in_service_thread(const int dbid, const sds key, const sds field)
-{
-    sds rock_key = sdsdup(key);
-    rock_key = encode_rock_key_for_hash(dbid, rock_key, field);
+        rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
+        serverAssert(snapshot != NULL);
+        rocksdb_readoptions_set_snapshot(readoptions, snapshot);
+        rocksdb_multi_get(rockdb, readoptions, left_cnt, 
+                          left_keys, left_key_sizes, 
+                          db_vals, db_val_sizes, errs);
+        rocksdb_readoptions_destroy(readoptions);
 
-    const sds val = read_from_snapshot_first_ringbuf_then_rocksdb(rock_key);
+        for (int i = 0; i < left_cnt; ++i)
+        {
+            if (errs[i])
+                serverPanic("read_batch_from_snapshot_in_service_thread(), err = %s", errs[i]);
+
+            if (db_vals[i] == NULL)
+                // NOT FOUND, but it is illegal, but we make the caller deal with that
+                continue;
+
+            const int index = left_indexs[i];
+            sds read = sdsnewlen(db_vals[i], db_val_sizes[i]);
+            rocksdb_free(db_vals[i]);
+            // big list, set or zset could be saved in segments, check rock_segment.c
+            vals[index] = assemble_if_segment_head(rock_keys[index], read, snapshot);
+        }
 
-    sdsfree(rock_key);
+        zfree(db_vals);
+        zfree(db_val_sizes);
+        zfree(errs);
+    }
 
-    return val;
+    zfree(left_indexs);
+    zfree(left_keys);
+    zfree(left_key_sizes);
 }
 
 /* This is for read in sync mode in main thread in redis process 
@@ -1023,84 +1027,560 @@ static robj* read_from_disk_in_redis_process(const int have_field_in_disk, const
     }
 }
 
-/* Called in service thread when a request is totally received
- * and we need get the real data from snapshots and return it.
+/* Called in service thread for a request of CHILD_REQUEST_FOR_VALUES.
  * 
- * We need parse the reqeust to know 
- * 1. it is for the whole key
- * 2. or it is for one field
+ * The request is a batch of rock keys, check send_batch_request_in_child_process().
+ * Each rock key could be for a whole key or for one field.
  * 
- * and then, we will get the data from snapshot
- * For whole key, it is the serialized robj as sds
+ * For whole key, the value is the serialized robj as sds
  * For field, it is the value of the field as sds.
  * 
+ * The response is the values in the same order of the rock keys in the request. 
+ * Each value is encoded as [size_t len][the value].
+ * 
+ * If failed, return NULL.
+ */
+static sds get_values_in_service_thread_for_child_process(char *p, size_t p_len)
+{
+    sds rock_keys[CHILD_BATCH_MAX_KEYS];
+    sds vals[CHILD_BATCH_MAX_KEYS];
+    int cnt = 0;
+    sds response = NULL;
+
+    while (p_len != 0)
+    {
+        if (cnt == CHILD_BATCH_MAX_KEYS || p_len < sizeof(size_t))
+            goto err;
+
+        const size_t rock_key_len = *((size_t*)p);
+        p += sizeof(size_t);
+        p_len -= sizeof(size_t);
+
+        // at least two bytes, one is type of the rock key, one byte is for dbid
+        if (rock_key_len < 1 + 1 || p_len < rock_key_len)
+            goto err;
+
+        rock_keys[cnt] = sdsnewlen(p, rock_key_len);
+        ++cnt;
+        p += rock_key_len;
+        p_len -= rock_key_len;
+    }
+
+    if (cnt == 0)
+        goto err;
+
+    read_batch_from_snapshot_in_service_thread(cnt, rock_keys, vals);
+
+    size_t response_len = 0;
+    for (int i = 0; i < cnt; ++i)
+    {
+        if (vals[i] != NULL)
+            response_len += sizeof(size_t) + sdslen(vals[i]);
+    }
+
+    response = sdsempty();
+    response = sdsMakeRoomFor(response, response_len);
+    for (int i = 0; i < cnt; ++i)
+    {
+        if (vals[i] == NULL)
+        {
+            serverLog(LL_WARNING, "get_values_in_service_thread_for_child_process() not found in snapshot!");
+            sdsfree(response);
+            response = NULL;
+            break;
+        }
+
+        const size_t val_len = sdslen(vals[i]);
+        response = sdscatlen(response, &val_len, sizeof(size_t));
+        response = sdscatlen(response, vals[i], val_len);
+    }
+
+    for (int i = 0; i < cnt; ++i)
+    {
+        sdsfree(vals[i]);
+        sdsfree(rock_keys[i]);
+    }
+    return response;
+
+err:
+    serverLog(LL_WARNING, "get_values_in_service_thread_for_child_process() parse rock keys failed!");
+    for (int i = 0; i < cnt; ++i)
+    {
+        sdsfree(rock_keys[i]);
+    }
+    return NULL;
+}
+
+/* Called in service thread for the scan of the snapshot of RocksDB.
+ * If the rock key of db (with the segment rock_key of a big list, set or zset, check rock_segment.c) 
+ * is in the snapshot of ring buffer, return the sds of the end of the segments of it 
+ * (the caller needs to reclaim it). Otherwise, return NULL.
+ */
+static sds get_superseded_segments_end(const sds rock_key)
+{
+    int dbid;
+    const char *redis_key;
+    size_t key_sz;
+    uint32_t index;
+    decode_rock_key_for_segment(rock_key, &dbid, &redis_key, &key_sz, &index);
+
+    sds db_key = encode_rock_key_for_db(dbid, sdsnewlen(redis_key, key_sz));
+    const int superseded = dictFind(child_ringbuf, db_key) != NULL;
+    sdsfree(db_key);
+    if (!superseded)
+        return NULL;
+
+    sds prefix = encode_rock_key_prefix_for_segment(dbid, redis_key, key_sz);
+    return encode_rock_key_for_segment(prefix, UINT32_MAX);
+}
+
+/* Called in service thread for a request of CHILD_REQUEST_FOR_SCAN.
+ *
+ * It iterates the snapshot of RocksDB from the start key 
+ * and returns the rows (rock key and value) for about SCAN_PAGE_BYTES.
+ * The rows of hash fields are skipped because the values of the hash are sent 
+ * with the hash key in RDB (check rdb_save_rock_rows()).
+ * The rows which are in the snapshot of ring buffer are skipped too, 
+ * because the newer values in ring buffer are sent with the last page.
+ * So are all the segments of them, check get_superseded_segments_end().
+ * 
+ * The response is encoded as:
+ * 1. one byte, true if it is the last page
+ * 2. the start key for next page, [size_t len][the key]
+ * 3. the rows, each row is [size_t len][rock key][size_t len][value]
+ */
+static sds scan_snapshot_in_service_thread(const char *start, const size_t start_len)
+{
+    sds rows = sdsempty();
+    sds next = NULL;
+
+    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
+    serverAssert(snapshot != NULL);
+    rocksdb_readoptions_set_snapshot(readoptions, snapshot);
+    rocksdb_readoptions_set_fill_cache(readoptions, 0);     // do not pollute the block cache for main thread
+    rocksdb_readoptions_set_readahead_size(readoptions, 2<<20);     // sequential read
+    rocksdb_readoptions_set_total_order_seek(readoptions, 1);       // iterate across prefixes, check rock_prefix_transform()
+    rocksdb_iterator_t *iter = rocksdb_create_iterator(rockdb, readoptions);
+
+    rocksdb_iter_seek(iter, start, start_len);
+    while (rocksdb_iter_valid(iter))
+    {
+        size_t key_len, val_len;
+        const char *key = rocksdb_iter_key(iter, &key_len);
+        if (sdslen(rows) >= SCAN_PAGE_BYTES)
+        {
+            next = sdsnewlen(key, key_len);
+            break;
+        }
+
+        if (key[0] == ROCK_KEY_FOR_HASH)
+        {
+            // skip all hash fields, ROCK_KEY_FOR_SEGMENT is next to ROCK_KEY_FOR_HASH
+            const char seg_start = ROCK_KEY_FOR_SEGMENT;
+            rocksdb_iter_seek(iter, &seg_start, 1);
+            continue;
+        }
+
+        sds rock_key = sdsnewlen(key, key_len);
+        if (key[0] == ROCK_KEY_FOR_SEGMENT)
+        {
+            sds end = get_superseded_segments_end(rock_key);
+            if (end)
+            {
+                // skip the segments of the key to the end (the max index could be a segment too)
+                rocksdb_iter_seek(iter, end, sdslen(end));
+                if (rocksdb_iter_valid(iter))
+                {
+                    const char *cur = rocksdb_iter_key(iter, &key_len);
+                    if (key_len == sdslen(end) && memcmp(cur, end, key_len) == 0)
+                        rocksdb_iter_next(iter);
+                }
+                sdsfree(end);
+                sdsfree(rock_key);
+                continue;
+            }
+        }
+
+        if (dictFind(child_ringbuf, rock_key) == NULL)
+        {
+            const char *val = rocksdb_iter_value(iter, &val_len);
+            rows = sdscatlen(rows, &key_len, sizeof(size_t));
+            rows = sdscatlen(rows, key, key_len);
+            rows = sdscatlen(rows, &val_len, sizeof(size_t));
+            rows = sdscatlen(rows, val, val_len);
+        }
+        sdsfree(rock_key);
+
+        rocksdb_iter_next(iter);
+    }
+
+    char *err = NULL;
+    rocksdb_iter_get_error(iter, &err);
+    if (err)
+        serverPanic("scan_snapshot_in_service_thread() iterator err = %s", err);
+    rocksdb_iter_destroy(iter);
+    rocksdb_readoptions_destroy(readoptions);
+
+    if (next == NULL)
+    {
+        // the last page, with the values of the snapshot of ring buffer
+        dictIterator *di = dictGetIterator(child_ringbuf);
+        dictEntry *de;
+        while ((de = dictNext(di)))
+        {
+            const sds rock_key = dictGetKey(de);
+            const sds val = dictGetVal(de);
+            if (rock_key[0] == ROCK_KEY_FOR_HASH)
+                continue;
+
+            const size_t key_len = sdslen(rock_key);
+            const size_t val_len = sdslen(val);
+            rows = sdscatlen(rows, &key_len, sizeof(size_t));
+            rows = sdscatlen(rows, rock_key, key_len);
+            rows = sdscatlen(rows, &val_len, sizeof(size_t));
+            rows = sdscatlen(rows, val, val_len);
+        }
+        dictReleaseIterator(di);
+    }
+
+    const char is_last = next == NULL;
+    const size_t next_len = next == NULL ? 0 : sdslen(next);
+    sds response = sdsempty();
+    response = sdsMakeRoomFor(response, 1 + sizeof(size_t) + next_len + sdslen(rows));
+    response = sdscatlen(response, &is_last, 1);
+    response = sdscatlen(response, &next_len, sizeof(size_t));
+    if (next)
+        response = sdscatlen(response, next, next_len);
+    response = sdscatlen(response, rows, sdslen(rows));
+
+    sdsfree(next);
+    sdsfree(rows);
+    return response;
+}
+
+/* Called in service thread when a request is totally received
+ * and we need get the real data from snapshot and return it.
+ * 
+ * The first byte of the request is the type of the request.
+ * 
  * If failed, return NULL.
  */
 static sds get_data_in_service_thread_for_child_process(const sds request)
 {
-    if (sdslen(request) < 1 + 1)
+    if (sdslen(request) < 1)
     {
-        // at least two bytes, one is flag of whole key or field, one byte is for dbid
         serverLog(LL_WARNING, "get_data_in_service_thread_for_child_process() len too small");
         return NULL;
     }
 
-    const int is_for_whole_key = request[0];
-    serverAssert(is_for_whole_key == 1 || is_for_whole_key == 0);
-    const int dbid = ((unsigned char*)request)[1];
-    serverAssert(dbid >= 0 && dbid < server.dbnum);
+    const int request_type = request[0];
+    if (request_type == CHILD_REQUEST_FOR_VALUES)
+    {
+        return get_values_in_service_thread_for_child_process(request + 1, sdslen(request) - 1);
+    }
+    else if (request_type == CHILD_REQUEST_FOR_SCAN)
+    {
+        return scan_snapshot_in_service_thread(request + 1, sdslen(request) - 1);
+    }
+    else
+    {
+        serverLog(LL_WARNING, "get_data_in_service_thread_for_child_process() unknown request type = %d", request_type);
+        return NULL;
+    }
+}
 
-    char *p = request + 2;
-    size_t p_len = sdslen(request) - 2;
+/* Check whether the value of the key needs to get from RocksDB.
+ * It is for the current memory (for redis process or child process).
+ *
+ * Return 
+ * VAL_ALL_IN_MEMORY if the value is concrete,
+ * VAL_WHOLE_KEY_IN_DISK if the key is a rock value,
+ * VAL_SOME_FIELDS_IN_DISK if the key is a hash with some fields in rocksdb.
+ */
+#define VAL_ALL_IN_MEMORY       0
+#define VAL_WHOLE_KEY_IN_DISK   1
+#define VAL_SOME_FIELDS_IN_DISK 2
+static int check_val_in_disk(redisDb *db, const robj *o, const sds key)
+{
+    if (is_rock_value(o))
+        return VAL_WHOLE_KEY_IN_DISK;
 
-    if (is_for_whole_key)
+    dictEntry *de = dictFind(db->rock_hash, key);
+    if (de == NULL)
+        // not rock value and not exist in rock hash, it is a concrete value
+        return VAL_ALL_IN_MEMORY;
+
+    serverAssert(o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT);
+    dict *lrus = dictGetVal(de);
+    dict *hash = o->ptr;
+
+    // all fields not in disk for a hash (even the key is in rock_hash), 
+    // it is a concrete value
+    return dictSize(hash) == dictSize(lrus) ? VAL_ALL_IN_MEMORY : VAL_SOME_FIELDS_IN_DISK;
+}
+
+/* Called in child process to walk ahead of the caller for the keys (or fields) 
+ * whose values are in disk in the db of child_prefetch_dbid.
+ * 
+ * It collects at most CHILD_BATCH_MAX_KEYS rock keys to rock_keys 
+ * and returns the number of the collected rock keys. 
+ * Return zero if the walk of the db is over.
+ */
+static int collect_batch_ahead_in_child_process(sds *rock_keys)
+{
+    serverAssert(child_process_id != 0);
+
+    redisDb *db = server.db + child_prefetch_dbid;
+    int cnt = 0;
+
+    while (cnt < CHILD_BATCH_MAX_KEYS)
     {
-        // whole key does not need to parse
-        return read_from_snapshot_for_whole_key_in_service_thread(dbid, p, p_len);
+        if (child_prefetch_field_di != NULL)
+        {
+            // in the middle of a hash which has some fields in disk
+            dictEntry *de_field = dictNext(child_prefetch_field_di);
+            if (de_field == NULL)
+            {
+                dictReleaseIterator(child_prefetch_field_di);
+                child_prefetch_field_di = NULL;
+                child_prefetch_hash_key = NULL;
+            }
+            else if (dictGetVal(de_field) == shared.hash_rock_val_for_field)
+            {
+                sds rock_key = sdsdup(child_prefetch_hash_key);
+                rock_keys[cnt] = encode_rock_key_for_hash(child_prefetch_dbid, rock_key, dictGetKey(de_field));
+                ++cnt;
+            }
+            continue;
+        }
+
+        if (child_prefetch_done)
+            break;
+
+        dictEntry *de = dictNext(child_prefetch_di);
+        if (de == NULL)
+        {
+            child_prefetch_done = 1;
+            break;
+        }
+
+        const sds key = dictGetKey(de);
+        const robj *o = dictGetVal(de);
+        const int in_disk = check_val_in_disk(db, o, key);
+        if (in_disk == VAL_WHOLE_KEY_IN_DISK && !child_rock_sst)
+        {
+            sds rock_key = sdsdup(key);
+            rock_keys[cnt] = encode_rock_key_for_db(child_prefetch_dbid, rock_key);
+            ++cnt;
+        }
+        else if (in_disk == VAL_SOME_FIELDS_IN_DISK)
+        {
+            child_prefetch_hash_key = key;
+            child_prefetch_field_di = dictGetSafeIterator((dict*)o->ptr);
+        }
     }
-    else
+
+    return cnt;
+}
+
+/* Called in child process to send the next batch if no batch in flight.
+ * If the walk of the db is over, nothing is sent.
+ *
+ * Return True(1) if sucess, otherwise false(0).
+ */
+static int send_next_batch_in_child_process()
+{
+    serverAssert(child_in_flight_cnt == 0);
+
+    const int cnt = collect_batch_ahead_in_child_process(child_in_flight_keys);
+    if (cnt == 0)
+        return 1;
+
+    if (!send_batch_request_in_child_process(cnt, child_in_flight_keys))
     {
-        // parse for key and field
-        sds key = NULL;
-        sds field = NULL;
+        for (int i = 0; i < cnt; ++i)
+        {
+            sdsfree(child_in_flight_keys[i]);
+        }
+        return 0;
+    }
 
-        if (p_len < sizeof(size_t))
-            goto err_of_field;
+    child_in_flight_cnt = cnt;
+    return 1;
+}
 
-        const size_t key_len = *((size_t*)p);
-        p += sizeof(size_t);
-        p_len -= sizeof(size_t);
+/* Called in child process to receive the response of the in-flight batch 
+ * and save the values to child_prefetched.
+ * Check get_data_in_service_thread_for_child_process() for the encoding of the response.
+ * 
+ * Return True(1) if sucess, otherwise false(0).
+ */
+static int receive_batch_in_child_process()
+{
+    serverAssert(child_in_flight_cnt > 0);
 
-        if (p_len < key_len)
-            goto err_of_field;
-        
-        key = sdsnewlen(p, key_len);
-        p += key_len;
-        p_len -= key_len;
+    int ret = 0;
+    const sds response = receive_response_in_child_process();
+    if (response == NULL)
+        goto reclaim;
 
+    char *p = response;
+    size_t p_len = sdslen(response);
+    for (int i = 0; i < child_in_flight_cnt; ++i)
+    {
         if (p_len < sizeof(size_t))
-            goto err_of_field;
+            goto reclaim;
 
-        const size_t field_len = *((size_t*)p);
+        const size_t val_len = *((size_t*)p);
         p += sizeof(size_t);
         p_len -= sizeof(size_t);
 
-        if (p_len != field_len)
-            goto err_of_field;
+        if (p_len < val_len)
+            goto reclaim;
 
-        field = sdsnewlen(p, field_len);
-        
-        const sds data = read_from_snapshot_for_hash_field_in_service_thread(dbid, key, field);
-        sdsfree(key);
-        sdsfree(field);
-        return data;
+        const sds rock_key = child_in_flight_keys[i];
+        child_in_flight_keys[i] = NULL;
+        if (dictFind(child_prefetched, rock_key) == NULL)
+        {
+            dictAdd(child_prefetched, rock_key, sdsnewlen(p, val_len));
+        }
+        else
+        {
+            // the same rock key could be requested alone before, 
+            // check get_val_by_rock_key_in_child_process()
+            sdsfree(rock_key);
+        }
+        p += val_len;
+        p_len -= val_len;
+    }
 
-err_of_field:
-        serverLog(LL_WARNING, "get_data_in_service_thread_for_child_process() parse key and field failed!");
-        sdsfree(key);
-        sdsfree(field);
-        return NULL;        
+    if (p_len != 0)
+        goto reclaim;
+
+    ret = 1;
+
+reclaim:
+    if (!ret)
+        serverLog(LL_WARNING, "receive_batch_in_child_process() failed!");
+
+    for (int i = 0; i < child_in_flight_cnt; ++i)
+    {
+        sdsfree(child_in_flight_keys[i]);
+        child_in_flight_keys[i] = NULL;
     }
+    child_in_flight_cnt = 0;
+
+    sdsfree(response);
+    return ret;
+}
+
+/* Called in child process when the caller goes to another db.
+ * The left of the previous db in flight or in child_prefetched are dropped.
+ *
+ * Return True(1) if sucess, otherwise false(0).
+ */
+static int start_prefetch_for_db_in_child_process(const int dbid)
+{
+    serverAssert(dbid >= 0 && dbid < server.dbnum);
+
+    if (child_in_flight_cnt != 0 && !receive_batch_in_child_process())
+        return 0;
+
+    if (child_prefetch_field_di != NULL)
+    {
+        dictReleaseIterator(child_prefetch_field_di);
+        child_prefetch_field_di = NULL;
+        child_prefetch_hash_key = NULL;
+    }
+
+    if (child_prefetch_di != NULL)
+        dictReleaseIterator(child_prefetch_di);
+
+    if (child_prefetched == NULL)
+    {
+        child_prefetched = dictCreate(&hashDictType, NULL);
+        child_in_flight_keys = zmalloc(sizeof(sds) * CHILD_BATCH_MAX_KEYS);
+    }
+    else
+    {
+        dictEmpty(child_prefetched, NULL);
+    }
+
+    child_prefetch_dbid = dbid;
+    child_prefetch_done = 0;
+    child_prefetch_di = dictGetSafeIterator(server.db[dbid].dict);
+    return 1;
+}
+
+/* Called in child process to take the value of the rock key from child_prefetched.
+ * Return NULL if not found, otherwise the caller needs to free the returned value.
+ */
+static sds take_prefetched_in_child_process(const sds rock_key)
+{
+    dictEntry *de = dictUnlink(child_prefetched, rock_key);
+    if (de == NULL)
+        return NULL;
+
+    const sds val = dictGetVal(de);
+    dictSetVal(child_prefetched, de, NULL);
+    dictFreeUnlinkedEntry(child_prefetched, de);
+    return val;
+}
+
+/* Called in child process to get the value of the rock key 
+ * which is for a whole key or for one field of a hash.
+ *
+ * Return NULL if error, otherwise the caller needs to free the returned value.
+ */
+static sds get_val_by_rock_key_in_child_process(const int dbid, const sds rock_key)
+{
+    serverAssert(child_process_id != 0);
+
+    if (dbid != child_prefetch_dbid && !start_prefetch_for_db_in_child_process(dbid))
+        return NULL;
+
+    sds val = take_prefetched_in_child_process(rock_key);
+    if (val != NULL)
+        return val;
+
+    // the first time for the db, no batch in flight
+    if (child_in_flight_cnt == 0 && !send_next_batch_in_child_process())
+        return NULL;
+
+    if (child_in_flight_cnt != 0)
+    {
+        if (!receive_batch_in_child_process())
+            return NULL;
+
+        // pipeline: service thread reads the next batch 
+        // when child process serializes the values of the current batch
+        if (!send_next_batch_in_child_process())
+            return NULL;
+    }
+
+    val = take_prefetched_in_child_process(rock_key);
+    if (val != NULL)
+        return val;
+
+    // The walk ahead does not meet the rock key in the same order of the caller,
+    // which should not happen for rdb or aof. We request the rock key alone.
+    // NOTE: the in-flight batch must be received first, only one request in pipe.
+    if (child_in_flight_cnt != 0 && !receive_batch_in_child_process())
+        return NULL;
+
+    child_in_flight_keys[0] = sdsdup(rock_key);
+    if (!send_batch_request_in_child_process(1, child_in_flight_keys))
+    {
+        sdsfree(child_in_flight_keys[0]);
+        child_in_flight_keys[0] = NULL;
+        return NULL;
+    }
+    child_in_flight_cnt = 1;
+
+    if (!receive_batch_in_child_process())
+        return NULL;
+
+    return take_prefetched_in_child_process(rock_key);
 }
 
 /* This is called in child process.
@@ -1110,7 +1590,8 @@ err_of_field:
  * 
  * It weill call here to get the value (return robj*)
  * 
- * We must use client/service mode by using a pipe to get the value.
+ * We must use client/service mode by using a pipe to get the value,
+ * and the values are requested in batches ahead, check get_val_by_rock_key_in_child_process().
  * 
  * If failed, return NULL which is impossible but the child process (caller) needs to exit.
  */
@@ -1121,23 +1602,22 @@ static robj* read_val_of_disk_in_child_process(const int have_field_in_disk, con
     if (!have_field_in_disk)
     {
         // for whole key
-        if (!send_request_for_whole_key_in_child_process(dbid, key))
+        sds rock_key = sdsdup(key);
+        rock_key = encode_rock_key_for_db(dbid, rock_key);
+        sds val = get_val_by_rock_key_in_child_process(dbid, rock_key);
+        sdsfree(rock_key);
+        if (val == NULL)
             return NULL;
 
-        sds response = receive_response_in_child_process();
-        if (response == NULL)
-            return NULL;
-
-        robj *o = unmarshal_object(response);
-        sdsfree(response);
+        robj *o = unmarshal_object(val);
+        sdsfree(val);
         return o;
     }
     else
     {
         // We need find create a new hash from the source of the memory hash (in child process)
         // For field's value in memory (in child proces) just copy them.
-        // For field's value in disk, use client/server mode to send to service thread
-        // one by one
+        // For field's value in disk, use client/server mode to get from service thread
         redisDb *db = server.db + dbid;
         dictEntry *de_db = dictFind(db->dict, key);
         serverAssert(de_db);
@@ -1168,13 +1648,10 @@ static robj* read_val_of_disk_in_child_process(const int have_field_in_disk, con
                 // we need client/server mode to get the field's value 
                 // if the field's value is in disk by checking child process memory
                 all_fields_not_in_disk = 0;
-                if (!send_request_for_field_in_child_process(dbid, key, field))
-                {
-                    dictRelease(new_hash);
-                    dictReleaseIterator(di_hash);
-                    return NULL;
-                }
-                const sds response = receive_response_in_child_process();
+                sds rock_key = sdsdup(key);
+                rock_key = encode_rock_key_for_hash(dbid, rock_key, field);
+                const sds response = get_val_by_rock_key_in_child_process(dbid, rock_key);
+                sdsfree(rock_key);
                 if (response == NULL)
                 {
                     dictRelease(new_hash);
@@ -1214,33 +1691,11 @@ robj* get_value_if_exist_in_rock_for_rdb_afo(const robj *o, const int dbid, cons
     // We need check current memory (for redis process or child process)
     // to know whether it is for disk
     // It could be a whole key of rock value or some fields in rocksdb
-    int have_field_in_disk = 0;
-    if (!is_rock_value(o))
-    {
-        dictEntry *de = dictFind(db->rock_hash, key);
-        if (de == NULL)
-        {
-            // not rock value and not exist in rock hash, it is a concrete value
-            return (robj*)o;   
-        }
-        else
-        {
-            serverAssert(o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT);
-            dict *lrus = dictGetVal(de);
-            dict *hash = o->ptr;
+    const int in_disk = check_val_in_disk(db, o, key);
+    if (in_disk == VAL_ALL_IN_MEMORY)
+        return (robj*)o;
 
-            if (dictSize(hash) == dictSize(lrus))
-            {
-                // all fields not in disk for a hash (even the key is in rock_hash), 
-                // it is a concrete value
-                return (robj*)o;       
-            }
-            else
-            {
-                have_field_in_disk = 1;
-            }
-        }
-    }
+    const int have_field_in_disk = in_disk == VAL_SOME_FIELDS_IN_DISK;
 
     // We need create a temporary o_disk and return it
     // The caller has the responsibility to releasse o_disk
@@ -1315,18 +1770,15 @@ static int dealwith_request(const size_t content_len, char *buf, size_t buf_len)
         goto cleanup;
 
     // send back the response to child process by writing to pipe write end of response
-    ssize_t write_res;
     const size_t response_len = sdslen(response);
     serverAssert(response_len > 0 && response_len <= SSIZE_MAX);
 
     // write header first of the size of the response
-    write_res = write(pipe_response[1], &response_len, sizeof(size_t));
-    if (write_res < 0 || (size_t)write_res != sizeof(size_t))
+    if (!write_all_to_pipe(pipe_response[1], (const char*)&response_len, sizeof(size_t)))
         goto cleanup;
 
-    // then write the response itself
-    write_res = write(pipe_response[1], response, response_len);
-    if (write_res < 0 || (size_t)write_res != response_len)
+    // then write the response itself, it could be big for a batch
+    if (!write_all_to_pipe(pipe_response[1], response, response_len))
         goto cleanup;
 
     ret = 1;    // it is sucessful
@@ -1417,7 +1869,6 @@ static void* service_thread_main(void *arg)
     serverAssert(snapshot !=  NULL);
     serverAssert(pthread_mutex_unlock(&mutex_main_and_service) == 0);
 
-    #define PIPE_READ_BUF_LEN 64
     char buf[PIPE_READ_BUF_LEN];
     
     char header_buf[sizeof(size_t)];
@@ -1502,6 +1953,334 @@ static void* service_thread_main(void *arg)
     return NULL;    // exit service thread normally
 }
 
+/* Called in child process by rdbSaveRio() when it starts with RDBFLAGS_ROCK_SST,
+ * i.e., the full sync to RedRock replicas with the capability of rock-sst. 
+ * Check rdbSaveToSlavesSockets().
+ *
+ * After that, the values of whole keys in disk are not requested from service thread
+ * (check collect_batch_ahead_in_child_process()) but sent by rdb_save_rock_rows().
+ */
+void on_start_rock_sst_in_child_process()
+{
+    serverAssert(child_process_id != 0);
+    child_rock_sst = 1;
+}
+
+/* Called in child process by rdbSaveRio() with RDBFLAGS_ROCK_SST for a whole key in disk.
+ * 
+ * We only save the index of the key without reading the value, i.e., 
+ * RDB_OPCODE_ROCK_COLD, the key, the type and encoding of the rock value, 
+ * and the cardinality plus one (zero for unknown, check rock_evict.c).
+ * 
+ * Return -1 if error.
+ */
+int rdb_save_rock_cold_key(rio *rdb, const int dbid, robj *key, const robj *o, const long long expire)
+{
+    serverAssert(child_process_id != 0 && child_rock_sst && is_rock_value(o));
+
+    if (expire != -1)
+    {
+        if (rdbSaveType(rdb, RDB_OPCODE_EXPIRETIME_MS) == -1) 
+            return -1;
+        if (rdbSaveMillisecondTime(rdb, expire) == -1) 
+            return -1;
+    }
+
+    if (rdbSaveType(rdb, RDB_OPCODE_ROCK_COLD) == -1)
+        return -1;
+    if (rdbSaveStringObject(rdb, key) == -1)
+        return -1;
+    if (rdbSaveType(rdb, o->type) == -1)
+        return -1;
+    if (rdbSaveType(rdb, o->encoding) == -1)
+        return -1;
+
+    const sds redis_key = key->ptr;
+    uint64_t card = 0;
+    if (has_cardinality_of_rock_value(dbid, redis_key))
+        card = (uint64_t)get_cardinality_of_rock_value(dbid, redis_key) + 1;
+    if (rdbSaveLen(rdb, card) == -1)
+        return -1;
+
+    return 1;
+}
+
+/* Called in child process to check whether the row of RocksDB 
+ * is for a whole key in disk (in child process memory), i.e., the value of a rock key of db,
+ * or one of its segments. Other rows could be deleted keys (not purged yet) 
+ * or the keys which have been recovered to memory, so the replica does not need them.
+ */
+static int is_cold_row_in_child_process(const sds rock_key)
+{
+    int dbid;
+    const char *key;
+    size_t key_sz;
+    if (rock_key[0] == ROCK_KEY_FOR_DB)
+    {
+        decode_rock_key_for_db(rock_key, &dbid, &key, &key_sz);
+    }
+    else if (rock_key[0] == ROCK_KEY_FOR_SEGMENT)
+    {
+        uint32_t index;
+        decode_rock_key_for_segment(rock_key, &dbid, &key, &key_sz, &index);
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (dbid < 0 || dbid >= server.dbnum)
+        return 0;
+
+    sds redis_key = sdsnewlen(key, key_sz);
+    dictEntry *de = dictFind(server.db[dbid].dict, redis_key);
+    sdsfree(redis_key);
+
+    return de != NULL && is_rock_value(dictGetVal(de));
+}
+
+/* Called in child process by rdbSaveRio() with RDBFLAGS_ROCK_SST after all keys are saved.
+ * 
+ * The values of the whole keys in disk are sent as the rows of RocksDB, i.e., 
+ * RDB_OPCODE_ROCK_ROW, the rock key, the value (marshalled or segment head or segment).
+ * The rows are scanned from the snapshot of RocksDB page by page by the service thread,
+ * so it is a sequential read of RocksDB with no marshal or unmarshal.
+ * The replica writes the rows to SST files and ingests them (check rock_load.c).
+ * 
+ * Return -1 if error.
+ */
+int rdb_save_rock_rows(rio *rdb)
+{
+    serverAssert(child_process_id != 0 && child_rock_sst);
+
+    // NOTE: only one request in pipe
+    if (child_in_flight_cnt != 0 && !receive_batch_in_child_process())
+        return -1;
+
+    int ret = -1;
+    sds start = sdsempty();
+    sds rock_key = sdsempty();
+    sds page = NULL;
+    while (1)
+    {
+        if (!send_scan_request_in_child_process(start))
+            goto end;
+
+        page = receive_response_in_child_process();
+        if (page == NULL)
+            goto end;
+
+        // check scan_snapshot_in_service_thread() for the encoding
+        char *p = page;
+        size_t p_len = sdslen(page);
+        if (p_len < 1 + sizeof(size_t))
+            goto end;
+
+        const int is_last = p[0];
+        const size_t next_len = *((size_t*)(p + 1));
+        p += 1 + sizeof(size_t);
+        p_len -= 1 + sizeof(size_t);
+        if (p_len < next_len)
+            goto end;
+
+        sdsclear(start);
+        start = sdscatlen(start, p, next_len);
+        p += next_len;
+        p_len -= next_len;
+
+        while (p_len != 0)
+        {
+            if (p_len < sizeof(size_t))
+                goto end;
+            const size_t key_len = *((size_t*)p);
+            p += sizeof(size_t);
+            p_len -= sizeof(size_t);
+            if (p_len < key_len)
+                goto end;
+            const char *key = p;
+            p += key_len;
+            p_len -= key_len;
+
+            if (p_len < sizeof(size_t))
+                goto end;
+            const size_t val_len = *((size_t*)p);
+            p += sizeof(size_t);
+            p_len -= sizeof(size_t);
+            if (p_len < val_len)
+                goto end;
+            const char *val = p;
+            p += val_len;
+            p_len -= val_len;
+
+            sdsclear(rock_key);
+            rock_key = sdscatlen(rock_key, key, key_len);
+            if (!is_cold_row_in_child_process(rock_key))
+                continue;
+
+            if (rdbSaveType(rdb, RDB_OPCODE_ROCK_ROW) == -1)
+                goto end;
+            if (rdbSaveRawString(rdb, (unsigned char*)key, key_len) == -1)
+                goto end;
+            if (rdbSaveRawString(rdb, (unsigned char*)val, val_len) == -1)
+                goto end;
+        }
+
+        sdsfree(page);
+        page = NULL;
+
+        if (is_last)
+            break;
+    }
+
+    ret = 1;
+
+end:
+    if (ret == -1)
+        serverLog(LL_WARNING, "rdb_save_rock_rows() failed!");
+
+    sdsfree(page);
+    sdsfree(rock_key);
+    sdsfree(start);
+    return ret;
+}
+
+/* Called in rdbLoadRio() for RDB_OPCODE_ROCK_COLD from a RedRock master. 
+ * Check rdb_save_rock_cold_key().
+ * 
+ * The key is added to db as a rock value, 
+ * and its value will be loaded to RocksDB by rdb_load_rock_row().
+ * 
+ * Return -1 if error.
+ */
+/* The rock keys of db for the cold keys skipped by rdb_load_rock_cold_key() (e.g., expired),
+ * so their rows (and segments) are dropped by rdb_load_rock_row().
+ * Released by release_skipped_rock_cold_keys() when the load finishes.
+ */
+static dict *skipped_cold_keys = NULL;
+
+int rdb_load_rock_cold_key(rio *rdb, redisDb *db, const int rdbflags, const long long expiretime)
+{
+    sds key = rdbGenericLoadStringObject(rdb, RDB_LOAD_SDS, NULL);
+    if (key == NULL)
+        return -1;
+
+    const int type = rdbLoadType(rdb);
+    const int encoding = rdbLoadType(rdb);
+    const uint64_t card = rdbLoadLen(rdb, NULL);
+    if (type < 0 || type > OBJ_HASH || encoding == -1 || card == RDB_LENERR)
+    {
+        sdsfree(key);
+        return -1;
+    }
+
+    robj check_o;
+    check_o.type = type;
+    check_o.encoding = encoding;
+    if (get_match_rock_value(&check_o) == NULL)
+    {
+        serverLog(LL_WARNING, "rdb_load_rock_cold_key() unknown rock value, type = %d, encoding = %d, key = %s", 
+                  type, encoding, key);
+        sdsfree(key);
+        return -1;
+    }
+
+    if (iAmMaster() && !(rdbflags & RDBFLAGS_AOF_PREAMBLE) && 
+        expiretime != -1 && expiretime < mstime())
+    {
+        // the rows of the key follow, drop them too
+        if (skipped_cold_keys == NULL)
+            skipped_cold_keys = dictCreate(&setDictType, NULL);
+        dictAdd(skipped_cold_keys, encode_rock_key_for_db(db->id, key), NULL);
+        return 1;
+    }
+
+    robj keyobj;
+    initStaticStringObject(keyobj, key);
+    db_add_cold_key_when_load_rdb(db, key, type, encoding, rdbflags, &keyobj);
+
+    if (server.cluster_enabled) 
+        slotToKeyAdd(key);
+
+    if (expiretime != -1)
+        setExpire(NULL, db, &keyobj, expiretime);
+
+    if (card != 0)
+        set_cardinality_of_rock_value_when_load(db->id, key, (size_t)(card - 1));
+
+    moduleNotifyKeyspaceEvent(NOTIFY_LOADED, "loaded", &keyobj, db->id);
+    return 1;
+}
+
+/* The segment key from a master must be the same layout, check ROCK_KEY_FORMAT_VERSION */
+static int is_valid_rock_key_for_segment(const sds rock_key)
+{
+    size_t key_len;
+    const size_t len_sz = decode_rock_key_len((const unsigned char*)rock_key+2, sdslen(rock_key)-2, &key_len);
+    return len_sz != 0 && sdslen(rock_key) == 2 + len_sz + key_len + sizeof(uint32_t);
+}
+
+/* Return 1 if the row (the rock key of db or a segment) is for a skipped cold key */
+static int is_row_of_skipped_cold_key(const sds rock_key)
+{
+    if (skipped_cold_keys == NULL)
+        return 0;
+
+    if (rock_key[0] == ROCK_KEY_FOR_DB)
+        return dictFind(skipped_cold_keys, rock_key) != NULL;
+
+    int dbid;
+    const char *redis_key;
+    size_t key_sz;
+    uint32_t index;
+    decode_rock_key_for_segment(rock_key, &dbid, &redis_key, &key_sz, &index);
+    sds db_key = encode_rock_key_for_db(dbid, sdsnewlen(redis_key, key_sz));
+    const int skipped = dictFind(skipped_cold_keys, db_key) != NULL;
+    sdsfree(db_key);
+    return skipped;
+}
+
+/* Called in rdbLoadRio() when the load finishes (or fails) */
+void release_skipped_rock_cold_keys()
+{
+    if (skipped_cold_keys)
+    {
+        dictRelease(skipped_cold_keys);
+        skipped_cold_keys = NULL;
+    }
+}
+
+/* Called in rdbLoadRio() for RDB_OPCODE_ROCK_ROW from a RedRock master. 
+ * Check rdb_save_rock_rows().
+ * 
+ * Return -1 if error.
+ */
+int rdb_load_rock_row(rio *rdb)
+{
+    sds rock_key = rdbGenericLoadStringObject(rdb, RDB_LOAD_SDS, NULL);
+    if (rock_key == NULL)
+        return -1;
+
+    sds val = rdbGenericLoadStringObject(rdb, RDB_LOAD_SDS, NULL);
+    if (val == NULL || sdslen(rock_key) < 1 + 1 || 
+        (rock_key[0] != ROCK_KEY_FOR_DB && rock_key[0] != ROCK_KEY_FOR_SEGMENT) ||
+        (rock_key[0] == ROCK_KEY_FOR_SEGMENT && !is_valid_rock_key_for_segment(rock_key)))
+    {
+        sdsfree(rock_key);
+        sdsfree(val);
+        return -1;
+    }
+
+    if (is_row_of_skipped_cold_key(rock_key))
+    {
+        sdsfree(rock_key);
+        sdsfree(val);
+        return 1;
+    }
+
+    load_row_to_rocksdb_by_sst(rock_key, val);
+    return 1;
+}
+
 /* When redis server starts, it loads rdb file in two ways.
  * 1. directly from a rdb file
  * 2. from aof file which has part of rdb content
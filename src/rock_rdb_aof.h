@@ -49,4 +49,12 @@ void on_after_load_rdb_backup();
 // for whole situations: child process and not child process
 robj* get_value_if_exist_in_rock_for_rdb_afo(const robj *o, const int dbid, const sds key);
 
+// for full sync to RedRock replicas by rows of RocksDB, check RDBFLAGS_ROCK_SST
+void on_start_rock_sst_in_child_process();
+int rdb_save_rock_cold_key(rio *rdb, const int dbid, robj *key, const robj *o, const long long expire);
+int rdb_save_rock_rows(rio *rdb);
+int rdb_load_rock_cold_key(rio *rdb, redisDb *db, const int rdbflags, const long long expiretime);
+int rdb_load_rock_row(rio *rdb);
+void release_skipped_rock_cold_keys();
+
 #endif
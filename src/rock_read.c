@@ -36,57 +36,139 @@
 #include "rock_write.h"
 #include "rock_hash.h"
 #include "rock_evict.h"
+#include "rock_segment.h"
 
 
+/* The batch size of each worker is adaptive, from READ_MIN_BATCH_LEN
+ * up to the config rock-read-batch-max (which is no more than ROCK_READ_MAX_BATCH).
+ * Check adjust_batch_len() for details.
+ */
+#define READ_TOTAL_LEN      ROCK_READ_MAX_BATCH
+#define READ_MIN_BATCH_LEN  8
+
+/*
+ * The read work is shared by a pool of read threads (i.e., read workers).
+ * The number of workers is configured by rock-read-threads (immutable).
+ *
+ * Each worker owns a shard of the candidates, i.e., the rock keys waiting for reading,
+ * and its own batch of tasks and return values, protected by its own mutex.
+ * A rock key always goes to the same shard by the hash of the rock key,
+ * so for one rock key, there is only one worker for it.
+ *
+ * All workers share the same pipe to signal the main thread.
+ * The byte written to the pipe is the index of the worker,
+ * so main thread knows which worker's batch is finished.
+ */
+typedef struct rockReadWorker
+{
+    int idx;
+    pthread_t thread_id;
+    pthread_mutex_t mutex;
+    pthread_cond_t cv;
+    dict *candidates;
+    int task_status;
+    int batch_len;
+    sds tasks[READ_TOTAL_LEN];
+    sds return_vals[READ_TOTAL_LEN];
+} __attribute__((aligned(64))) rockReadWorker;      // friend to cpu cache line
+
+static rockReadWorker read_workers[ROCK_READ_MAX_THREADS];
+static int read_worker_num = 0;
+
+/* Statistics for INFO. Only accessed in main thread.
+ * read_batch_histogram[i] is the count of the batches 
+ * whose size is in (2^(i-1), 2^i], i.e., <= 1, 2, 4, ..., ROCK_READ_MAX_BATCH
+ */
+#define READ_BATCH_HISTOGRAM_LEN    8
+static long long read_batch_histogram[READ_BATCH_HISTOGRAM_LEN];
+static long long read_batch_total = 0;
+static long long read_key_total = 0;
+static long long read_prefetch_total = 0;
+static long long read_hash_scan_total = 0;
+
+/* When a command needs many cold fields of a hash (e.g., HGETALL or HVALS), 
+ * instead of the point lookups of each field, the read thread scans all fields of the hash
+ * by the prefix of the rock keys of its fields (check rock_prefix_transform() in rock.c)
+ * as one task, i.e., sequential I/O. The task's rock key is the prefix 
+ * with the type of ROCK_KEY_FOR_HASH_SCAN, check encode_scan_key_for_hash().
+ *
+ * It is only when the fields needed are all the cold fields of the hash 
+ * (so no cold field of the hash is in the write ring buffer), no less than HASH_SCAN_MIN_FIELDS
+ * and no less than half of all fields of the hash, check is_worth_scanning_hash().
+ *
+ * While a scan is in candidates, no field of the hash can be evicted,
+ * check already_in_candidates_for_hash(), so all fields in RocksDB are the latest for the scan.
+ */
+#define HASH_SCAN_MIN_FIELDS    32
+static long long hash_scans_in_candidates = 0;      // only accessed in main thread
+
 #ifdef RED_ROCK_MUTEX_DEBUG
 static pthread_mutexattr_t mattr_read;
-static pthread_mutex_t mutex_read;
-#else
-static pthread_mutex_t mutex_read = PTHREAD_MUTEX_INITIALIZER;     
 #endif
-static pthread_cond_t cv;
 
-inline static void rock_r_lock() 
+inline static void rock_r_lock(rockReadWorker *w) 
 {
-    serverAssert(pthread_mutex_lock(&mutex_read) == 0);
+    serverAssert(pthread_mutex_lock(&w->mutex) == 0);
 }
    
-inline static void rock_r_unlock() 
+inline static void rock_r_unlock(rockReadWorker *w) 
 {
-    serverAssert(pthread_mutex_unlock(&mutex_read) == 0);
+    serverAssert(pthread_mutex_unlock(&w->mutex) == 0);
 }
 
-inline static void rock_r_wait_cond()
+inline static void rock_r_wait_cond(rockReadWorker *w)
 {
-    serverAssert(pthread_cond_wait(&cv, &mutex_read) == 0);
+    serverAssert(pthread_cond_wait(&w->cv, &w->mutex) == 0);
 }
 
+inline static void rock_r_signal_worker(rockReadWorker *w)
+{
+    serverAssert(pthread_cond_signal(&w->cv) == 0);
+}
+
+/* Called in main thread (rock.c) when main thread will exit.
+ * Wake up all read workers so they can check rock_threads_loop_forever.
+ */
 void rock_r_signal_cond()
 {
-    serverAssert(pthread_cond_signal(&cv) == 0);
+    for (int i = 0; i < read_worker_num; ++i)
+    {
+        rockReadWorker *w = read_workers + i;
+        rock_r_lock(w);
+        rock_r_signal_worker(w);
+        rock_r_unlock(w);
+    }
 }
 
-pthread_t rock_read_thread_id;
+/* Which worker (i.e., the shard of candidates) the rock key belongs to */
+static rockReadWorker* worker_of_rock_key(const sds rock_key)
+{
+    if (read_worker_num == 1)
+        return read_workers;
+
+    const uint64_t hash = dictGenHashFunction(rock_key, sdslen(rock_key));
+    return read_workers + (hash % read_worker_num);
+}
 
 
 /*
- * The critical data is a hash table and array of tasks (task key and return value)
+ * The critical data for each worker is a hash table and array of tasks (task key and return value)
  *
- * 1. For hash table, i.e., read_rock_key_candidates,
+ * 1. For hash table, i.e., candidates of the worker,
  *    key is the rock_key and value is a list of clients(client_id) waiting for the key
- *    NOTE1: List may be NULL before the key is deleted from read_rock_key_candidates
+ *    NOTE1: List may be NULL before the key is deleted from candidates
  *          when return task needs to join all lists 
  *    NOTE2: For one key, it is possible to have more than 1 same client
  *           because client use transaction or just MGET k1, k1 ...
  * 
- * 2. For array of tasks, i.e., read_key_tasks and read_return_vals and task_status,
- *    read_key_tasks is the tasks for the read thread. (from the beginning until NULL)
+ * 2. For array of tasks, i.e., tasks and return_vals and task_status of the worker,
+ *    tasks is the tasks for the worker. (from the beginning until NULL)
  * 
  * NOTE1: read thread needs to copy tasks to avoid data race when read from RocksDB.
  *
  * NOTE2: Task is the rock key to read. 
- *        It points to the hash table key (same as the one in read_rock_key_candidates)
- *        So if a key is removed from read_rock_key_candidates, 
+ *        It points to the hash table key (same as the one in candidates)
+ *        So if a key is removed from candidates, 
  *        it is needed to remove from the array first by setting the slot to NULL.
  * 
  * When main thread finishes assigning tasks, it sets task_status to READ_START_TASK
@@ -138,15 +220,8 @@ dictType readCandidatesDictType =
     NULL                        /* allow to expand */
 };
 
-static dict* read_rock_key_candidates = NULL;
-
 #define READ_START_TASK   1
 #define READ_RETURN_TASK  2
-static int task_status = READ_RETURN_TASK;
-
-#define READ_TOTAL_LEN  8
-static sds read_key_tasks[READ_TOTAL_LEN] __attribute__((aligned(64)));     // friend to cpu cache line
-static sds read_return_vals[READ_TOTAL_LEN] __attribute__((aligned(64)));
 
 /* We use pipe to signal main thread
  */
@@ -174,25 +249,25 @@ static void init_rock_pipe()
  * by copyinng the keys (but not duplicating).
  * The return is the number of the copy rock keys to read from RocksDB.
  */
-static int pick_tasks(sds *copy_rock_keys)
+static int pick_tasks(rockReadWorker *w, sds *copy_rock_keys)
 {
-    rock_r_lock();
+    rock_r_lock(w);
 
-    if (task_status == READ_RETURN_TASK)
+    if (w->task_status == READ_RETURN_TASK)
     {
         // no task or main thread is late to recover data
-        rock_r_unlock();
+        rock_r_unlock(w);
         return 0;     
     }
 
     int cnt = 0;
     for (int i = 0; i < READ_TOTAL_LEN; ++i)
     {
-        const sds task = read_key_tasks[i];
+        const sds task = w->tasks[i];
 
         if (task == NULL)   // the end of this batch of tasks
         {
-            serverAssert(read_return_vals[i] == NULL);
+            serverAssert(w->return_vals[i] == NULL);
             break;
         }
 
@@ -200,18 +275,147 @@ static int pick_tasks(sds *copy_rock_keys)
         ++cnt;
     }
     
-    rock_r_unlock();
+    rock_r_unlock(w);
 
     serverAssert(cnt > 0);
     return cnt;
 }
 
+static sds encode_scan_key_for_hash(const int dbid, const sds hash_key)
+{
+    sds empty_field = sdsempty();
+    sds scan_key = encode_rock_key_for_hash(dbid, sdsdup(hash_key), empty_field);
+    sdsfree(empty_field);
+    scan_key[0] = ROCK_KEY_FOR_HASH_SCAN;
+    return scan_key;
+}
+
+/* Like decode_rock_key_for_hash() but for the scan key without field */
+static void decode_scan_key_for_hash(const sds scan_key, int *dbid, const char **hash_key, size_t *key_sz)
+{
+    serverAssert(sdslen(scan_key) >= 2 + 1);
+    serverAssert(scan_key[0] == ROCK_KEY_FOR_HASH_SCAN);
+    *dbid = scan_key[1];
+    size_t key_len;
+    const size_t len_sz = decode_rock_key_len((const unsigned char*)scan_key+2, sdslen(scan_key)-2, &key_len);
+    serverAssert(len_sz != 0 && sdslen(scan_key) == 2 + len_sz + key_len);
+    *hash_key = scan_key + 2 + len_sz;
+    *key_sz = key_len;
+}
+
+/* Work in read thread to scan all fields of a hash in RocksDB for the scan key.
+ * The return is all the fields and values, each is the length (size_t) and the bytes,
+ * i.e., field_len, field, val_len, val, field_len, field, ...
+ * check recover_data_for_hash_scan().
+ */
+static sds scan_hash_from_rocksdb(const sds scan_key)
+{
+    sds prefix = sdsdup(scan_key);
+    prefix[0] = ROCK_KEY_FOR_HASH;
+    const size_t prefix_len = sdslen(prefix);
+
+    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
+    rocksdb_readoptions_set_prefix_same_as_start(readoptions, 1);
+    rocksdb_readoptions_set_fill_cache(readoptions, 0);     // the values will be in memory, do not pollute block cache
+    rocksdb_iterator_t *iter = rocksdb_create_iterator(rockdb, readoptions);
+
+    sds fields_and_vals = sdsempty();
+    for (rocksdb_iter_seek(iter, prefix, prefix_len); rocksdb_iter_valid(iter); rocksdb_iter_next(iter))
+    {
+        size_t key_len;
+        const char *key = rocksdb_iter_key(iter, &key_len);
+        if (key_len < prefix_len || memcmp(key, prefix, prefix_len) != 0)
+            break;
+
+        const size_t field_len = key_len - prefix_len;
+        size_t val_len;
+        const char *val = rocksdb_iter_value(iter, &val_len);
+        fields_and_vals = sdscatlen(fields_and_vals, &field_len, sizeof(size_t));
+        fields_and_vals = sdscatlen(fields_and_vals, key + prefix_len, field_len);
+        fields_and_vals = sdscatlen(fields_and_vals, &val_len, sizeof(size_t));
+        fields_and_vals = sdscatlen(fields_and_vals, val, val_len);
+    }
+
+    char *err = NULL;
+    rocksdb_iter_get_error(iter, &err);
+    if (err)
+        serverPanic("scan_hash_from_rocksdb() reading from RocksDB failed, err = %s", err);
+
+    rocksdb_iter_destroy(iter);
+    rocksdb_readoptions_destroy(readoptions);
+    sdsfree(prefix);
+
+    return fields_and_vals;
+}
+
+#ifdef USE_ROCKSDB_ASYNC_IO
+/* Work in read thread. Like rocksdb_multi_get() with the same output, 
+ * but by the batched MultiGet of RocksDB with async_io.
+ *
+ * rocksdb_multi_get() is a loop of Get() in RocksDB, so the block reads 
+ * of the keys (the misses of block cache) are one after another.
+ * The batched one groups the keys by SST file and reads the data blocks of a file together 
+ * (by io_uring if RocksDB is built with liburing), and with async_io, 
+ * the reads of different files (levels) overlap, so the latency of a batch 
+ * is close to the slowest block read instead of the sum of them.
+ *
+ * It needs a RocksDB which has the batched MultiGet in its C API (newer than 7.2),
+ * check ROCKSDB_ASYNC_IO in Makefile.
+ */
+static void batched_multi_get_from_rocksdb(const int cnt, const sds *keys, sds *vals)
+{
+    char* errs[READ_TOTAL_LEN];
+    size_t rockdb_key_sizes[READ_TOTAL_LEN];
+    rocksdb_pinnableslice_t *rockdb_vals[READ_TOTAL_LEN];
+
+    for (int i = 0; i < cnt; ++i)
+    {
+        rockdb_key_sizes[i] = sdslen(keys[i]);
+        errs[i] = NULL;
+    }
+
+    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
+    rocksdb_readoptions_set_async_io(readoptions, 1);
+    rocksdb_column_family_handle_t *cf = rocksdb_get_default_column_family_handle(rockdb);
+    rocksdb_batched_multi_get_cf(rockdb, readoptions, cf, cnt, 
+                                 (const char* const *)keys, rockdb_key_sizes, 
+                                 rockdb_vals, errs, 0);
+    rocksdb_column_family_handle_destroy(cf);
+    rocksdb_readoptions_destroy(readoptions);
+
+    for (int i = 0; i < cnt; ++i)
+    {
+        if (errs[i])
+            serverPanic("batched_multi_get_from_rocksdb() reading from RocksDB failed, err = %s, key = %s", errs[i], keys[i]);
+
+        if (rockdb_vals[i] == NULL)
+        {
+            // not found, the main thread will handle it (by serverPanic) later.
+            vals[i] = NULL;
+        }
+        else
+        {
+            size_t len;
+            const char *val = rocksdb_pinnableslice_value(rockdb_vals[i], &len);
+            // copy out of the pinned block then release the pin
+            vals[i] = sdsnewlen(val, len);
+            rocksdb_pinnableslice_destroy(rockdb_vals[i]);
+            vals[i] = assemble_if_segment_head(keys[i], vals[i], NULL);
+        }
+    }
+}
+#endif
+
 /* Work in read thead to read values for keys (rock key).
  * The caller guarantees not in lock mode.
- * NOTE: no need to work in lock mode because keys is copied from read_key_tasks
+ * NOTE: no need to work in lock mode because keys is copied from the tasks of the worker
+ *       It is also called in main thread for sync mode, check direct_read_from_rocksdb().
  */
-static void read_from_rocksdb(const int cnt, const sds *keys, sds *vals)
+static void multi_get_from_rocksdb(const int cnt, const sds *keys, sds *vals)
 {
+#ifdef USE_ROCKSDB_ASYNC_IO
+    batched_multi_get_from_rocksdb(cnt, keys, vals);
+#else
     char* errs[READ_TOTAL_LEN];
     size_t rockdb_key_sizes[READ_TOTAL_LEN];
     char* rockdb_vals[READ_TOTAL_LEN];
@@ -250,8 +454,42 @@ static void read_from_rocksdb(const int cnt, const sds *keys, sds *vals)
             vals[i] = sdsnewlen(rockdb_vals[i], rockdb_val_sizes[i]);
             // free the malloc memory from RocksDB API
             rocksdb_free(rockdb_vals[i]);        
+            // big list, set or zset could be saved in segments, check rock_segment.c
+            vals[i] = assemble_if_segment_head(keys[i], vals[i], NULL);
+        }
+    }
+#endif
+}
+
+/* Like the above, but the scan keys for hashes are done by scan_hash_from_rocksdb() 
+ * and the others by one multi get.
+ */
+static void read_from_rocksdb(const int cnt, const sds *keys, sds *vals)
+{
+    int point_cnt = 0;
+    sds point_keys[READ_TOTAL_LEN];
+    sds point_vals[READ_TOTAL_LEN];
+    int point_indexes[READ_TOTAL_LEN];
+    for (int i = 0; i < cnt; ++i)
+    {
+        if (keys[i][0] == ROCK_KEY_FOR_HASH_SCAN)
+        {
+            vals[i] = scan_hash_from_rocksdb(keys[i]);
+        }
+        else
+        {
+            point_keys[point_cnt] = keys[i];
+            point_indexes[point_cnt] = i;
+            ++point_cnt;
         }
     }
+
+    if (point_cnt == 0)
+        return;
+
+    multi_get_from_rocksdb(point_cnt, point_keys, point_vals);
+    for (int i = 0; i < point_cnt; ++i)
+        vals[point_indexes[i]] = point_vals[i];
 }
 
 /* Called in read thread in an infinite loop.
@@ -261,99 +499,125 @@ static void read_from_rocksdb(const int cnt, const sds *keys, sds *vals)
  * and the tasks have been done,
  * i.e., changing READ_START_TASK to READ_RETURN_TASK.
  */
-static int do_tasks()
+static int do_tasks(rockReadWorker *w)
 {
     sds tasks[READ_TOTAL_LEN];
-    const int task_num = pick_tasks(tasks);
+    const int task_num = pick_tasks(w, tasks);
     if (task_num == 0)
         return 0;
 
     sds vals[READ_TOTAL_LEN];
     read_from_rocksdb(task_num, tasks, vals);
 
-    rock_r_lock();
+    rock_r_lock(w);
     for (int i = 0; i < task_num; ++i)
     {
-        serverAssert(read_return_vals[i] == NULL);
-        read_return_vals[i] = vals[i];      // transfer the val ownership
+        serverAssert(w->return_vals[i] == NULL);
+        w->return_vals[i] = vals[i];      // transfer the val ownership
     }
-    serverAssert(task_status == READ_START_TASK);
+    serverAssert(w->task_status == READ_START_TASK);
     // let pick_tasks() return 0 for the read thread
-    task_status = READ_RETURN_TASK; 
-    rock_r_unlock();
+    w->task_status = READ_RETURN_TASK; 
+    rock_r_unlock(w);
 
-    // signal main thread to recover data
-    const char temp_buf[1] = "a";
+    // signal main thread to recover data, the byte is the index of the worker
+    // NOTE: write() of one byte to a pipe is atomic for multi workers
+    const unsigned char temp_buf[1] = {(unsigned char)w->idx};
     serverAssert(write(rock_pipe_write, temp_buf, 1) == 1);
 
     return 1;
 }
 
 /*
- * The main entry for the read thread
+ * The main entry for each read thread (worker)
  */
-// #define MIN_SLEEP_MICRO     16
-// #define MAX_SLEEP_MICRO     1024            // max sleep for 1 ms
 static void* rock_read_main(void* arg)
 {
-    UNUSED(arg);
+    rockReadWorker *w = arg;
 
     int loop = 0;
     while (loop == 0)
         atomicGet(rock_threads_loop_forever, loop);
         
-    // unsigned int sleep_us = MIN_SLEEP_MICRO;
     while(loop)
     {
-        rock_r_lock();
-        while(loop && task_status == READ_RETURN_TASK)
+        rock_r_lock(w);
+        while(loop && w->task_status == READ_RETURN_TASK)
         {
-            rock_r_wait_cond();
+            rock_r_wait_cond(w);
             atomicGet(rock_threads_loop_forever, loop);
         }
-        rock_r_unlock();
+        rock_r_unlock(w);
 
         if (loop)
-            do_tasks();
-
-    /*
-        if (do_tasks() != 0)
-        {
-            sleep_us = MIN_SLEEP_MICRO;     // if we have task, shorten the sleep time
-            atomicGet(rock_threads_loop_forever, loop);
-            continue;       // no sleep, go on for more task
-        }        
+            do_tasks(w);
+    }
 
-        usleep(sleep_us);
-        sleep_us <<= 1;        // double sleep time
-        if (sleep_us > MAX_SLEEP_MICRO) 
-            sleep_us = MAX_SLEEP_MICRO;
+    return NULL;
+}
 
-        atomicGet(rock_threads_loop_forever, loop);
-    */
+/* Called in main thread to adjust the batch size of the worker before task assignment.
+ * The caller guarantees in lock mode.
+ *
+ * If the depth of the candidates is more than the current batch size,
+ * i.e., the backlog is growing, double the batch size for throughput.
+ * If the depth drops to a quarter of the batch size, halve it for tail latency.
+ * The batch size is always in [READ_MIN_BATCH_LEN, rock-read-batch-max],
+ * and rock-read-batch-max could be changed by CONFIG SET at any time.
+ */
+static void adjust_batch_len(rockReadWorker *w)
+{
+    const int max_len = server.rock_read_batch_max;
+    const int min_len = max_len < READ_MIN_BATCH_LEN ? max_len : READ_MIN_BATCH_LEN;
+    const size_t depth = dictSize(w->candidates);
 
+    int len = w->batch_len;
+    if (depth > (size_t)len)
+    {
+        len <<= 1;
+    }
+    else if (depth <= (size_t)(len >> 2))
+    {
+        len >>= 1;
     }
 
-    return NULL;
+    if (len > max_len)
+        len = max_len;
+    if (len < min_len)
+        len = min_len;
+
+    w->batch_len = len;
 }
 
-/* Called in main thread to get more keys (Up to READ_TOTAL_LEN) for task assignment.
+/* Called in main thread to record the batch size for INFO */
+static void add_batch_to_histogram(const int cnt)
+{
+    int i = 0;
+    while (i < READ_BATCH_HISTOGRAM_LEN-1 && (1 << i) < cnt)
+        ++i;
+
+    ++read_batch_histogram[i];
+    ++read_batch_total;
+    read_key_total += cnt;
+}
+
+/* Called in main thread to get more keys (Up to batch_len of the worker) for task assignment.
  * The caller guarantees in lock mode.
- * Copy (but not duplicate) the keys from read_rock_key_candidates for effiency.
+ * Copy (but not duplicate) the keys from the candidates of the worker for effiency.
  * Return the number of the selected keys.
  */
-static int get_keys_from_candidates_before_assignment(sds* rock_keys)
+static int get_keys_from_candidates_before_assignment(rockReadWorker *w, sds* rock_keys)
 {
     int cnt = 0;
 
-    dictIterator *di = dictGetIterator(read_rock_key_candidates);
+    dictIterator *di = dictGetIterator(w->candidates);
     dictEntry *de;
     while ((de = dictNext(di))) 
     {
         sds rock_key = dictGetKey(de);
         rock_keys[cnt] = rock_key;
         ++cnt;
-        if (cnt == READ_TOTAL_LEN)
+        if (cnt == w->batch_len)
             break;
     }
     dictReleaseIterator(di);
@@ -363,41 +627,44 @@ static int get_keys_from_candidates_before_assignment(sds* rock_keys)
 
 /* Called in main thread to assgin tasks.
  * The caller guarantees in lock mode.
- * NOTE: read_key_tasks will have the same pointer to keys in read_rock_key_candidates
+ * NOTE: tasks of the worker will have the same pointer to keys in candidates
  *       so the caller needs to guarantee safety of keys.
  */
-static void assign_tasks(const int cnt, const sds* tasks)
+static void assign_tasks(rockReadWorker *w, const int cnt, const sds* tasks)
 {
     serverAssert(cnt > 0);
-    serverAssert(read_key_tasks[0] == NULL);    // tasks must be empty
-    serverAssert(task_status != READ_START_TASK);
+    serverAssert(w->tasks[0] == NULL);    // tasks must be empty
+    serverAssert(w->task_status != READ_START_TASK);
 
     for (int i = 0; i < cnt; ++i)
     {
-        read_key_tasks[i] = tasks[i];
-        serverAssert(read_return_vals[i] == NULL);  // the val resource must be reclaimed already 
+        w->tasks[i] = tasks[i];
+        serverAssert(w->return_vals[i] == NULL);  // the val resource must be reclaimed already 
     }
-    task_status = READ_START_TASK;  // let read thread to work
+    w->task_status = READ_START_TASK;  // let read thread to work
 }
 
 /* Called in main thread to assign tasks.
  * The caller guarantee in lock mode.
  * If read thread is working or no task is available, no need to assgin task.
  */
-static void try_assign_tasks()
+static void try_assign_tasks(rockReadWorker *w)
 {
-    if (task_status == READ_START_TASK)
+    if (w->task_status == READ_START_TASK)
         return;   // read thread is working, can not assign task
 
-    if (read_key_tasks[0] != NULL)
+    if (w->tasks[0] != NULL)
         return;     // main thread has not response for the signal of read thread
 
+    adjust_batch_len(w);
+
     sds tasks[READ_TOTAL_LEN];
-    const int avail = get_keys_from_candidates_before_assignment(tasks);
+    const int avail = get_keys_from_candidates_before_assignment(w, tasks);
     if (avail != 0)
     {
-        assign_tasks(avail, tasks);    // change task_status to READ_START_TASK
-        rock_r_signal_cond();
+        add_batch_to_histogram(avail);
+        assign_tasks(w, avail, tasks);    // change task_status to READ_START_TASK
+        rock_r_signal_worker(w);
     }
     // else{}, need to keep task_status to READ_RETURN_TASK
 }
@@ -434,16 +701,15 @@ static void resume_command_for_client_in_async_mode(client *c)
  * It means the recover_val is just for the key.
  * 
  * If not, the key may be deleted or regenerated for the async mode.
+ * 
+ * NOTE: recover_val could be NULL (not found) if the key has been deleted 
+ *       and the tombstone has been written to RocksDB before the read (check rock_write.c). 
+ *       It is OK only when the key is not rock value anymore.
  */
 static void try_recover_val_object_in_redis_db(const int dbid, const sds recover_val,
                                                const char *redis_key, const size_t redis_key_len)
                                                
 {
-    if (recover_val == NULL)
-        // deal with read thread not found error later here
-        serverPanic("try_recover_val_object_in_redis_db() the recover_val is NULL(not found) for redis key = %s, dbid = %d", 
-                    redis_key, dbid);
-
     sds key = sdsnewlen(redis_key, redis_key_len);
 
     redisDb *db = server.db + dbid;
@@ -453,6 +719,11 @@ static void try_recover_val_object_in_redis_db(const int dbid, const sds recover
         const robj *o = dictGetVal(de);
         if (is_rock_value(o))
         {
+            if (recover_val == NULL)
+                // deal with read thread not found error later here
+                serverPanic("try_recover_val_object_in_redis_db() the recover_val is NULL(not found) for redis key = %s, dbid = %d", 
+                            redis_key, dbid);
+
             #if defined RED_ROCK_DEBUG
             serverAssert(debug_check_type(recover_val, o));
             #endif
@@ -480,11 +751,6 @@ static void try_recover_field_in_hash(const int dbid, const sds recover_val,
                                       const char *input_hash_key, const size_t input_hash_key_len,
                                       const char *input_hash_field, const size_t input_hash_field_len)
 {
-    if (recover_val == NULL)
-        // deal with read thread not found error later here
-        serverPanic("try_recover_field_in_hash() the recover_val is NULL(not found) for hash key = %s, hash_field = %s, dbid = %d", 
-                    input_hash_key, input_hash_field, dbid);
-
     sds hash_key = sdsnewlen(input_hash_key, input_hash_key_len);
     sds hash_field = sdsnewlen(input_hash_field, input_hash_field_len);
 
@@ -511,6 +777,12 @@ static void try_recover_field_in_hash(const int dbid, const sds recover_val,
     if (val != shared.hash_rock_val_for_field)
         goto reclaim;   // the field's value may be overwritten by other cliient
 
+    if (recover_val == NULL)
+        // deal with read thread not found error later here
+        // NOTE: NULL is OK above because of tombstone, check try_recover_val_object_in_redis_db()
+        serverPanic("try_recover_field_in_hash() the recover_val is NULL(not found) for hash key = %s, hash_field = %s, dbid = %d", 
+                    input_hash_key, input_hash_field, dbid);
+
     // NOTE: we need a copy of recover_val for the recover
     //       because the caller will reclaim recover_val, check recover_data()
     const sds copy_val = sdsdup(recover_val);
@@ -522,6 +794,73 @@ reclaim:
     sdsfree(hash_field);
 }
 
+/* Called in main thread.
+ * 
+ * Like try_recover_field_in_hash() but for all fields and values from the scan of the hash,
+ * check scan_hash_from_rocksdb(). The fields in RocksDB which are not cold fields
+ * (e.g., in memory or deleted) are skipped.
+ * 
+ * Because no field of the hash can be evicted during the scan,
+ * after that, there must be no cold field in the hash.
+ */
+static void try_recover_fields_of_hash_scan(const int dbid, const sds fields_and_vals,
+                                            const char *input_hash_key, const size_t input_hash_key_len)
+{
+    sds hash_key = sdsnewlen(input_hash_key, input_hash_key_len);
+
+    redisDb *db = server.db + dbid;
+    dictEntry *de_db = dictFind(db->dict, hash_key);
+    if (de_db == NULL)
+        goto reclaim;   // the hash key may be deleted by other client
+    
+    robj *o = dictGetVal(de_db);
+    if (!(o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT))
+        goto reclaim;   // the hash key may be overwritten by other client     
+
+    if (is_rock_value(o))
+        goto reclaim;   // check try_recover_field_in_hash()
+
+    dict *hash = o->ptr;
+    const char *p = fields_and_vals;
+    const char *end = fields_and_vals + sdslen(fields_and_vals);
+    while (p < end)
+    {
+        size_t field_len;
+        memcpy(&field_len, p, sizeof(size_t));
+        p += sizeof(size_t);
+        sds field = sdsnewlen(p, field_len);
+        p += field_len;
+        size_t val_len;
+        memcpy(&val_len, p, sizeof(size_t));
+        p += sizeof(size_t);
+        const char *val = p;
+        p += val_len;
+
+        dictEntry *de_hash = dictFind(hash, field);
+        if (de_hash && dictGetVal(de_hash) == shared.hash_rock_val_for_field)
+        {
+            dictGetVal(de_hash) = sdsnewlen(val, val_len);
+            on_recover_field_of_hash(dbid, hash_key, field);
+        }
+        sdsfree(field);
+    }
+    serverAssert(p == end);
+
+    dictIterator *di = dictGetIterator(hash);
+    dictEntry *de;
+    while ((de = dictNext(di)))
+    {
+        if (dictGetVal(de) == shared.hash_rock_val_for_field)
+            // deal with read thread not found error later here
+            serverPanic("try_recover_fields_of_hash_scan() not found in RocksDB for hash key = %s, hash_field = %s, dbid = %d", 
+                        hash_key, (sds)dictGetKey(de), dbid);
+    }
+    dictReleaseIterator(di);
+
+reclaim:
+    sdsfree(hash_key);
+}
+
 /* Called in main thread.
  * Join the clients for current task to waiting_clients
  * The caller guarantee in lock mode.
@@ -529,9 +868,9 @@ reclaim:
  * NOTE: Do not release the list for the candidate 
  *       because it will be freed whhen dictDelete() in the top caller.
  */
-static void join_waiting_clients(const sds task, list **waiting_clients)
+static void join_waiting_clients(rockReadWorker *w, const sds task, list **waiting_clients)
 {
-    dictEntry *de = dictFind(read_rock_key_candidates, task);
+    dictEntry *de = dictFind(w->candidates, task);
     serverAssert(de && dictGetKey(de) == task);
 
     list *candidate_list = dictGetVal(de);
@@ -546,9 +885,9 @@ static void join_waiting_clients(const sds task, list **waiting_clients)
  * because the key could be deleted or regenerated in async mode.
  * 
  * The client list will join to waiting_clients 
- * and thus will be set empty in read_rock_key_candidates
+ * and thus will be set empty in the candidates of the worker
  */
-static void recover_data_for_db(const sds task,
+static void recover_data_for_db(rockReadWorker *w, const sds task,
                                 const sds recover_val,
                                 list **waiting_clients)
 {
@@ -559,10 +898,10 @@ static void recover_data_for_db(const sds task,
 
     try_recover_val_object_in_redis_db(dbid, recover_val, redis_key, redis_key_len);
 
-    join_waiting_clients(task, waiting_clients);
+    join_waiting_clients(w, task, waiting_clients);
 }
 
-static void recover_data_for_hash(const sds task,
+static void recover_data_for_hash(rockReadWorker *w, const sds task,
                                  const sds recover_val,
                                  list **waiting_clients)
 {
@@ -575,7 +914,24 @@ static void recover_data_for_hash(const sds task,
 
     try_recover_field_in_hash(dbid, recover_val, hash_key, hash_key_len, hash_field, hash_field_len);
 
-    join_waiting_clients(task, waiting_clients);
+    join_waiting_clients(w, task, waiting_clients);
+}
+
+static void recover_data_for_hash_scan(rockReadWorker *w, const sds task,
+                                       const sds recover_val,
+                                       list **waiting_clients)
+{
+    int dbid;
+    const char *hash_key;
+    size_t hash_key_len;
+    decode_scan_key_for_hash(task, &dbid, &hash_key, &hash_key_len);
+
+    try_recover_fields_of_hash_scan(dbid, recover_val, hash_key, hash_key_len);
+
+    join_waiting_clients(w, task, waiting_clients);
+
+    serverAssert(hash_scans_in_candidates > 0);
+    --hash_scans_in_candidates;
 }
 
 /* Called in main thread.
@@ -588,7 +944,7 @@ static void recover_data_for_hash(const sds task,
  * will be checked whether they will be resumed again. 
  *
  * NOTE1: client may be invalid because the client id 
- *        won't be deleted in read_rock_key_candidates 
+ *        won't be deleted in candidates 
  *        while the client has closed a Redis connection.
  *
  * NOTE2: client id may be duplicated in client_ids 
@@ -625,39 +981,43 @@ static void check_client_resume_after_recover_data(const list *client_ids)
  * For the joining waiting clients, check whether they are ready 
  * for processing the command again because some values are restored
  */
-static void recover_data()
+static void recover_data(rockReadWorker *w)
 {
     list *waiting_clients = listCreate();
 
-    rock_r_lock();
-    serverAssert(task_status == READ_RETURN_TASK);
-    serverAssert(read_key_tasks[0] != NULL);
+    rock_r_lock(w);
+    serverAssert(w->task_status == READ_RETURN_TASK);
+    serverAssert(w->tasks[0] != NULL);
     for (int i = 0; i < READ_TOTAL_LEN; ++i)
     {
-        const sds task = read_key_tasks[i];
+        const sds task = w->tasks[i];
         if (task == NULL)
             break;  // the end of task array
 
         // join list will happen in recover_data_for_XX()
         if (task[0] == ROCK_KEY_FOR_DB)
         {
-            recover_data_for_db(task, read_return_vals[i], &waiting_clients);
+            recover_data_for_db(w, task, w->return_vals[i], &waiting_clients);
+        }
+        else if (task[0] == ROCK_KEY_FOR_HASH)
+        {
+            recover_data_for_hash(w, task, w->return_vals[i], &waiting_clients);
         }
         else
         {
-            serverAssert(task[0] == ROCK_KEY_FOR_HASH);
-            recover_data_for_hash(task, read_return_vals[i], &waiting_clients);
+            serverAssert(task[0] == ROCK_KEY_FOR_HASH_SCAN);
+            recover_data_for_hash_scan(w, task, w->return_vals[i], &waiting_clients);
         }
         
         // must set NULL for next batch task assignment, like try_assign_tasks() and read thread loop
-        read_key_tasks[i] = NULL;       // keys will be released by the following dictDelete()
-        sdsfree(read_return_vals[i]);
-        read_return_vals[i] = NULL;
+        w->tasks[i] = NULL;       // keys will be released by the following dictDelete()
+        sdsfree(w->return_vals[i]);
+        w->return_vals[i] = NULL;
 
-        serverAssert(dictDelete(read_rock_key_candidates, task) == DICT_OK);
+        serverAssert(dictDelete(w->candidates, task) == DICT_OK);
     }
-    try_assign_tasks();
-    rock_r_unlock();
+    try_assign_tasks(w);
+    rock_r_unlock(w);
 
     // NOTE: not in lock mode to call check_client_resume_after_recover_data()
     check_client_resume_after_recover_data(waiting_clients);    
@@ -666,7 +1026,11 @@ static void recover_data()
 }
 
 /* Main thread response the pipe signal from read thread
- * which indicates the tasks are finished */
+ * which indicates the tasks of the worker are finished.
+ * The byte from the pipe is the index of the worker.
+ * If more than one worker finish at the same time, 
+ * the event loop will call here again for the left bytes in the pipe.
+ */
 static void on_recover_data(struct aeEventLoop *eventLoop, int fd, void *clientData, int mask) 
 {
     UNUSED(mask);
@@ -675,10 +1039,82 @@ static void on_recover_data(struct aeEventLoop *eventLoop, int fd, void *clientD
     UNUSED(fd);
 
     // clear pipe signal
-    char tmp_use_buf[1];
+    unsigned char tmp_use_buf[1];
     serverAssert(read(rock_pipe_read, tmp_use_buf, 1) == 1);     
 
-    recover_data();
+    const int idx = tmp_use_buf[0];
+    serverAssert(idx < read_worker_num);
+    recover_data(read_workers + idx);
+}
+
+/* Called in main thread to add a rock key with the client id to the candidates 
+ * of the worker which the rock key belongs to.
+ * The caller guarantees not in lock mode.
+ *
+ * If the rock key is new in the candidates, the ownership of rock_key
+ * is transfered to the candidates and return 1.
+ * Otherwise, rock_key is released and return 0.
+ * NOTE: for the return 1, rock_key is still valid for the caller 
+ *       until the caller calls try_assign_tasks_for_added_workers().
+ */
+static int add_rock_key_to_candidates(const uint64_t client_id, sds rock_key)
+{
+    rockReadWorker *w = worker_of_rock_key(rock_key);
+    int added = 0;
+
+    rock_r_lock(w);
+    dictEntry *de = dictFind(w->candidates, rock_key);
+    if (de == NULL)
+    {
+        list *client_ids = listCreate();
+        listAddNodeHead(client_ids, (void*)client_id);  
+        // transfer ownership of rock_key and client_ids to candidates
+        dictAdd(w->candidates, rock_key, client_ids);    
+        added = 1;
+    }
+    else
+    {
+        list *client_ids = dictGetVal(de);
+        serverAssert(listLength(client_ids) > 0);
+        listAddNodeTail(client_ids, (void*)client_id);
+        sdsfree(rock_key);
+    }
+    rock_r_unlock(w);
+
+    return added;
+}
+
+/* The assignment of tasks could be deferred until end_batch_of_rock_reads(),
+ * so the rock keys from more than one call (e.g., a command and the prefetch for the pipeline)
+ * go to the read workers together. Check begin_batch_of_rock_reads().
+ */
+static int defer_assignment = 0;
+static int deferred_added[ROCK_READ_MAX_THREADS];
+
+/* Called in main thread after a batch of rock keys are added to candidates.
+ * We assign tasks after all keys are added (not one by one) 
+ * so that an idle worker can get a full batch to read.
+ * The caller guarantees not in lock mode.
+ */
+static void try_assign_tasks_for_added_workers(const int *added)
+{
+    if (defer_assignment)
+    {
+        for (int i = 0; i < read_worker_num; ++i)
+            deferred_added[i] |= added[i];
+        return;
+    }
+
+    for (int i = 0; i < read_worker_num; ++i)
+    {
+        if (!added[i])
+            continue;
+
+        rockReadWorker *w = read_workers + i;
+        rock_r_lock(w);
+        try_assign_tasks(w);
+        rock_r_unlock(w);
+    }
 }
 
 /* Called in main thread.
@@ -697,9 +1133,7 @@ static void go_on_need_rock_keys_from_rocksdb(const uint64_t client_id,
     listNode *ln;
     listRewind((list*)redis_keys, &li);
 
-    rock_r_lock();
-
-    int added = 0;
+    int added[ROCK_READ_MAX_THREADS] = {0};
     while ((ln = listNext(&li)))
     {
         const sds redis_key = listNodeValue(ln);
@@ -707,28 +1141,29 @@ static void go_on_need_rock_keys_from_rocksdb(const uint64_t client_id,
         sds rock_key = sdsdup(redis_key);
         rock_key = encode_rock_key_for_db(dbid, rock_key);
 
-        dictEntry *de = dictFind(read_rock_key_candidates, rock_key);
-        if (de == NULL)
-        {
-            list *client_ids = listCreate();
-            listAddNodeHead(client_ids, (void*)client_id);  
-            // transfer ownership of rock_key and client_ids to read_rock_key_candidates
-            dictAdd(read_rock_key_candidates, rock_key, client_ids);    
-            added = 1;
-        }
-        else
-        {
-            list *client_ids = dictGetVal(de);
-            serverAssert(listLength(client_ids) > 0);
-            listAddNodeTail(client_ids, (void*)client_id);
-            sdsfree(rock_key);
-        }
+        if (add_rock_key_to_candidates(client_id, rock_key))
+            added[worker_of_rock_key(rock_key)->idx] = 1;
     }
 
-    if (added)
-        try_assign_tasks();
+    try_assign_tasks_for_added_workers(added);
+}
+
+/* Called in main thread for sync mode to read values for rock keys from RocksDB directly.
+ * It reads in batches (by rocksdb_multi_get) of rock-read-batch-max
+ * instead of reading key by key (by rocksdb_get),
+ * so the main thread will be blocked much less for many keys.
+ * NOTE: vals[i] is NULL if not found and the caller needs to free vals[i].
+ */
+static void direct_read_from_rocksdb(const int cnt, const sds *keys, sds *vals)
+{
+    const int max_len = server.rock_read_batch_max;
+    serverAssert(max_len > 0 && max_len <= READ_TOTAL_LEN);
 
-    rock_r_unlock();
+    for (int i = 0; i < cnt; i += max_len)
+    {
+        const int batch = cnt - i > max_len ? max_len : cnt - i;
+        read_from_rocksdb(batch, keys + i, vals + i);
+    }
 }
 
 /* From redis_keys, direct read from RocksDB and recoover them in redis db in sync moode */
@@ -738,33 +1173,36 @@ static void direct_recover_rock_keys_from_rocksdb(const int dbid, const list *re
 
     redisDb *db = server.db + dbid;
 
+    const int cnt = listLength(redis_keys);
+    sds *rock_keys = zmalloc(sizeof(sds) * cnt);
+    sds *recover_vals = zmalloc(sizeof(sds) * cnt);
+
     listIter li;
     listNode *ln;
     listRewind((list*)redis_keys, &li);
-
+    int i = 0;
     while ((ln = listNext(&li)))
     {
         const sds redis_key = listNodeValue(ln);
 
         sds rock_key = sdsdup(redis_key);
-        rock_key = encode_rock_key_for_db(dbid, rock_key);
+        rock_keys[i] = encode_rock_key_for_db(dbid, rock_key);
+        ++i;
+    }
 
-        size_t db_val_len;
-        char *err = NULL;
-        rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
-        char *db_val = rocksdb_get(rockdb, readoptions, rock_key, sdslen(rock_key), &db_val_len, &err);
-        rocksdb_readoptions_destroy(readoptions);
+    direct_read_from_rocksdb(cnt, rock_keys, recover_vals);
 
-        if (err)
-            serverPanic("direct_recover_rock_keys_from_rocksdb(), err = %s", err);
+    listRewind((list*)redis_keys, &li);
+    i = 0;
+    while ((ln = listNext(&li)))
+    {
+        const sds redis_key = listNodeValue(ln);
+        const sds recover_val = recover_vals[i];
 
-        if (db_val == NULL)
+        if (recover_val == NULL)
             // NOT FOUND, it is illegal
             serverPanic("direct_recover_rock_keys_from_rocksdb(), not found, redis_key = %s", redis_key);
 
-        sds recover_val = sdsnewlen(db_val, db_val_len);
-        rocksdb_free(db_val);
-
         robj *recover_o = unmarshal_object(recover_val);
         sdsfree(recover_val);
 
@@ -782,64 +1220,138 @@ static void direct_recover_rock_keys_from_rocksdb(const int dbid, const list *re
             decrRefCount(recover_o);
         }
 
-        sdsfree(rock_key);
+        sdsfree(rock_keys[i]);
+        ++i;
     }
+
+    zfree(rock_keys);
+    zfree(recover_vals);
+}
+
+/* Called in main thread.
+ * The fields of the same hash key are together in hash_keys and hash_fields,
+ * e.g., generic_get_all_fields_for_rock() in rock.c.
+ * Return the number of the fields of the same hash key from ln_key.
+ */
+static int get_run_of_same_hash_key(listNode *ln_key)
+{
+    const sds hash_key = listNodeValue(ln_key);
+    int run = 1;
+    for (listNode *ln = listNextNode(ln_key); ln && sdscmp(listNodeValue(ln), hash_key) == 0; ln = listNextNode(ln))
+        ++run;
+
+    return run;
+}
+
+/* Called in main thread.
+ * Return the number of the distinct fields in the run from ln_field,
+ * because the same field could repeat, e.g., HMGET <key> f1 f1 f1.
+ */
+static int get_distinct_fields_of_run(listNode *ln_field, const int run)
+{
+    dict *distinct = dictCreate(&sdsReplyDictType, NULL);
+    for (int i = 0; i < run; ++i)
+    {
+        dictAdd(distinct, listNodeValue(ln_field), NULL);
+        ln_field = listNextNode(ln_field);
+    }
+    const int num = (int)dictSize(distinct);
+    dictRelease(distinct);
+    return num;
+}
+
+/* Called in main thread after the check for ring buffer.
+ * Return 1 if the cold fields needed (the run from ln_field) are enough for the scan of the whole hash, 
+ * i.e., they are all the cold fields of the hash (e.g., HGETALL), no less than HASH_SCAN_MIN_FIELDS
+ * and no less than half of all fields of the hash (because RocksDB could have the rows 
+ * for the clean fields in memory which the scan reads too).
+ * 
+ * NOTE: If some cold field not needed is in the write ring buffer,
+ *       its row in RocksDB is not the latest, so we can not scan.
+ *       So the repeated fields are counted once, otherwise they could hide the field not needed.
+ */
+static int is_worth_scanning_hash(const int dbid, const sds hash_key, listNode *ln_field, const int run)
+{
+    if (run < HASH_SCAN_MIN_FIELDS)
+        return 0;
+
+    const size_t cold_num = get_cold_field_num_of_rock_hash(dbid, hash_key);
+    if (cold_num > (size_t)run)
+        return 0;
+
+    const int field_num = get_distinct_fields_of_run(ln_field, run);
+    if (field_num < HASH_SCAN_MIN_FIELDS || cold_num != (size_t)field_num)
+        return 0;
+
+    dictEntry *de = dictFind(server.db[dbid].dict, hash_key);
+    serverAssert(de);
+    const robj *o = dictGetVal(de);
+    serverAssert(o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT);
+    return (size_t)field_num * 2 >= dictSize((dict*)o->ptr);
 }
 
 /* Called in main thread.
  * After the check for ring buffer for hash,
  * it goes on to recover value from RocksDB in async way.
  * 
+ * If many fields of a hash are needed, it is one task for the scan of the hash
+ * instead of one task for each field, check is_worth_scanning_hash().
+ * 
+ * Return the number of tasks added for the client, i.e., the number of the client id in candidates.
+ * 
  * NOTE: hash_keys and hash_fields will be duplicated for rock key format and saved in candidates.
  *       So the caller deals with the resource of redis_keys independently.
  */
-static void go_on_need_rock_hashes_from_rocksdb(const uint64_t client_id, const int dbid, 
-                                                const list *hash_keys, const list *hash_fields)
+static int go_on_need_rock_hashes_from_rocksdb(const uint64_t client_id, const int dbid, 
+                                               const list *hash_keys, const list *hash_fields)
 {
     serverAssert(listLength(hash_keys) > 0 && listLength(hash_keys) == listLength(hash_fields));
 
-    listIter li_key;
-    listNode *ln_key;
-    listIter li_field;
-    listNode *ln_field;
-    listRewind((list*)hash_keys, &li_key);
-    listRewind((list*)hash_fields, &li_field);
-
-    rock_r_lock();
+    listNode *ln_key = listFirst(hash_keys);
+    listNode *ln_field = listFirst(hash_fields);
 
-    int added = 0;
-    while ((ln_key = listNext(&li_key)))
+    int task_num = 0;
+    int added[ROCK_READ_MAX_THREADS] = {0};
+    while (ln_key)
     {
-        ln_field = listNext(&li_field);
-
         const sds hash_key = listNodeValue(ln_key);
-        const sds hash_field = listNodeValue(ln_field);
-
-        sds rock_key = sdsdup(hash_key);
-        rock_key = encode_rock_key_for_hash(dbid, rock_key, hash_field);
+        const int run = get_run_of_same_hash_key(ln_key);
+        const int scan = is_worth_scanning_hash(dbid, hash_key, ln_field, run);
 
-        dictEntry *de = dictFind(read_rock_key_candidates, rock_key);
-        if (de == NULL)
+        if (scan)
         {
-            list *client_ids = listCreate();
-            listAddNodeHead(client_ids, (void*)client_id);  
-            // transfer ownership of rock_key and client_ids to read_rock_key_candidates
-            dictAdd(read_rock_key_candidates, rock_key, client_ids);    
-            added = 1;
+            sds scan_key = encode_scan_key_for_hash(dbid, hash_key);
+            if (add_rock_key_to_candidates(client_id, scan_key))
+            {
+                added[worker_of_rock_key(scan_key)->idx] = 1;
+                ++hash_scans_in_candidates;
+                ++read_hash_scan_total;
+            }
+            ++task_num;
         }
-        else
+
+        for (int i = 0; i < run; ++i)
         {
-            list *client_ids = dictGetVal(de);
-            serverAssert(listLength(client_ids) > 0);
-            listAddNodeTail(client_ids, (void*)client_id);
-            sdsfree(rock_key);
+            if (!scan)
+            {
+                const sds hash_field = listNodeValue(ln_field);
+
+                sds rock_key = sdsdup(hash_key);
+                rock_key = encode_rock_key_for_hash(dbid, rock_key, hash_field);
+
+                if (add_rock_key_to_candidates(client_id, rock_key))
+                    added[worker_of_rock_key(rock_key)->idx] = 1;
+                ++task_num;
+            }
+
+            ln_key = listNextNode(ln_key);
+            ln_field = listNextNode(ln_field);
         }
     }
 
-    if (added)
-        try_assign_tasks();
+    try_assign_tasks_for_added_workers(added);
 
-    rock_r_unlock();
+    return task_num;
 }
 
 /* From hash_keys & hash_fields, direct read from RocksDB and recoover them in redis db in sync moode */
@@ -849,13 +1361,17 @@ static void direct_recover_rock_fields_from_rocksdb(const int dbid, const list *
 
     redisDb *db = server.db + dbid;
 
+    const int cnt = listLength(hash_keys);
+    sds *rock_keys = zmalloc(sizeof(sds) * cnt);
+    sds *recover_vals = zmalloc(sizeof(sds) * cnt);
+
     listIter li_key;
     listNode *ln_key;
     listIter li_field;
     listNode *ln_field;
     listRewind((list*)hash_keys, &li_key);
     listRewind((list*)hash_fields, &li_field);
-
+    int i = 0;
     while ((ln_key = listNext(&li_key)))
     {
         ln_field = listNext(&li_field);
@@ -864,25 +1380,28 @@ static void direct_recover_rock_fields_from_rocksdb(const int dbid, const list *
         const sds hash_field = listNodeValue(ln_field);
 
         sds rock_key = sdsdup(hash_key);
-        rock_key = encode_rock_key_for_hash(dbid, rock_key, hash_field);
+        rock_keys[i] = encode_rock_key_for_hash(dbid, rock_key, hash_field);
+        ++i;
+    }
 
-        size_t db_val_len;
-        char *err = NULL;
-        rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
-        char *db_val = rocksdb_get(rockdb, readoptions, rock_key, sdslen(rock_key), &db_val_len, &err);
-        rocksdb_readoptions_destroy(readoptions);
+    direct_read_from_rocksdb(cnt, rock_keys, recover_vals);
 
-        if (err)
-            serverPanic("direct_recover_rock_fields_from_rocksdb(), err = %s", err);
+    listRewind((list*)hash_keys, &li_key);
+    listRewind((list*)hash_fields, &li_field);
+    i = 0;
+    while ((ln_key = listNext(&li_key)))
+    {
+        ln_field = listNext(&li_field);
 
-        if (db_val == NULL)
+        const sds hash_key = listNodeValue(ln_key);
+        const sds hash_field = listNodeValue(ln_field);
+        const sds recover_val = recover_vals[i];
+
+        if (recover_val == NULL)
             // NOT FOUND, it is illegal
             serverPanic("direct_recover_rock_fields_from_rocksdb(), not found, hash_key = %s, hash_field = %s", 
                         hash_key, hash_field);
 
-        sds recover_val = sdsnewlen(db_val, db_val_len);
-        rocksdb_free(db_val);
-
         dictEntry *de_db = dictFind(db->dict, hash_key);
         serverAssert(de_db);
         robj *o_db = dictGetVal(de_db);
@@ -902,8 +1421,12 @@ static void direct_recover_rock_fields_from_rocksdb(const int dbid, const list *
             sdsfree(recover_val);
         }
 
-        sdsfree(rock_key);
+        sdsfree(rock_keys[i]);
+        ++i;
     }
+
+    zfree(rock_keys);
+    zfree(recover_vals);
 }
 
 
@@ -1269,8 +1792,7 @@ int on_client_need_rock_fields_for_hashes(client *c, const list *hash_keys, cons
     if (left_keys == NULL)
     {
         // nothing found in ring buffer
-        c->rock_key_num += listLength(hash_keys);
-        go_on_need_rock_hashes_from_rocksdb(client_id, dbid, hash_keys, hash_fields);
+        c->rock_key_num += go_on_need_rock_hashes_from_rocksdb(client_id, dbid, hash_keys, hash_fields);
     }
     else if (listLength(left_keys) == 0)
     {
@@ -1280,8 +1802,7 @@ int on_client_need_rock_fields_for_hashes(client *c, const list *hash_keys, cons
     }
     else
     {
-        c->rock_key_num += listLength(left_keys);
-        go_on_need_rock_hashes_from_rocksdb(client_id, dbid, left_keys, left_fields);
+        c->rock_key_num += go_on_need_rock_hashes_from_rocksdb(client_id, dbid, left_keys, left_fields);
     }
 
     if (left_keys)
@@ -1327,7 +1848,7 @@ void on_client_need_rock_fields_for_hash_in_sync_mode(client *c, const list *has
 
 /* API for rock_write.c for checking whether the key is in candidates
  * Called in main thread.
- * Return 1 if it is in read_rock_key_candidates. Otherwise 0.
+ * Return 1 if it is in candidates. Otherwise 0.
  */
 int already_in_candidates_for_db(const int dbid, const sds redis_key)
 {
@@ -1335,10 +1856,11 @@ int already_in_candidates_for_db(const int dbid, const sds redis_key)
     rock_key = encode_rock_key_for_db(dbid, rock_key);
 
     int exist = 0;
-    rock_r_lock();
-    if (dictFind(read_rock_key_candidates, rock_key) != NULL)
+    rockReadWorker *w = worker_of_rock_key(rock_key);
+    rock_r_lock(w);
+    if (dictFind(w->candidates, rock_key) != NULL)
         exist = 1;
-    rock_r_unlock();
+    rock_r_unlock(w);
 
     sdsfree(rock_key);
 
@@ -1347,7 +1869,7 @@ int already_in_candidates_for_db(const int dbid, const sds redis_key)
 
 /* API for rock_write.c for checking whether the key with the field is in candidates
  * Called in main thread.
- * Return 1 if it is in read_rock_key_candidates. Otherwise 0.
+ * Return 1 if it is in candidates. Otherwise 0.
  */
 int already_in_candidates_for_hash(const int dbid, const sds redis_key, const sds field)
 {
@@ -1355,57 +1877,200 @@ int already_in_candidates_for_hash(const int dbid, const sds redis_key, const sd
     rock_key = encode_rock_key_for_hash(dbid, rock_key, field);
 
     int exist = 0;
-    rock_r_lock();
-    if (dictFind(read_rock_key_candidates, rock_key) != NULL)
+    rockReadWorker *w = worker_of_rock_key(rock_key);
+    rock_r_lock(w);
+    if (dictFind(w->candidates, rock_key) != NULL)
         exist = 1;
-    rock_r_unlock();
+    rock_r_unlock(w);
 
     sdsfree(rock_key);
 
+    // the field is also in candidates if the scan of the whole hash is
+    if (!exist && hash_scans_in_candidates > 0)
+    {
+        sds scan_key = encode_scan_key_for_hash(dbid, redis_key);
+        w = worker_of_rock_key(scan_key);
+        rock_r_lock(w);
+        if (dictFind(w->candidates, scan_key) != NULL)
+            exist = 1;
+        rock_r_unlock(w);
+
+        sdsfree(scan_key);
+    }
+
     return exist;
 }
 
-/* the API for start the read thread 
- * Call only once in main thread and before the read thread starts
+/* the API for start the read threads 
+ * Call only once in main thread and before the read threads start
  */
 void init_and_start_rock_read_thread()
 {
+    read_worker_num = server.rock_read_threads_num;
+    serverAssert(read_worker_num >= 1 && read_worker_num <= ROCK_READ_MAX_THREADS);
+
 #ifdef RED_ROCK_MUTEX_DEBUG
     serverAssert(pthread_mutexattr_init(&mattr_read) == 0);
     serverAssert(pthread_mutexattr_settype(&mattr_read, PTHREAD_MUTEX_ERRORCHECK) == 0);
-    serverAssert(pthread_mutex_init(&mutex_read, &mattr_read) == 0);
 #endif
-    serverAssert(pthread_cond_init(&cv, NULL) == 0);
 
-    rock_r_lock();
-    read_rock_key_candidates = dictCreate(&readCandidatesDictType, NULL);
-    task_status = READ_RETURN_TASK;
-    for (int i = 0; i < READ_TOTAL_LEN; ++i)
+    for (int i = 0; i < read_worker_num; ++i)
     {
-        read_key_tasks[i] = NULL;
-        read_return_vals[i] = NULL;
+        rockReadWorker *w = read_workers + i;
+        w->idx = i;
+#ifdef RED_ROCK_MUTEX_DEBUG
+        serverAssert(pthread_mutex_init(&w->mutex, &mattr_read) == 0);
+#else
+        serverAssert(pthread_mutex_init(&w->mutex, NULL) == 0);
+#endif
+        serverAssert(pthread_cond_init(&w->cv, NULL) == 0);
+
+        rock_r_lock(w);
+        w->candidates = dictCreate(&readCandidatesDictType, NULL);
+        w->task_status = READ_RETURN_TASK;
+        w->batch_len = READ_MIN_BATCH_LEN;
+        for (int j = 0; j < READ_TOTAL_LEN; ++j)
+        {
+            w->tasks[j] = NULL;
+            w->return_vals[j] = NULL;
+        }
+        rock_r_unlock(w);
     }
-    rock_r_unlock();
 
     init_rock_pipe();
 
-    if (pthread_create(&rock_read_thread_id, NULL, rock_read_main, NULL) != 0) 
-        serverPanic("Unable to create a rock read thread.");
+    for (int i = 0; i < read_worker_num; ++i)
+    {
+        rockReadWorker *w = read_workers + i;
+        if (pthread_create(&w->thread_id, NULL, rock_read_main, w) != 0) 
+            serverPanic("Unable to create a rock read thread.");
+    }
 }
 
 /* Called in main thread for rock.c when main thread will exit */
 void join_read_thread()
 {
-    int s;
-    void *res;
-    
-    s = pthread_join(rock_read_thread_id, &res);
-    if (s != 0)
+    for (int i = 0; i < read_worker_num; ++i)
+    {
+        void *res;
+        const int s = pthread_join(read_workers[i].thread_id, &res);
+        if (s != 0)
+        {
+            serverLog(LL_WARNING, "rock read thread %d join failure. err = %d", i, s);
+        }
+        else
+        {
+            serverLog(LL_NOTICE, "rock read thread %d exit and join successfully.", i);
+        }
+    }
+}
+
+/* Called in main thread to defer the assignment of tasks until end_batch_of_rock_reads(),
+ * i.e., all rock keys needed between the two calls are read from RocksDB as one batch
+ * (up to the batch size of the workers) instead of the first ones go alone.
+ * Check check_and_set_rock_status_in_processCommand() in rock.c.
+ */
+void begin_batch_of_rock_reads()
+{
+    serverAssert(!defer_assignment);
+    defer_assignment = 1;
+    memset(deferred_added, 0, sizeof(deferred_added));
+}
+
+void end_batch_of_rock_reads()
+{
+    serverAssert(defer_assignment);
+    defer_assignment = 0;
+    try_assign_tasks_for_added_workers(deferred_added);
+}
+
+/* The client id for the rock keys of prefetch which no client waits for.
+ * Client ids start from 1, so lookup_client_from_id() returns NULL for it
+ * and check_client_resume_after_recover_data() skips it.
+ */
+#define PREFETCH_CLIENT_ID  0
+
+/* Called in main thread to prefetch the rock keys for the db,
+ * i.e., recover the values in async mode but no client waits for them.
+ * Check prefetch_rock_keys_for_pipeline() in rock.c.
+ *
+ * Like on_client_need_rock_keys_for_db(), check ring buffer first.
+ * The caller needs to reclaim the list.
+ */
+void prefetch_rock_keys_for_db(const int dbid, const list *redis_keys)
+{
+    serverAssert(listLength(redis_keys) > 0);
+
+    list *left = check_ring_buf_first_and_recover_for_db(dbid, redis_keys);
+    const list *to_read = left ? left : redis_keys;
+    if (listLength(to_read) > 0)
     {
-        serverLog(LL_WARNING, "rock read thread join failure. err = %d", s);
+        read_prefetch_total += listLength(to_read);
+        go_on_need_rock_keys_from_rocksdb(PREFETCH_CLIENT_ID, dbid, to_read);
     }
-    else
+
+    if (left)
+        listRelease(left);
+}
+
+/* Like the above, but for the fields of rock hashes */
+void prefetch_rock_fields_for_hashes(const int dbid, const list *hash_keys, const list *hash_fields)
+{
+    serverAssert(listLength(hash_keys) > 0 && listLength(hash_keys) == listLength(hash_fields));
+
+    list *left_keys = NULL;
+    list *left_fields = NULL;
+    check_ring_buf_first_and_recover_for_hash(dbid, hash_keys, hash_fields, &left_keys, &left_fields);
+    const list *keys_to_read = left_keys ? left_keys : hash_keys;
+    const list *fields_to_read = left_fields ? left_fields : hash_fields;
+    if (listLength(keys_to_read) > 0)
+    {
+        read_prefetch_total += listLength(keys_to_read);
+        go_on_need_rock_hashes_from_rocksdb(PREFETCH_CLIENT_ID, dbid, keys_to_read, fields_to_read);
+    }
+
+    if (left_keys)
     {
-        serverLog(LL_NOTICE, "rock read thread exit and join successfully.");
+        listRelease(left_keys);
+        listRelease(left_fields);
     }
 }
+
+/* Called in main thread for INFO to report the read statistics */
+sds cat_rock_read_info(sds info)
+{
+    size_t candidates = 0;
+    for (int i = 0; i < read_worker_num; ++i)
+    {
+        rockReadWorker *w = read_workers + i;
+        rock_r_lock(w);
+        candidates += dictSize(w->candidates);
+        rock_r_unlock(w);
+    }
+
+    info = sdscatprintf(info,
+                        "rock_read_threads:%d\r\n"
+                        "rock_read_batch_max:%d\r\n"
+                        "rock_read_candidates:%zu\r\n"
+                        "rock_read_batches:%lld\r\n"
+                        "rock_read_keys:%lld\r\n"
+                        "rock_read_prefetch_window:%d\r\n"
+                        "rock_read_prefetch_keys:%lld\r\n"
+                        "rock_read_hash_scans:%lld\r\n"
+                        "rock_read_batch_histogram:",
+                        read_worker_num,
+                        server.rock_read_batch_max,
+                        candidates,
+                        read_batch_total,
+                        read_key_total,
+                        server.rock_prefetch_window,
+                        read_prefetch_total,
+                        read_hash_scan_total);
+
+    for (int i = 0; i < READ_BATCH_HISTOGRAM_LEN; ++i)
+        info = sdscatprintf(info, "%sle_%d=%lld", i == 0 ? "" : ",", 
+                            1 << i, read_batch_histogram[i]);
+
+    info = sdscat(info, "\r\n");
+    return info;
+}
@@ -35,7 +35,11 @@
 #include "adlist.h"
 #include "server.h"
 
-// extern pthread_t rock_read_thread_id;
+/* The max number of read threads for config rock-read-threads */
+#define ROCK_READ_MAX_THREADS   16
+/* The max batch size of one read of RocksDB for config rock-read-batch-max */
+#define ROCK_READ_MAX_BATCH     128
+
 void join_read_thread();
 
 void init_and_start_rock_read_thread();
@@ -45,6 +49,11 @@ int on_client_need_rock_fields_for_hashes(client *c, const list *hash_keys, cons
 void on_client_need_rock_keys_for_db_in_sync_mode(client *c, const list *redis_keys);
 void on_client_need_rock_fields_for_hash_in_sync_mode(client *c, const list *hash_keys, const list *hash_fields);
 
+void begin_batch_of_rock_reads();
+void end_batch_of_rock_reads();
+void prefetch_rock_keys_for_db(const int dbid, const list *redis_keys);
+void prefetch_rock_fields_for_hashes(const int dbid, const list *hash_keys, const list *hash_fields);
+
 // int debug_check_no_candidates(const int len, const sds *rock_keys);
 
 /* for read_write.c */
@@ -54,4 +63,7 @@ int already_in_candidates_for_hash(const int dbid, const sds redis_key, const sd
 // for rock.c
 void rock_r_signal_cond();
 
+// for INFO in server.c
+sds cat_rock_read_info(sds info);
+
 #endif
@@ -0,0 +1,245 @@
+/* RedRock is based on Redis, coded by Tony. The copyright is same as Redis.
+ *
+ * Copyright (c) 2018, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Segmented value (opt-in by config rock-segment-entries) for big list, set and zset.
+ *
+ * Without it, a whole key is saved in RocksDB as one record (check rock_marshal.c),
+ * so a list, set (hash table) or zset (skiplist) with millions of elements 
+ * is one big record in RocksDB, which hurts RocksDB (e.g., compaction and block cache).
+ *
+ * With it, when write thread writes a marshal value with more than rock-segment-entries elements,
+ * 1. the elements are split to segments in order, 
+ *    i.e., quicklist entries for list, members for set, and score ordered members for zset,
+ *    each segment has rock-segment-entries elements (the last one could be less).
+ * 2. each segment is saved with a rock key of ROCK_KEY_FOR_SEGMENT, 
+ *    i.e., the prefix of dbid + redis key, then the segment index in big endian.
+ * 3. the rock key of db (ROCK_KEY_FOR_DB) saves a small segment head
+ *    with the number of segments and elements.
+ * All of them are in the same write batch, so they are atomic for readers.
+ *
+ * When reading the rock key of db, if the value is a segment head,
+ * all segments are read by one multi get and assembled to the same marshal value as before,
+ * so the rest (e.g., unmarshal_object() and the ring buffer) does not know about segments.
+ *
+ * When a segmented key is deleted, the tombstone for the prefix deletes all segments by range.
+ * Check on_db_del_or_overwrite_for_rock_tombstone() in rock_write.c.
+ *
+ * NOTE: It is only the layout in RocksDB. A command still needs the whole value in memory,
+ *       so the read of a segmented value costs more (the segments and the assembly) 
+ *       without any partial read. It is disabled by default (rock-segment-entries is 0).
+ */
+
+#include "rock_segment.h"
+#include "rock.h"
+#include "rock_marshal.h"
+
+/* Called in write thread (or main thread when loading RDB) for a put to RocksDB.
+ * If the val needs to be split (check split_marshal_to_segments()), 
+ * put the segments and the segment head to batch and return 1.
+ * Otherwise, return 0 and the caller needs to put the val as usual.
+ */
+int put_segments_to_write_batch(rocksdb_writebatch_t *batch, const sds rock_key, 
+                                const sds val, const size_t seg_entries)
+{
+    if (seg_entries == 0 || rock_key[0] != ROCK_KEY_FOR_DB)
+        return 0;
+
+    sds head;
+    const char **segs;
+    size_t *seg_lens;
+    const uint32_t nseg = split_marshal_to_segments(val, seg_entries, &head, &segs, &seg_lens);
+    if (nseg == 0)
+        return 0;
+
+    int dbid;
+    const char *redis_key;
+    size_t key_sz;
+    decode_rock_key_for_db(rock_key, &dbid, &redis_key, &key_sz);
+    sds prefix = encode_rock_key_prefix_for_segment(dbid, redis_key, key_sz);
+    const size_t prefix_len = sdslen(prefix);
+
+    sds seg_key = sdsMakeRoomFor(sdsdup(prefix), sizeof(uint32_t));
+    for (uint32_t i = 0; i < nseg; ++i)
+    {
+        sdssetlen(seg_key, prefix_len);
+        seg_key = encode_rock_key_for_segment(seg_key, i);
+        rocksdb_writebatch_put(batch, seg_key, sdslen(seg_key), segs[i], seg_lens[i]);
+    }
+
+    // the segments left by a previous bigger value of the same key
+    sdssetlen(seg_key, prefix_len);
+    seg_key = encode_rock_key_for_segment(seg_key, nseg);
+    sds end_key = encode_rock_key_for_segment(prefix, UINT32_MAX);
+    rocksdb_writebatch_delete_range(batch, seg_key, sdslen(seg_key), end_key, sdslen(end_key));
+
+    rocksdb_writebatch_put(batch, rock_key, sdslen(rock_key), head, sdslen(head));
+
+    sdsfree(seg_key);
+    sdsfree(end_key);
+    sdsfree(head);
+    zfree(segs);
+    zfree(seg_lens);
+    return 1;
+}
+
+/* Like put_segments_to_write_batch() but for the SST files when loading RDB (check rock_load.c).
+ * If the val needs to be split, return the number of segments, 
+ * with the segment head in *head and the rock keys and values of the segments 
+ * in *seg_keys and *seg_vals. The caller needs to free all of them.
+ * Otherwise, return 0.
+ *
+ * NOTE: SST file can not delete the segments left by a previous bigger value by range.
+ *       They are harmless because the segment head has the number of segments,
+ *       and they are deleted with the key by the tombstone of the prefix.
+ */
+uint32_t split_segments_for_load(const sds rock_key, const sds val, const size_t seg_entries, 
+                                 sds *head, sds **seg_keys, sds **seg_vals)
+{
+    if (seg_entries == 0 || rock_key[0] != ROCK_KEY_FOR_DB)
+        return 0;
+
+    const char **segs;
+    size_t *seg_lens;
+    const uint32_t nseg = split_marshal_to_segments(val, seg_entries, head, &segs, &seg_lens);
+    if (nseg == 0)
+        return 0;
+
+    int dbid;
+    const char *redis_key;
+    size_t key_sz;
+    decode_rock_key_for_db(rock_key, &dbid, &redis_key, &key_sz);
+    sds prefix = encode_rock_key_prefix_for_segment(dbid, redis_key, key_sz);
+
+    *seg_keys = zmalloc(sizeof(sds) * nseg);
+    *seg_vals = zmalloc(sizeof(sds) * nseg);
+    for (uint32_t i = 0; i < nseg; ++i)
+    {
+        (*seg_keys)[i] = encode_rock_key_for_segment(sdsdup(prefix), i);
+        (*seg_vals)[i] = sdsnewlen(segs[i], seg_lens[i]);
+    }
+
+    sdsfree(prefix);
+    zfree(segs);
+    zfree(seg_lens);
+    return nseg;
+}
+
+/* Called in write thread for the tombstone of the prefix (from encode_rock_key_prefix_for_segment()).
+ * Delete all segments of the key by range.
+ */
+void delete_segments_in_write_batch(rocksdb_writebatch_t *batch, const sds prefix)
+{
+    serverAssert(prefix[0] == ROCK_KEY_FOR_SEGMENT);
+
+    sds start_key = encode_rock_key_for_segment(sdsdup(prefix), 0);
+    sds end_key = encode_rock_key_for_segment(sdsdup(prefix), UINT32_MAX);
+    rocksdb_writebatch_delete_range(batch, start_key, sdslen(start_key), end_key, sdslen(end_key));
+    sdsfree(start_key);
+    sdsfree(end_key);
+}
+
+/* Called after reading the val of rock_key from RocksDB
+ * in read thread, main thread (sync mode) or the child process (with snapshot).
+ *
+ * If the val is not a segment head, return the val.
+ * Otherwise, read all segments and return the assembled marshal value, and the val is freed.
+ * If some segment is not found, return NULL like the val is not found.
+ * 
+ * NOTE: The head and the segments are read without the same snapshot, 
+ *       but the key is a rock value (in candidates of rock_read.c) which can not be evicted again
+ *       until it is recovered, so only a tombstone (e.g., DEL key) could change them in the meantime
+ *       and the caller deals with NULL as the key is deleted.
+ */
+sds assemble_if_segment_head(const sds rock_key, sds val, const rocksdb_snapshot_t *snapshot)
+{
+    if (val == NULL || rock_key[0] != ROCK_KEY_FOR_DB)
+        return val;
+
+    const uint32_t nseg = get_segment_num_of_head(val, sdslen(val));
+    if (nseg == 0)
+        return val;
+
+    int dbid;
+    const char *redis_key;
+    size_t key_sz;
+    decode_rock_key_for_db(rock_key, &dbid, &redis_key, &key_sz);
+    sds prefix = encode_rock_key_prefix_for_segment(dbid, redis_key, key_sz);
+    const size_t prefix_len = sdslen(prefix);
+
+    sds *seg_keys = zmalloc(sizeof(sds) * nseg);
+    size_t *seg_key_lens = zmalloc(sizeof(size_t) * nseg);
+    char **seg_vals = zmalloc(sizeof(char*) * nseg);
+    size_t *seg_val_lens = zmalloc(sizeof(size_t) * nseg);
+    char **errs = zmalloc(sizeof(char*) * nseg);
+    for (uint32_t i = 0; i < nseg; ++i)
+    {
+        seg_keys[i] = encode_rock_key_for_segment(sdsnewlen(prefix, prefix_len), i);
+        seg_key_lens[i] = sdslen(seg_keys[i]);
+        errs[i] = NULL;
+    }
+
+    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
+    if (snapshot)
+        rocksdb_readoptions_set_snapshot(readoptions, snapshot);
+    rocksdb_multi_get(rockdb, readoptions, nseg, 
+                      (const char* const *)seg_keys, seg_key_lens, 
+                      seg_vals, seg_val_lens, errs);
+    rocksdb_readoptions_destroy(readoptions);
+
+    int all_found = 1;
+    for (uint32_t i = 0; i < nseg; ++i)
+    {
+        if (errs[i])
+            serverPanic("assemble_if_segment_head() reading from RocksDB failed, err = %s", errs[i]);
+
+        if (seg_vals[i] == NULL)
+            all_found = 0;
+    }
+
+    sds assembled = NULL;
+    if (all_found)
+        assembled = assemble_marshal_from_segments(val, sdslen(val), nseg, seg_vals, seg_val_lens);
+
+    for (uint32_t i = 0; i < nseg; ++i)
+    {
+        sdsfree(seg_keys[i]);
+        if (seg_vals[i])
+            rocksdb_free(seg_vals[i]);
+    }
+    zfree(seg_keys);
+    zfree(seg_key_lens);
+    zfree(seg_vals);
+    zfree(seg_val_lens);
+    zfree(errs);
+    sdsfree(prefix);
+    sdsfree(val);
+
+    return assembled;
+}
@@ -0,0 +1,464 @@
+/* RedRock is based on Redis, coded by Tony. The copyright is same as Redis.
+ *
+ * Copyright (c) 2018, Salvatore Sanfilippo <antirez at gmail dot com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Warm restart (opt-in by config rock-warm-restart) keeps the RocksDB folder between restarts.
+ *
+ * When RedRock shuts down with a final RDB snapshot, 
+ * 1. a random token is saved in the RDB as an aux field, i.e., "rock-warm"
+ * 2. after the ring buffer is flushed to RocksDB (and memtable to SST because WAL is disabled), 
+ *    all rock keys (for whole keys and hash fields) are saved in a manifest file
+ *    with the same token. 
+ *    The manifest is beside the RocksDB folder, e.g., /opt/redrock/rocksdb6379.manifest
+ *
+ * When RedRock starts, if the manifest is valid, the RocksDB folder is not removed
+ * and the rock keys of the manifest are loaded as an index (read_warm_index).
+ * The manifest file is removed right after, so a crash later can not reuse it.
+ *
+ * When loading the RDB, if the token in RDB matches the one of the manifest, 
+ * every key (or hash field) in the index is added to Redis as rock value directly,
+ * i.e., no write to RocksDB again, because the same value is already in RocksDB.
+ * Check db_add_warm_rockval_when_load_rdb() in rock.c.
+ *
+ * NOTE: the RDB still has the whole values so it is still portable, 
+ *       e.g., for Redis or RedRock without the manifest.
+ *
+ * After loading, if the token does not match (e.g., RDB is from other server, or AOF is used) 
+ * or some keys of the index are not used (e.g., expired when loading), 
+ * the data in RocksDB is stale, so we start the purge job in background 
+ * to remove them (like the PURGEROCKSDB command).
+ */
+
+#include "rock_warm.h"
+#include "rock.h"
+#include "rock_write.h"
+#include "rock_purge.h"
+#include "crc64.h"
+
+#include <stdio.h>
+
+#define WARM_MANIFEST_MAGIC         "REDROCK-WARM"
+#define WARM_MANIFEST_MAGIC_LEN     12
+#define WARM_MANIFEST_VERSION       ROCK_KEY_FORMAT_VERSION     // the rock keys in RocksDB must be the same layout
+#define WARM_TOKEN_LEN              40
+#define WARM_RECORD_END             UINT32_MAX
+
+#define WARM_STATE_NONE             0   // no warm index or finished
+#define WARM_STATE_LOADED           1   // index loaded, waiting for RDB token
+#define WARM_STATE_ACCEPTED         2   // RDB token matched, keys can be taken from index
+
+static sds manifest_path = NULL;
+static int warm_state = WARM_STATE_NONE;
+static dict *warm_index = NULL;
+static char manifest_token[WARM_TOKEN_LEN+1];
+static char final_save_token[WARM_TOKEN_LEN+1];
+static int has_final_save_token = 0;
+
+static void warm_index_key_destructor(void *privdata, void *obj)
+{
+    UNUSED(privdata);
+    sdsfree(obj);
+}
+
+/* The index is a set of rock keys (for db key or hash field) */
+static dictType warmIndexDictType = 
+{
+    dictSdsHash,                    /* hash function */
+    NULL,                           /* key dup */
+    NULL,                           /* val dup */
+    dictSdsKeyCompare,              /* key compare */
+    warm_index_key_destructor,      /* key destructor */
+    NULL,                           /* val destructor */
+    NULL                            /* allow to expand */
+};
+
+/* rocksdb_folder_path is like /opt/redrock/rocksdb6379/ 
+ * and the manifest path is /opt/redrock/rocksdb6379.manifest
+ */
+static sds get_manifest_path(const sds rocksdb_folder_path)
+{
+    size_t len = sdslen(rocksdb_folder_path);
+    serverAssert(len > 1);
+    if (rocksdb_folder_path[len-1] == '/')
+        --len;
+
+    sds path = sdsnewlen(rocksdb_folder_path, len);
+    path = sdscat(path, ".manifest");
+    return path;
+}
+
+static int read_exact(FILE *fp, void *buf, const size_t len, uint64_t *crc)
+{
+    if (len == 0)
+        return 1;
+
+    if (fread(buf, len, 1, fp) != 1)
+        return 0;
+
+    *crc = crc64(*crc, buf, len);
+    return 1;
+}
+
+static int write_exact(FILE *fp, const void *buf, const size_t len, uint64_t *crc)
+{
+    if (len == 0)
+        return 1;
+
+    if (fwrite(buf, len, 1, fp) != 1)
+        return 0;
+
+    *crc = crc64(*crc, buf, len);
+    return 1;
+}
+
+/* Called in main thread by init_rocksdb() before RocksDB is opened.
+ *
+ * If warm restart is enabled and the manifest is valid, 
+ * load the rock keys to warm_index and return 1, 
+ * which means the caller should keep the RocksDB folder.
+ * Otherwise return 0 and the caller will remove the RocksDB folder as usual.
+ *
+ * The manifest file is always removed after the call.
+ */
+int load_warm_restart_manifest(const sds rocksdb_folder_path)
+{
+    serverAssert(manifest_path == NULL && warm_index == NULL);
+    manifest_path = get_manifest_path(rocksdb_folder_path);
+
+    if (!server.rock_warm_restart)
+    {
+        unlink(manifest_path);
+        return 0;
+    }
+
+    FILE *fp = fopen(manifest_path, "r");
+    if (fp == NULL)
+    {
+        serverLog(LL_NOTICE, "warm restart: no manifest %s, start with empty RocksDB.", manifest_path);
+        return 0;
+    }
+
+    uint64_t crc = 0;
+    char magic[WARM_MANIFEST_MAGIC_LEN];
+    uint8_t version;
+    uint32_t len;
+    uint64_t cnt = 0;
+    uint64_t expected_cnt;
+    uint64_t expected_crc;
+    sds rock_key = NULL;
+    warm_index = dictCreate(&warmIndexDictType, NULL);
+
+    if (!read_exact(fp, magic, WARM_MANIFEST_MAGIC_LEN, &crc) || 
+        memcmp(magic, WARM_MANIFEST_MAGIC, WARM_MANIFEST_MAGIC_LEN) != 0)
+        goto invalid;
+
+    if (!read_exact(fp, &version, 1, &crc))
+        goto invalid;
+
+    if (version != WARM_MANIFEST_VERSION)
+    {
+        serverLog(LL_WARNING, "warm restart: manifest version %d is not %d (the rock key format changed), "
+                              "all data will be loaded from RDB again.", 
+                  (int)version, WARM_MANIFEST_VERSION);
+        goto invalid;
+    }
+
+    if (!read_exact(fp, manifest_token, WARM_TOKEN_LEN, &crc))
+        goto invalid;
+    manifest_token[WARM_TOKEN_LEN] = '\0';
+
+    while (1)
+    {
+        if (!read_exact(fp, &len, sizeof(len), &crc))
+            goto invalid;
+
+        if (len == WARM_RECORD_END)
+            break;
+
+        if (len > server.proto_max_bulk_len * 2)
+            goto invalid;   // the max rock key is for a hash key and field
+
+        rock_key = sdsnewlen(SDS_NOINIT, len);
+        if (!read_exact(fp, rock_key, len, &crc))
+            goto invalid;
+        if (len == 0 || (rock_key[0] != ROCK_KEY_FOR_DB && rock_key[0] != ROCK_KEY_FOR_HASH))
+            goto invalid;
+
+        if (dictAdd(warm_index, rock_key, NULL) != DICT_OK)
+            goto invalid;
+        rock_key = NULL;     // ownership transfered to warm_index
+        ++cnt;
+    }
+
+    if (!read_exact(fp, &expected_cnt, sizeof(expected_cnt), &crc) || expected_cnt != cnt)
+        goto invalid;
+
+    // the crc itself is not in the check sum
+    if (fread(&expected_crc, sizeof(expected_crc), 1, fp) != 1 || expected_crc != crc)
+        goto invalid;
+
+    fclose(fp);
+    unlink(manifest_path);
+    warm_state = WARM_STATE_LOADED;
+    serverLog(LL_NOTICE, "warm restart: manifest %s loaded with %llu rock keys, keep the RocksDB folder.", 
+              manifest_path, (unsigned long long)cnt);
+    return 1;
+
+invalid:
+    if (rock_key)
+        sdsfree(rock_key);
+    fclose(fp);
+    unlink(manifest_path);
+    dictRelease(warm_index);
+    warm_index = NULL;
+    serverLog(LL_WARNING, "warm restart: manifest %s is invalid, start with empty RocksDB.", manifest_path);
+    return 0;
+}
+
+/* Called in main thread by rdbLoadRio() for the aux field "rock-warm".
+ * Only the RDB file (not the preamble of AOF) can be accepted,
+ * because the commands in the tail of AOF may change the values.
+ */
+void on_rdb_aux_for_warm_restart(const sds token, const int rdbflags)
+{
+    if (warm_state != WARM_STATE_LOADED)
+        return;
+
+    if (rdbflags & RDBFLAGS_AOF_PREAMBLE)
+        return;
+
+    if (sdslen(token) == WARM_TOKEN_LEN && memcmp(token, manifest_token, WARM_TOKEN_LEN) == 0)
+    {
+        warm_state = WARM_STATE_ACCEPTED;
+        serverLog(LL_NOTICE, "warm restart: RDB matches the manifest, reuse the data in RocksDB.");
+    }
+}
+
+/* Called in main thread when loading RDB.
+ * Return 1 if the rock keys of the warm index can be taken.
+ */
+int is_warm_restart_loading()
+{
+    return warm_state == WARM_STATE_ACCEPTED;
+}
+
+/* Called in main thread when loading RDB.
+ * If rock_key is in the warm index, remove it from the index and return 1.
+ * Otherwise, return 0.
+ */
+int take_from_warm_restart_index(const sds rock_key)
+{
+    serverAssert(warm_state == WARM_STATE_ACCEPTED);
+    return dictDelete(warm_index, rock_key) == DICT_OK;
+}
+
+/* Called in main thread after RDB/AOF is loaded (or not exist) and before enter event loop */
+void finish_warm_restart_after_load()
+{
+    if (warm_state == WARM_STATE_NONE)
+        return;
+
+    const size_t left = dictSize(warm_index);
+    int need_purge = 0;
+    if (warm_state == WARM_STATE_LOADED)
+    {
+        serverLog(LL_WARNING, "warm restart: no RDB matches the manifest, the data in RocksDB is stale.");
+        need_purge = 1;
+    }
+    else if (left != 0)
+    {
+        serverLog(LL_NOTICE, "warm restart: %zu rock keys of the manifest are not used.", left);
+        need_purge = 1;
+    }
+
+    dictRelease(warm_index);
+    warm_index = NULL;
+    warm_state = WARM_STATE_NONE;
+
+    if (need_purge)
+    {
+        serverLog(LL_NOTICE, "warm restart: start RocksDB purge job in background for the stale data.");
+        start_rocksdb_purge_in_background();
+    }
+}
+
+/* Called in main thread by prepareForShutdown() before the final RDB snapshot.
+ * The token will be saved in the RDB as aux field. Check rdbSaveInfoAuxFields().
+ */
+void set_warm_restart_token_before_final_save()
+{
+    if (!server.rock_warm_restart)
+        return;
+
+    getRandomHexChars(final_save_token, WARM_TOKEN_LEN);
+    final_save_token[WARM_TOKEN_LEN] = '\0';
+    has_final_save_token = 1;
+}
+
+/* Called in main thread if the final RDB snapshot fails */
+void reset_warm_restart_token()
+{
+    has_final_save_token = 0;
+}
+
+/* Return NULL if no final save for warm restart */
+const char* get_warm_restart_token()
+{
+    return has_final_save_token ? final_save_token : NULL;
+}
+
+static int write_one_record(FILE *fp, const sds rock_key, uint64_t *crc)
+{
+    const uint32_t len = sdslen(rock_key);
+    return write_exact(fp, &len, sizeof(len), crc) && write_exact(fp, rock_key, len, crc);
+}
+
+/* Write all rock keys of one db to the manifest.
+ * Return the number of the records, or -1 for error.
+ */
+static long long write_records_of_db(FILE *fp, const int dbid, uint64_t *crc)
+{
+    redisDb *db = server.db + dbid;
+    long long cnt = 0;
+
+    dictIterator *di = dictGetIterator(db->dict);
+    dictEntry *de;
+    while ((de = dictNext(di)))
+    {
+        const sds key = dictGetKey(de);
+        const robj *o = dictGetVal(de);
+        if (!is_rock_value(o))
+            continue;
+
+        sds rock_key = encode_rock_key_for_db(dbid, sdsdup(key));
+        const int ok = write_one_record(fp, rock_key, crc);
+        sdsfree(rock_key);
+        if (!ok)
+        {
+            dictReleaseIterator(di);
+            return -1;
+        }
+        ++cnt;
+    }
+    dictReleaseIterator(di);
+
+    // hash fields are only for the hashes in rock_hash
+    di = dictGetIterator(db->rock_hash);
+    while ((de = dictNext(di)))
+    {
+        const sds key = dictGetKey(de);
+        dictEntry *de_db = dictFind(db->dict, key);
+        serverAssert(de_db);
+        const robj *o = dictGetVal(de_db);
+        serverAssert(o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT);
+
+        dictIterator *di_hash = dictGetIterator((dict*)o->ptr);
+        dictEntry *de_hash;
+        while ((de_hash = dictNext(di_hash)))
+        {
+            if (dictGetVal(de_hash) != shared.hash_rock_val_for_field)
+                continue;
+
+            sds rock_key = encode_rock_key_for_hash(dbid, sdsdup(key), dictGetKey(de_hash));
+            const int ok = write_one_record(fp, rock_key, crc);
+            sdsfree(rock_key);
+            if (!ok)
+            {
+                dictReleaseIterator(di_hash);
+                dictReleaseIterator(di);
+                return -1;
+            }
+            ++cnt;
+        }
+        dictReleaseIterator(di_hash);
+    }
+    dictReleaseIterator(di);
+
+    return cnt;
+}
+
+/* Called in main thread by wait_rock_threads_exit() after all rock threads exit.
+ * If the final RDB snapshot has the token, flush all data to RocksDB
+ * and write the manifest (to a temp file first and then rename).
+ */
+void save_warm_restart_manifest_before_exit()
+{
+    if (!has_final_save_token || rockdb == NULL)
+        return;
+
+    // the data in ring buffer and memtable must be in SST files before the manifest
+    if (!flush_all_to_rocksdb_before_exit())
+        return;
+
+    sds tmp_path = sdscatfmt(sdsempty(), "%S.tmp-%i", manifest_path, (int)getpid());
+    FILE *fp = fopen(tmp_path, "w");
+    if (fp == NULL)
+    {
+        serverLog(LL_WARNING, "warm restart: can not create manifest %s, err = %s", tmp_path, strerror(errno));
+        sdsfree(tmp_path);
+        return;
+    }
+
+    uint64_t crc = 0;
+    const uint8_t version = WARM_MANIFEST_VERSION;
+    const uint32_t end = WARM_RECORD_END;
+    uint64_t total = 0;
+    int ok = write_exact(fp, WARM_MANIFEST_MAGIC, WARM_MANIFEST_MAGIC_LEN, &crc) &&
+             write_exact(fp, &version, 1, &crc) &&
+             write_exact(fp, final_save_token, WARM_TOKEN_LEN, &crc);
+
+    for (int i = 0; ok && i < server.dbnum; ++i)
+    {
+        const long long cnt = write_records_of_db(fp, i, &crc);
+        if (cnt < 0)
+            ok = 0;
+        else
+            total += cnt;
+    }
+
+    ok = ok && write_exact(fp, &end, sizeof(end), &crc) && 
+               write_exact(fp, &total, sizeof(total), &crc) &&
+               fwrite(&crc, sizeof(crc), 1, fp) == 1;
+
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    if (fclose(fp) != 0)
+        ok = 0;
+
+    if (ok && rename(tmp_path, manifest_path) == 0)
+    {
+        serverLog(LL_NOTICE, "warm restart: manifest %s saved with %llu rock keys.", 
+                  manifest_path, (unsigned long long)total);
+    }
+    else
+    {
+        serverLog(LL_WARNING, "warm restart: save manifest %s failed, err = %s", manifest_path, strerror(errno));
+        unlink(tmp_path);
+    }
+    sdsfree(tmp_path);
+}
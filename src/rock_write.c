@@ -35,6 +35,8 @@
 #include "rock_hash.h"
 #include "rock_evict.h"
 #include "rock_purge.h"
+#include "rock_segment.h"
+#include "rock_cache.h"
 
 /* We use mutex to replace spinlock because spinlock could switch out 
  * by OS scheuler while holding lock and the other threads may be busy spiinlocking.
@@ -47,6 +49,8 @@ static pthread_mutex_t mutex_write;
 static pthread_mutex_t mutex_write = PTHREAD_MUTEX_INITIALIZER;     
 #endif
 static pthread_cond_t cv;
+static pthread_cond_t cv_marshal;      // for main thread to wait for the marshal in write thread
+static pthread_cond_t cv_written;      // for main thread to wait for the slots written by write thread
 
 inline static void rock_w_lock() 
 {
@@ -73,14 +77,65 @@ static pthread_t rock_write_thread_id;
 /* -------------------------------------------
  * Ring Buffer as a write queue to RocksDB
  * -------------------------------------------
+ * It is a lock-free queue for single producer (main thread) and single consumer (write thread).
+ *
+ * rbuf_head and rbuf_tail are sequences (not index) which only increase,
+ * the index of the slot is SLOT_OF_SEQ(seq).
+ * Main thread appends to the tail and is the only one to change rbuf_tail.
+ * Write thread writes [rbuf_head, rbuf_tail) to RocksDB and is the only one to change rbuf_head.
+ *
+ * The slots in [rbuf_head, rbuf_tail) are immutable (except the val of handover, see below).
+ * And the resource of the slot is released only by main thread 
+ * after the slot is written to RocksDB, i.e., before rbuf_head 
+ * (check reclaim_written_slots_of_ring_buf()).
+ * So main thread can read the slots in [rbuf_head, rbuf_tail) without lock.
+ *
+ * The capacity is limited by bytes (rock-write-ring-buffer-size) and by slots (RING_BUFFER_SLOTS).
+ *
+ * NOTE: mutex_write is only for the sleep and wakeup of write thread, the purge job 
+ *       and the handover of robj (check rock-marshal-in-write-thread).
  */
-
-static sds rbuf_keys[RING_BUFFER_LEN];
-static sds rbuf_vals[RING_BUFFER_LEN];
-// static int rbuf_invalids[RING_BUFFER_LEN];      // indicating whether the db is just emptied
-static int rbuf_s_index;     // start index in queue (include if rbuf_len != 0)
-static int rbuf_e_index;     // end index in queue (exclude if rbuf_len != 0)
-static int rbuf_len;         // used(available) length
+#define SLOT_OF_SEQ(seq)    ((int)((seq) & (RING_BUFFER_SLOTS - 1)))
+#define EVICT_MAX_BATCH_LEN 16      // max keys (or fields) for one call of eviction
+
+static sds rbuf_keys[RING_BUFFER_SLOTS];
+static sds rbuf_vals[RING_BUFFER_SLOTS];
+static size_t rbuf_bytes[RING_BUFFER_SLOTS];            // bytes of the slot for the capacity
+static monotime rbuf_enqueue_us[RING_BUFFER_SLOTS];     // for latency from enqueue to RocksDB
+static redisAtomic unsigned long long rbuf_head;
+static redisAtomic unsigned long long rbuf_tail;
+static redisAtomic size_t rbuf_inflight_bytes;
+static unsigned long long rbuf_reclaim;     // only for main thread. The slots before it have been released
+
+/* The side index for the lookup in ring buffer. It is only used by main thread.
+ * The key is the rock key (owned by the slot), the val is the seq of the newest slot for the key.
+ */
+static dict *rbuf_index;
+
+/* When rock-marshal-in-write-thread is enabled, the main thread only detaches the robj 
+ * from db and hands it over to the write thread with rbuf_vals[i] being NULL.
+ * The write thread marshals the robj, sets rbuf_vals[i] and releases the robj.
+ * rbuf_obj_mems[i] is the estimated memory of the robj (from main thread)
+ * and rbuf_pending_free_mem is the sum of them which is not freed yet.
+ * rbuf_handovers[i] is only for main thread to know whether it needs to wait.
+ */
+static int rbuf_handovers[RING_BUFFER_SLOTS];
+static robj* rbuf_objs[RING_BUFFER_SLOTS];          // guarded by mutex_write
+static size_t rbuf_obj_mems[RING_BUFFER_SLOTS];
+static redisAtomic size_t rbuf_pending_free_mem;
+
+static redisAtomic int write_thread_sleeping;
+
+/* Statistics for INFO, check cat_rock_write_info() */
+static long long stat_ring_full_stalls;         // only for main thread
+static long long stat_tombstone_stalls;         // only for main thread, tombstones waiting for full ring buffer
+static long long stat_clean_evictions;          // only for main thread, evictions without write
+static redisAtomic long long stat_written_tombstones;
+static redisAtomic long long stat_written_keys;
+static redisAtomic long long stat_written_bytes;
+static redisAtomic long long stat_written_batches;
+static redisAtomic long long stat_latency_total_us;
+static redisAtomic long long stat_latency_max_us;
 
 /* ------------------------------------------
  * Purge job waiting for write thread to write del to RocksDB
@@ -94,19 +149,36 @@ static int del_hash_dbids[ROCKSDB_PURGE_MAX_LEN];
 static sds del_hash_keys[ROCKSDB_PURGE_MAX_LEN];
 static sds del_hash_fields[ROCKSDB_PURGE_MAX_LEN];
 
-/* Called by Main thread to init the ring buffer */
+/* Called by Main thread to init the ring buffer before write thread starts */
 static void init_write_ring_buffer() 
 {
-    rock_w_lock();
-    for (int i = 0; i < RING_BUFFER_LEN; ++i) 
+    for (int i = 0; i < RING_BUFFER_SLOTS; ++i) 
     {
         rbuf_keys[i] = NULL;
         rbuf_vals[i] = NULL;
-        // rbuf_invalids[i] = 0;
+        rbuf_bytes[i] = 0;
+        rbuf_enqueue_us[i] = 0;
+        rbuf_handovers[i] = 0;
+        rbuf_objs[i] = NULL;
+        rbuf_obj_mems[i] = 0;
     }
-    rbuf_s_index = rbuf_e_index = 0;
-    rbuf_len = 0;
-    rock_w_unlock();
+    atomicSetWithSync(rbuf_head, 0);
+    atomicSetWithSync(rbuf_tail, 0);
+    atomicSet(rbuf_inflight_bytes, 0);
+    atomicSet(rbuf_pending_free_mem, 0);
+    atomicSet(write_thread_sleeping, 0);
+    rbuf_reclaim = 0;
+    rbuf_index = dictCreate(&sdsReplyDictType, NULL);
+
+    stat_ring_full_stalls = 0;
+    stat_tombstone_stalls = 0;
+    stat_clean_evictions = 0;
+    atomicSet(stat_written_tombstones, 0);
+    atomicSet(stat_written_keys, 0);
+    atomicSet(stat_written_bytes, 0);
+    atomicSet(stat_written_batches, 0);
+    atomicSet(stat_latency_total_us, 0);
+    atomicSet(stat_latency_max_us, 0);
 }
 
 static void init_write_purge_data()
@@ -117,52 +189,213 @@ static void init_write_purge_data()
     rock_w_unlock();
 }
 
-/* Called by Main thread in lock mode from caller.
- * keys and vals will be ownered by ring buffer 
+/* Called in main thread.
+ * Release the resource of the slots which have been written to RocksDB by write thread 
+ * and remove them from the side index if they are the newest for the key.
+ * The value of the newest slot is handed over to the compressed cache (check rock_cache.c).
+ */
+static void reclaim_written_slots_of_ring_buf()
+{
+    unsigned long long head;
+    atomicGetWithSync(rbuf_head, head);
+
+    while (rbuf_reclaim < head)
+    {
+        const int slot = SLOT_OF_SEQ(rbuf_reclaim);
+        const sds key = rbuf_keys[slot];
+        serverAssert(key);
+
+        dictEntry *de = dictFind(rbuf_index, key);
+        const int newest = de && dictGetUnsignedIntegerVal(de) == rbuf_reclaim;
+        if (newest)
+            serverAssert(dictDelete(rbuf_index, key) == DICT_OK);
+
+        // the value is in RocksDB now, keep it in the compressed cache, check rock_cache.c
+        sds val = rbuf_vals[slot];
+        if (key[0] == ROCK_KEY_FOR_DB_RANGE)
+        {
+            clear_rock_cache();
+        }
+        else if (newest && val)
+        {
+            put_to_rock_cache(key, val);
+            val = NULL;     // owned by the cache
+        }
+        else
+        {
+            del_from_rock_cache(key);
+        }
+
+        sdsfree(key);
+        sdsfree(val);
+        rbuf_keys[slot] = NULL;
+        rbuf_vals[slot] = NULL;
+        rbuf_handovers[slot] = 0;
+
+        ++rbuf_reclaim;
+    }
+}
+
+/* Called in main thread. 
+ * If write thread is sleeping (or is going to sleep), wake it up.
+ * Check rock_write_main() for why no lost wakeup.
+ */
+static void wakeup_write_thread_if_sleeping()
+{
+    int sleeping;
+    atomicGetWithSync(write_thread_sleeping, sleeping);
+    if (sleeping)
+        try_to_wakeup_write_thread();
+}
+
+/* Called in main thread.
+ * Block until the write thread has written the slots before seq to RocksDB, 
+ * then reclaim them. 
+ * The write thread broadcasts cv_written in lock mode after it moves rbuf_head,
+ * so checking rbuf_head in lock mode has no lost wakeup.
+ */
+static void wait_write_thread_until_seq(const unsigned long long seq)
+{
+    unsigned long long head;
+    atomicGetWithSync(rbuf_head, head);
+    if (head < seq)
+    {
+        rock_w_lock();
+        rock_w_signal_cond();       // in case the write thread is sleeping
+        while (1)
+        {
+            atomicGetWithSync(rbuf_head, head);
+            if (head >= seq)
+                break;
+            serverAssert(pthread_cond_wait(&cv_written, &mutex_write) == 0);
+        }
+        rock_w_unlock();
+    }
+
+    reclaim_written_slots_of_ring_buf();
+}
+
+/* Called in main thread.
+ * Block until there are at least len free slots in ring buffer.
+ */
+static void wait_for_free_slots_of_ring_buf(const int len)
+{
+    serverAssert(len > 0 && len <= RING_BUFFER_SLOTS);
+
+    unsigned long long tail;
+    atomicGet(rbuf_tail, tail);
+    if (tail + len > RING_BUFFER_SLOTS)
+        wait_write_thread_until_seq(tail + len - RING_BUFFER_SLOTS);
+}
+
+/* Called in main thread.
+ * Block until everything queued in ring buffer so far (including tombstones) 
+ * has been written to RocksDB. 
+ * It is for the caller who writes to RocksDB directly (not through ring buffer)
+ * and must be ordered after the queued writes, e.g., loading RDB with duplicated keys.
+ */
+void wait_rock_write_ring_buf_drained()
+{
+    unsigned long long tail;
+    atomicGet(rbuf_tail, tail);
+    wait_write_thread_until_seq(tail);
+}
+
+/* Called by Main thread.
+ * keys and vals (and objs if not NULL) will be ownered by ring buffer 
  * so the caller can not use them anymore.
- * We free memory only when overwrite old and abandoned key/value
+ * We free memory in reclaim_written_slots_of_ring_buf() after the slots are written.
+ * 
+ * If objs is not NULL and objs[i] is not NULL, vals[i] must be NULL,
+ * it means the write thread will marshal objs[i] to the val. 
+ * objs_mem[i] is the estimated memory of objs[i].
+ *
+ * If vals[i] is NULL and no objs[i], it is a tombstone, i.e., delete the key in RocksDB.
+ *
+ * NOTE: The caller guarantees the space by space_in_write_ring_buffer().
  */
-static void batch_append_to_ringbuf(const int len, sds* keys, sds* vals) 
+static void batch_append_to_ringbuf(const int len, sds* keys, sds* vals, robj **objs, const size_t *objs_mem) 
 {
+    reclaim_written_slots_of_ring_buf();
+
+    unsigned long long tail;
+    atomicGet(rbuf_tail, tail);
+    const monotime now = getMonotonicUs();
+    size_t bytes = 0;
+    size_t handover_mem = 0;
+    int has_handover = 0;
+
     for (int i = 0; i < len; ++i) 
     {
         const sds key = keys[i];
         const sds val = vals[i];
-        serverAssert(key && val);
-
-        if (rbuf_keys[rbuf_e_index]) 
+        robj *obj = objs ? objs[i] : NULL;
+        serverAssert(key && !(val != NULL && obj != NULL));
+
+        const int slot = SLOT_OF_SEQ(tail + i);
+        serverAssert(rbuf_keys[slot] == NULL);     // reclaimed
+
+        rbuf_keys[slot] = key;
+        rbuf_vals[slot] = val;
+        rbuf_handovers[slot] = obj != NULL;
+        rbuf_obj_mems[slot] = obj ? objs_mem[i] : 0;
+        rbuf_bytes[slot] = sdslen(key) + (obj ? objs_mem[i] : (val ? sdslen(val) : 0));
+        rbuf_enqueue_us[slot] = now;
+        bytes += rbuf_bytes[slot];
+        if (obj)
         {
-            // for the old and abandoned one, we releasse them
-            sdsfree(rbuf_keys[rbuf_e_index]);
-            serverAssert(rbuf_vals[rbuf_e_index]);
-            sdsfree(rbuf_vals[rbuf_e_index]);
+            handover_mem += objs_mem[i];
+            has_handover = 1;
         }
 
-        rbuf_keys[rbuf_e_index] = key;
-        rbuf_vals[rbuf_e_index] = val;
-        // rbuf_invalids[rbuf_e_index] = 0;        // must set 0 to overwirte possible 1 for the previous used index
+        // the newest slot wins in the side index
+        dictEntry *existing;
+        dictEntry *de = dictAddRaw(rbuf_index, key, &existing);
+        if (de == NULL)
+        {
+            de = existing;
+            de->key = key;      // the old key is owned by the old slot which will be reclaimed
+        }
+        dictSetUnsignedIntegerVal(de, tail + i);
+    }
 
-        ++rbuf_e_index;
-        if (rbuf_e_index == RING_BUFFER_LEN) 
-            rbuf_e_index = 0;
+    if (has_handover)
+    {
+        rock_w_lock();
+        for (int i = 0; i < len; ++i)
+        {
+            if (objs[i])
+                rbuf_objs[SLOT_OF_SEQ(tail + i)] = objs[i];
+        }
+        rock_w_unlock();
+        atomicIncr(rbuf_pending_free_mem, handover_mem);
     }
-    rbuf_len += len;
+
+    atomicIncr(rbuf_inflight_bytes, bytes);
+    atomicSetWithSync(rbuf_tail, tail + len);      // publish to write thread
+
+    wakeup_write_thread_if_sleeping();
 }
 
 /* Called by Main thread in cron to determine how much space (key number) 
  * left in ring buffer for evicting to RocksDB.
- *
- * NOTE: We need to use lock to guarantee the data race 
- *       (Write thread maybe decrease rbuf_len)
+ * If the bytes in flight reach rock-write-ring-buffer-size, there is no space.
  */
 static int space_in_write_ring_buffer()
 {
-    rock_w_lock();
-    const int space = RING_BUFFER_LEN - rbuf_len;
-    rock_w_unlock();
+    reclaim_written_slots_of_ring_buf();
 
-    serverAssert(space >= 0 && space <= RING_BUFFER_LEN);
-    return space;
+    unsigned long long head, tail;
+    atomicGetWithSync(rbuf_head, head);
+    atomicGet(rbuf_tail, tail);
+    serverAssert(tail >= head && tail - head <= RING_BUFFER_SLOTS);
+
+    size_t inflight;
+    atomicGet(rbuf_inflight_bytes, inflight);
+    if (inflight >= server.rock_write_ring_buffer_size)
+        return 0;
+
+    return RING_BUFFER_SLOTS - (int)(tail - head);
 }
 
 /* Called by main thread to check whether there are no job of eviction
@@ -172,7 +405,49 @@ static int space_in_write_ring_buffer()
  */
 int is_eviction_ring_buffer_empty()
 {
-    return space_in_write_ring_buffer() == RING_BUFFER_LEN;
+    reclaim_written_slots_of_ring_buf();
+
+    unsigned long long head, tail;
+    atomicGetWithSync(rbuf_head, head);
+    atomicGet(rbuf_tail, tail);
+    return head == tail;
+}
+
+/* Called by main thread for eviction to reconcile the freed memory.
+ * Return the estimated memory of the evicted objects which are handed over 
+ * to the write thread but not freed yet. 
+ * The caller can treat it as freed memory because it will be freed soon.
+ */
+size_t get_evicted_mem_not_freed_by_write_thread()
+{
+    size_t mem;
+    atomicGet(rbuf_pending_free_mem, mem);
+    return mem;
+}
+
+/* Called by main thread to get the duplicated val of the slot in [rbuf_head, rbuf_tail).
+ * If the robj of the slot has not been marshalled by the write thread, 
+ * we need to wait for it because the robj can not be marshalled 
+ * in two threads at the same time (e.g., quicklist iterator will decompress the node).
+ * NOTE: The wait is short because the write thread marshals them first 
+ *       before writing to RocksDB. 
+ */
+static sds dup_val_of_slot(const int slot)
+{
+    if (!rbuf_handovers[slot])
+    {
+        // NOTE: A rock value can not have a tombstone as the newest in ring buffer,
+        //       because tombstone is only for the value which is not rock value anymore
+        serverAssert(rbuf_vals[slot]);
+        return sdsdup(rbuf_vals[slot]);
+    }
+
+    rock_w_lock();
+    while (rbuf_objs[slot])
+        serverAssert(pthread_cond_wait(&cv_marshal, &mutex_write) == 0);
+    sds val = sdsdup(rbuf_vals[slot]);
+    rock_w_unlock();
+    return val;
 }
 
 /* Called in Main thread in cron (not directly).
@@ -195,28 +470,41 @@ int is_eviction_ring_buffer_empty()
  *           1. duplicate the keys from the source of keys in Redis db
  *           2. not use keys anymore
  *           3. not use objs anymore
+ * 
+ * NOTE4: If rock-marshal-in-write-thread is enabled, the objs are not marshalled here
+ *        but handed over to the write thread which marshals and releases them.
+ *        Check marshal_handovers_in_ring_buf().
+ *        objs_mem is the estimated memory of objs for the reconciliation.
  */
-static void write_batch_for_db_and_abandon(const int len, const int *dbids, sds *keys, robj **objs)
+static void write_batch_for_db_and_abandon(const int len, const int *dbids, sds *keys, robj **objs, const size_t *objs_mem)
 {
-    sds vals[RING_BUFFER_LEN];
+    sds vals[EVICT_MAX_BATCH_LEN];
+    robj *handovers[EVICT_MAX_BATCH_LEN];
+    const int marshal_in_write_thread = server.rock_marshal_in_write_thread;
     for (int i = 0; i < len; ++i)
     {
         sds rock_key = encode_rock_key_for_db(dbids[i], keys[i]);
         keys[i] = rock_key;
-        sds val = marshal_object(objs[i]);
-        vals[i] = val;
+        // only the robj owned by db alone can be handed over to write thread
+        if (marshal_in_write_thread && objs[i]->refcount == 1)
+        {
+            vals[i] = NULL;
+            handovers[i] = objs[i];
+        }
+        else
+        {
+            vals[i] = marshal_object(objs[i]);
+            handovers[i] = NULL;
+        }
     }
 
-    rock_w_lock();
-    serverAssert(rbuf_len + len <= RING_BUFFER_LEN);
-    batch_append_to_ringbuf(len, keys, vals);
-    rock_w_signal_cond();
-    rock_w_unlock();
+    batch_append_to_ringbuf(len, keys, vals, handovers, objs_mem);
 
-    // release objs
+    // release objs which are not handed over to write thread
     for (int i = 0; i < len; ++i)
     {
-        decrRefCount(objs[i]);
+        if (handovers[i] == NULL)
+            decrRefCount(objs[i]);
     }
 }
 
@@ -234,11 +522,7 @@ static void write_batch_for_hash_and_abandon(const int len, const int *dbids, sd
         keys[i] = rock_key;
     }
 
-    rock_w_lock();
-    serverAssert(rbuf_len + len <= RING_BUFFER_LEN);
-    batch_append_to_ringbuf(len, keys, vals);
-    rock_w_signal_cond();
-    rock_w_unlock();
+    batch_append_to_ringbuf(len, keys, vals, NULL, NULL);
 
     // release fields
     for (int i = 0; i < len; ++i)
@@ -282,15 +566,16 @@ static int try_evict_to_rocksdb_for_db(const int try_len, const int *try_dbids,
 {
     size_t objectComputeSize(robj *o, size_t sample_size);  // declaration in object.c
 
-    serverAssert(try_len > 0);
+    serverAssert(try_len > 0 && try_len <= EVICT_MAX_BATCH_LEN);
 
     if (mem)
         *mem = 0;
 
     int evict_len = 0;
-    int evict_dbids[RING_BUFFER_LEN];
-    sds evict_keys[RING_BUFFER_LEN];
-    robj* evict_vals[RING_BUFFER_LEN];    
+    int evict_dbids[EVICT_MAX_BATCH_LEN];
+    sds evict_keys[EVICT_MAX_BATCH_LEN];
+    robj* evict_vals[EVICT_MAX_BATCH_LEN];    
+    size_t evict_mems[EVICT_MAX_BATCH_LEN];
     for (int i = 0; i < try_len; ++i)
     {
         const int dbid = try_dbids[i];
@@ -318,22 +603,23 @@ static int try_evict_to_rocksdb_for_db(const int try_len, const int *try_dbids,
         {
             // the first one wins the setting rock value
             dictGetVal(de_db) = get_match_rock_value(v);
-            on_rockval_key_for_rock_evict(dbid, dictGetKey(de_db));
+            on_rockval_key_for_rock_evict(dbid, dictGetKey(de_db), v);
 
             evict_dbids[evict_len] = dbid;
             // NOTE: we must duplicate tyr_key for write_batch_append_and_abandon()
             evict_keys[evict_len] = sdsdup(try_key);
             evict_vals[evict_len] = v;
+            evict_mems[evict_len] = objectComputeSize(v, OBJ_SIZE_SAMPLE_NUMBER);
 
-            ++evict_len;
             if (mem)
-                *mem += objectComputeSize(v, OBJ_SIZE_SAMPLE_NUMBER);
+                *mem += evict_mems[evict_len];
+            ++evict_len;
         }
     }
 
     serverAssert(evict_len > 0);
 
-    write_batch_for_db_and_abandon(evict_len, evict_dbids, evict_keys, evict_vals);
+    write_batch_for_db_and_abandon(evict_len, evict_dbids, evict_keys, evict_vals, evict_mems);
 
     return evict_len;    
 }
@@ -368,16 +654,16 @@ static int try_evict_to_rocksdb_for_hash(const int try_len, const int *try_dbids
                                          const sds *try_keys, const sds *try_fields,
                                          size_t *mem)
 {
-    serverAssert(try_len > 0);
+    serverAssert(try_len > 0 && try_len <= EVICT_MAX_BATCH_LEN);
 
     if (mem)
         *mem = 0;
 
     int evict_len = 0;
-    int evict_dbids[RING_BUFFER_LEN];
-    sds evict_keys[RING_BUFFER_LEN];
-    sds evict_fields[RING_BUFFER_LEN];
-    sds evict_vals[RING_BUFFER_LEN];
+    int evict_dbids[EVICT_MAX_BATCH_LEN];
+    sds evict_keys[EVICT_MAX_BATCH_LEN];
+    sds evict_fields[EVICT_MAX_BATCH_LEN];
+    sds evict_vals[EVICT_MAX_BATCH_LEN];
     for (int i = 0; i < try_len; ++i)
     {
         const int dbid = try_dbids[i];
@@ -431,6 +717,56 @@ static int try_evict_to_rocksdb_for_hash(const int try_len, const int *try_dbids
     return evict_len;
 }
 
+/* Called in main thread for a clean key, check is_clean_key_for_rock_evict().
+ * The record in RocksDB (or ring buffer) is the same as the value,
+ * so we only set the rock value and release the value without marshal and write.
+ */
+static void evict_clean_key_without_write(const int dbid, const sds key, size_t *mem)
+{
+    size_t objectComputeSize(robj *o, size_t sample_size);  // declaration in object.c
+
+    redisDb *db = server.db + dbid;
+    dictEntry *de_db = dictFind(db->dict, key);
+    serverAssert(de_db);
+
+    robj *v = dictGetVal(de_db);
+    serverAssert(!is_rock_value(v));
+    dictGetVal(de_db) = get_match_rock_value(v);
+    on_rockval_key_for_rock_evict(dbid, dictGetKey(de_db), v);
+
+    if (mem)
+        *mem = objectComputeSize(v, OBJ_SIZE_SAMPLE_NUMBER);
+    
+    // a big value is released by the lazyfree thread like the write thread does
+    freeObjAsync(NULL, v);
+    ++stat_clean_evictions;
+}
+
+/* Called in main thread for a clean field, check is_clean_field_of_rock_hash().
+ * Reference evict_clean_key_without_write().
+ */
+static void evict_clean_field_without_write(const int dbid, const sds key, const sds field, size_t *mem)
+{
+    redisDb *db = server.db + dbid;
+    dictEntry *de_db = dictFind(db->dict, key);
+    serverAssert(de_db);
+    robj *o = dictGetVal(de_db);
+    serverAssert(o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT);
+    dictEntry *de_hash = dictFind(o->ptr, field);
+    serverAssert(de_hash);
+
+    sds v = dictGetVal(de_hash);
+    serverAssert(v != shared.hash_rock_val_for_field);
+    dictGetVal(de_hash) = shared.hash_rock_val_for_field;
+    on_rockval_field_of_hash(dbid, key, field);
+
+    if (mem)
+        *mem = sdsAllocSize(v);
+
+    sdsfree(v);
+    ++stat_clean_evictions;
+}
+
 /* Called in main thread for command ROCKEVICT for db key.
  *
  * The caller need to guarantee:
@@ -448,9 +784,19 @@ static int try_evict_to_rocksdb_for_hash(const int try_len, const int *try_dbids
  */
 int try_evict_one_key_to_rocksdb(const int dbid, const sds key, size_t *mem)
 {
+    // clean key needs no space of ring buffer
+    if (is_clean_key_for_rock_evict(dbid, key))
+    {
+        evict_clean_key_without_write(dbid, key, mem);
+        return TRY_EVICT_ONE_SUCCESS;
+    }
+
     const int space = space_in_write_ring_buffer();
     if (space == 0)
+    {
+        ++stat_ring_full_stalls;
         return TRY_EVICT_ONE_FAIL_FOR_RING_BUFFER_FULL;
+    }
     
     serverAssert(try_evict_to_rocksdb_for_db(1, &dbid, &key, mem) == 1);
     return TRY_EVICT_ONE_SUCCESS;
@@ -464,14 +810,219 @@ int try_evict_one_key_to_rocksdb(const int dbid, const sds key, size_t *mem)
 int try_evict_one_field_to_rocksdb(const int dbid, const sds key, 
                                    const sds field, size_t *mem)
 {
+    // clean field needs no space of ring buffer
+    if (is_clean_field_of_rock_hash(dbid, key, field))
+    {
+        evict_clean_field_without_write(dbid, key, field, mem);
+        return TRY_EVICT_ONE_SUCCESS;
+    }
+
     const int space = space_in_write_ring_buffer();
     if (space == 0)
+    {
+        ++stat_ring_full_stalls;
         return TRY_EVICT_ONE_FAIL_FOR_RING_BUFFER_FULL;
+    }
 
     serverAssert(try_evict_to_rocksdb_for_hash(1, &dbid, &key, &field, mem) == 1);
     return TRY_EVICT_ONE_SUCCESS;
 }
 
+/* Called in main thread. 
+ * Append the tombstones (rock keys) to ring buffer 
+ * (tombstone is small so we do not check rock-write-ring-buffer-size).
+ * If there is no space of slots, wait for the write thread.
+ *
+ * NOTE: Tombstone can not be dropped because the stale record in RocksDB 
+ *       could be picked up later, e.g., by the prefix scan of a rock hash.
+ *       And it can not bypass ring buffer because it must be in order with 
+ *       the evictions, e.g., DEL key, SET key, evict key.
+ */
+static void append_tombstones_to_ringbuf(const int len, sds *rock_keys)
+{
+    if (len == 0)
+        return;
+
+    reclaim_written_slots_of_ring_buf();
+
+    unsigned long long head, tail;
+    atomicGetWithSync(rbuf_head, head);
+    atomicGet(rbuf_tail, tail);
+    if (RING_BUFFER_SLOTS - (int)(tail - head) < len)
+    {
+        ++stat_tombstone_stalls;
+        wait_for_free_slots_of_ring_buf(len);
+    }
+
+    sds vals[EVICT_MAX_BATCH_LEN];
+    for (int i = 0; i < len; ++i)
+        vals[i] = NULL;
+    batch_append_to_ringbuf(len, rock_keys, vals, NULL, NULL);
+}
+
+/* Called in main thread when a key is deleted, overwritten or expired in redis db
+ * and before the value o is released.
+ * 
+ * If the value (or some fields of the rock hash) is in RocksDB, 
+ * queue tombstones to write thread to delete the stale records in RocksDB,
+ * so disk usage follows the live dataset without ROCKSDBPURGE.
+ */
+void on_db_del_or_overwrite_for_rock_tombstone(const int dbid, const sds redis_key, const robj *o)
+{
+    if (is_rock_value(o))
+    {
+        int len = 0;
+        sds rock_keys[2];
+        rock_keys[len++] = encode_rock_key_for_db(dbid, sdsdup(redis_key));
+        // the segments of a big list, set or zset, check rock_segment.c
+        // NOTE: Whatever the current rock-segment-entries and the cardinality are, 
+        //       because the value could be split by an old config or when it was bigger.
+        if (is_segmentable_rock_value(o))
+            rock_keys[len++] = encode_rock_key_prefix_for_segment(dbid, redis_key, sdslen(redis_key));
+        append_tombstones_to_ringbuf(len, rock_keys);
+        return;
+    }
+
+    if (!(o->type == OBJ_HASH && o->encoding == OBJ_ENCODING_HT))
+        return;
+
+    redisDb *db = server.db + dbid;
+    dictEntry *de_rock_hash = dictFind(db->rock_hash, redis_key);
+    if (de_rock_hash == NULL)
+        return;
+
+    // the fields not in lrus are in RocksDB, check rock_hash.c
+    dict *hash = o->ptr;
+    dict *lrus = dictGetVal(de_rock_hash);
+    serverAssert(dictSize(hash) >= dictSize(lrus));
+    size_t in_disk = dictSize(hash) - dictSize(lrus);
+    if (in_disk == 0)
+        return;
+
+    int len = 0;
+    sds rock_keys[EVICT_MAX_BATCH_LEN];
+    dictIterator *di = dictGetIterator(hash);
+    dictEntry *de;
+    while (in_disk && (de = dictNext(di)))
+    {
+        if (dictGetVal(de) != shared.hash_rock_val_for_field)
+            continue;
+
+        rock_keys[len++] = encode_rock_key_for_hash(dbid, sdsdup(redis_key), dictGetKey(de));
+        --in_disk;
+        if (len == EVICT_MAX_BATCH_LEN)
+        {
+            append_tombstones_to_ringbuf(len, rock_keys);
+            len = 0;
+        }
+    }
+    dictReleaseIterator(di);
+
+    append_tombstones_to_ringbuf(len, rock_keys);
+}
+
+/* Called in main thread when FLUSHDB, FLUSHALL (or the full sync of replica) empties the db(s).
+ * If dbnum == -1, it means all dbs.
+ *
+ * Queue one range tombstone for the db(s) to write thread, 
+ * so all the records of the db(s) in RocksDB are deleted in constant time
+ * no matter how many keys (or fields) are in disk, check delete_db_range_in_write_batch().
+ * 
+ * NOTE: Like other tombstones, it must be in order with the evictions in ring buffer, 
+ *       e.g., FLUSHDB, SET key, evict key.
+ *       And like them, it waits for a free slot when the ring buffer is full.
+ *
+ * For repl-diskless-load swapdb, the backup has no value in RocksDB (check disklessLoadMakeBackup()),
+ * so the range tombstone does not delete any record the backup needs.
+ */
+void on_empty_db_for_rock_write(const int dbnum)
+{
+    serverAssert(dbnum == -1 || (dbnum >= 0 && dbnum < server.dbnum && dbnum <= 255));
+
+    // the flag for all dbs, or the flag and one byte of dbid for one db
+    const unsigned char range[2] = {ROCK_KEY_FOR_DB_RANGE, (unsigned char)dbnum};
+    sds range_key = sdsnewlen(range, dbnum == -1 ? 1 : 2);
+
+    reclaim_written_slots_of_ring_buf();
+    wait_for_free_slots_of_ring_buf(1);
+
+    sds val = NULL;
+    batch_append_to_ringbuf(1, &range_key, &val, NULL, NULL);
+
+    // the written slots before the range tombstone are not in cache until they are reclaimed,
+    // so the cache is cleared again when the range tombstone is reclaimed
+    clear_rock_cache();
+}
+
+/* Called in write thread for the range tombstone from on_empty_db_for_rock_write().
+ * All kinds of rock keys in RocksDB begin with the type and the dbid,
+ * so the records of a db are in one range for each type.
+ */
+static void delete_db_range_in_write_batch(rocksdb_writebatch_t *batch, const sds range_key)
+{
+    const unsigned char types[] = {ROCK_KEY_FOR_DB, ROCK_KEY_FOR_HASH, ROCK_KEY_FOR_SEGMENT};
+    for (size_t i = 0; i < sizeof(types)/sizeof(types[0]); ++i)
+    {
+        unsigned char start[2];
+        unsigned char end[2];
+        size_t start_len;
+        size_t end_len;
+        start[0] = types[i];
+        if (sdslen(range_key) == 1 || (unsigned char)range_key[1] == 255)
+        {
+            // all dbs (or the last dbid) of the type, until the next type
+            start[1] = sdslen(range_key) == 1 ? 0 : 255;
+            start_len = sdslen(range_key);
+            end[0] = types[i] + 1;
+            end_len = 1;
+        }
+        else
+        {
+            start[1] = (unsigned char)range_key[1];
+            start_len = 2;
+            end[0] = types[i];
+            end[1] = (unsigned char)range_key[1] + 1;
+            end_len = 2;
+        }
+        rocksdb_writebatch_delete_range(batch, (const char*)start, start_len, (const char*)end, end_len);
+    }
+}
+
+/* Called by write thread (or main thread when write thread exits) 
+ * for the robjs handed over by main thread in the range [head, tail) of ring buffer.
+ *
+ * Each robj is marshalled out of lock mode, 
+ * because main thread will not touch it (check dup_val_of_slot()).
+ * Then in lock mode, we set the val to the slot and wake up the waiting main thread.
+ * At last, the robj is freed out of lock mode and the memory is reconciled.
+ *
+ * NOTE: Reading rbuf_objs out of lock mode is OK, because only the write thread
+ *       clears it and main thread sets it before rbuf_tail is published.
+ */
+static void marshal_handovers_in_ring_buf(const unsigned long long head, const unsigned long long tail)
+{
+    for (unsigned long long seq = head; seq < tail; ++seq)
+    {
+        const int slot = SLOT_OF_SEQ(seq);
+        robj *o = rbuf_objs[slot];
+        if (o == NULL)
+            continue;
+
+        sds val = marshal_object(o);
+
+        rock_w_lock();
+        rbuf_vals[slot] = val;
+        rbuf_objs[slot] = NULL;
+        serverAssert(pthread_cond_broadcast(&cv_marshal) == 0);
+        rock_w_unlock();
+
+        decrRefCount(o);
+
+        // reconcile after the memory is really freed
+        atomicDecr(rbuf_pending_free_mem, rbuf_obj_mems[slot]);
+    }
+}
+
 /* Called by write thread to deal with purge task
  * The calller gurarantee:
  * 1. not in lock mode
@@ -529,6 +1080,10 @@ static void write_purge_to_rocksdb_first()
         rock_key = encode_rock_key_for_db(db_dbids[i], rock_key);
         rocksdb_writebatch_delete(batch, rock_key, sdslen(rock_key));
         sdsfree(rock_key);
+        // and the segments if have, check rock_segment.c
+        sds prefix = encode_rock_key_prefix_for_segment(db_dbids[i], db_keys[i], sdslen(db_keys[i]));
+        delete_segments_in_write_batch(batch, prefix);
+        sdsfree(prefix);
         ++del_cnt;
     }
     
@@ -577,27 +1132,25 @@ static int write_to_rocksdb()
 {
     write_purge_to_rocksdb_first();     // must called before deal with ring buffer
 
-    // Make lock as short as possible in write thread
-    rock_w_lock();
-
-    if (rbuf_len == 0)
-    {
-        rock_w_unlock();
+    unsigned long long head, tail;
+    atomicGetWithSync(rbuf_head, head);
+    atomicGetWithSync(rbuf_tail, tail);
+    if (head == tail)
         return 0;
-    }
-    int written = rbuf_len;
-    int index = rbuf_s_index;
 
     // must check purge job again because it is async mode
     // e.g. main thread cron add some purge job when write thread sleep 
     //      after the first statement write_purge_to_rocksdb_first() in write_to_rocksdb()
     //      then main cron add some task to ring buffer and now write thread wake up 
     int has_purge_job = 0;
+    rock_w_lock();
     if (!(del_db_keys[0] == NULL && del_hash_keys[0] == NULL))
         has_purge_job = 1;
-
     rock_w_unlock();
 
+    // marshal first because main thread may wait for it
+    marshal_handovers_in_ring_buf(head, tail);
+
     if (has_purge_job)
         // this guaratee no more purge job comming when ring buffer has some jobs
         // check rock_purge.c do_purge_in_cron() which has is_eviction_ring_buffer_empty() checking
@@ -612,17 +1165,37 @@ static int write_to_rocksdb()
     rocksdb_writeoptions_t *writeoptions = rocksdb_writeoptions_create();
     rocksdb_writeoptions_disable_WAL(writeoptions, 1);      // disable WAL
 
-    for (int i = 0; i < written; ++i) 
+    size_t bytes = 0;
+    long long written_bytes = 0;
+    long long tombstones = 0;
+    const size_t seg_entries = (size_t)server.rock_segment_entries;
+    for (unsigned long long seq = head; seq < tail; ++seq) 
     {
-        // Guarantee to get the updated data from Main thread up to written
-        const sds key = rbuf_keys[index];
-        const sds val = rbuf_vals[index];
-
-        ++index;
-        if (index == RING_BUFFER_LEN)
-            index = 0;
+        // Guarantee to get the updated data from Main thread up to tail
+        const int slot = SLOT_OF_SEQ(seq);
+        const sds key = rbuf_keys[slot];
+        const sds val = rbuf_vals[slot];
 
-        rocksdb_writebatch_put(batch, key, sdslen(key), val, sdslen(val));
+        if (val)
+        {
+            // big list, set or zset could be split to segments, check rock_segment.c
+            if (!put_segments_to_write_batch(batch, key, val, seg_entries))
+                rocksdb_writebatch_put(batch, key, sdslen(key), val, sdslen(val));
+            written_bytes += sdslen(key) + sdslen(val);
+        }
+        else
+        {
+            // tombstone
+            if (key[0] == ROCK_KEY_FOR_SEGMENT)
+                delete_segments_in_write_batch(batch, key);
+            else if (key[0] == ROCK_KEY_FOR_DB_RANGE)
+                delete_db_range_in_write_batch(batch, key);
+            else
+                rocksdb_writebatch_delete(batch, key, sdslen(key));
+            written_bytes += sdslen(key);
+            ++tombstones;
+        }
+        bytes += rbuf_bytes[slot];
     }
 
     char *err = NULL;
@@ -633,16 +1206,61 @@ static int write_to_rocksdb()
     rocksdb_writeoptions_destroy(writeoptions);
     rocksdb_writebatch_destroy(batch);
 
-    // need to update rbuf_len and rbuf_s_index
+    // statistics of latency from enqueue to RocksDB
+    const monotime now = getMonotonicUs();
+    long long latency_total = 0;
+    long long latency_max;
+    atomicGet(stat_latency_max_us, latency_max);
+    for (unsigned long long seq = head; seq < tail; ++seq)
+    {
+        const long long latency = (long long)(now - rbuf_enqueue_us[SLOT_OF_SEQ(seq)]);
+        latency_total += latency;
+        if (latency > latency_max)
+            latency_max = latency;
+    }
+    const int written = (int)(tail - head);
+    atomicSet(stat_latency_max_us, latency_max);
+    atomicIncr(stat_latency_total_us, latency_total);
+    atomicIncr(stat_written_keys, written);
+    atomicIncr(stat_written_bytes, written_bytes);
+    atomicIncr(stat_written_batches, 1);
+    atomicIncr(stat_written_tombstones, tombstones);
+
+    // release the slots to main thread (check reclaim_written_slots_of_ring_buf())
+    atomicDecr(rbuf_inflight_bytes, bytes);
+    atomicSetWithSync(rbuf_head, tail);
+
+    // wake up main thread if it is waiting for the slots, check wait_write_thread_until_seq()
     rock_w_lock();
-    serverAssert(rbuf_len >= written);
-    rbuf_len -= written;
-    rbuf_s_index = index;
+    serverAssert(pthread_cond_broadcast(&cv_written) == 0);
     rock_w_unlock();
 
     return written;
 }
 
+/* Called in main thread after the write thread exits, e.g., for warm restart.
+ * Write what left in ring buffer to RocksDB
+ * and flush the memtable to SST files because WAL is disabled.
+ * Return 1 if success, otherwise 0.
+ */
+int flush_all_to_rocksdb_before_exit()
+{
+    write_to_rocksdb();
+
+    rocksdb_flushoptions_t *flushoptions = rocksdb_flushoptions_create();
+    rocksdb_flushoptions_set_wait(flushoptions, 1);
+    char *err = NULL;
+    rocksdb_flush(rockdb, flushoptions, &err);
+    rocksdb_flushoptions_destroy(flushoptions);
+    if (err)
+    {
+        serverLog(LL_WARNING, "flush_all_to_rocksdb_before_exit() failed reason = %s", err);
+        rocksdb_free(err);
+        return 0;
+    }
+    return 1;
+}
+
 /* When RedRock start, it may need to write the key and value dircectly to RocksDB
  * in the process of loading RDB or AOF
  * The caller guarantee in main thread and in init phase, i.e., no cron job in serverCron()
@@ -657,7 +1275,8 @@ void write_to_rocksdb_in_main_for_key_when_load(redisDb *db, const sds redis_key
     rocksdb_writeoptions_t *writeoptions = rocksdb_writeoptions_create();
     rocksdb_writeoptions_disable_WAL(writeoptions, 1);      // disable WAL
 
-    rocksdb_writebatch_put(batch, rock_key, sdslen(rock_key), rock_val, sdslen(rock_val));
+    if (!put_segments_to_write_batch(batch, rock_key, rock_val, (size_t)server.rock_segment_entries))
+        rocksdb_writebatch_put(batch, rock_key, sdslen(rock_key), rock_val, sdslen(rock_val));
     char *err = NULL;
     rocksdb_write(rockdb, writeoptions, batch, &err);    
     if (err) 
@@ -698,6 +1317,14 @@ void write_to_rocksdb_in_main_for_hash_when_load(redisDb *db, const sds redis_ke
  */
 // #define MIN_SLEEP_MICRO     16
 // #define MAX_SLEEP_MICRO     1024            // max sleep for 1 ms
+static int is_ring_buf_empty_for_write_thread()
+{
+    unsigned long long head, tail;
+    atomicGetWithSync(rbuf_head, head);
+    atomicGetWithSync(rbuf_tail, tail);
+    return head == tail;
+}
+
 static void* rock_write_main(void* arg)
 {
     UNUSED(arg);
@@ -711,11 +1338,18 @@ static void* rock_write_main(void* arg)
     {
         rock_w_lock();
 
-        while(loop && rbuf_len == 0 && (del_db_keys[0] == NULL && del_hash_keys[0] == NULL))
+        // NOTE: write_thread_sleeping must be set before checking the ring buffer.
+        //       Main thread publishes rbuf_tail before checking write_thread_sleeping
+        //       (check batch_append_to_ringbuf()). With sequential consistency,
+        //       either we see the new tail, or main thread sees the flag 
+        //       and signals us in lock mode, so no lost wakeup.
+        atomicSetWithSync(write_thread_sleeping, 1);
+        while(loop && is_ring_buf_empty_for_write_thread() && (del_db_keys[0] == NULL && del_hash_keys[0] == NULL))
         {
             rock_w_wait_cond();
             atomicGet(rock_threads_loop_forever, loop);            
         } 
+        atomicSetWithSync(write_thread_sleeping, 0);
 
         rock_w_unlock();
         
@@ -728,100 +1362,78 @@ static void* rock_write_main(void* arg)
 
 /* Called in main thread.
  *
- * Check whether the key is in ring buffer.
- * If not found, return -1. Otherise, the index in ring buffer. 
- *
- * The caller guarantees in lock mode.
+ * Check whether the rock key is in ring buffer through the side index.
+ * If not found, return -1. Otherise, the slot index in ring buffer. 
  *
- * NOTE1: We need check from the end of ring buffer, becuase 
- *        for duplicated keys in ring buf, the tail is newer than the head
- *        in the queue (i.e., ring buffer).
+ * NOTE1: The side index keeps the newest slot for duplicated keys in ring buf.
  * 
- * NOTE2: If the invalid of the key is true, it means the db has just been emptied,
- *        we can not use it, and we do not need to advance for any more. 
+ * NOTE2: If the slot is before rbuf_head, it has been written to RocksDB 
+ *        but not reclaimed yet, we treat it as not found.
+ *        And if the slot is not before rbuf_head, it will not be released 
+ *        until main thread reclaims it, so the caller can use it safely.
  */
-static int exist_in_ring_buf_for_db_and_return_index(const int dbid, const sds redis_key)
+static int exist_in_ring_buf_and_return_slot(const sds rock_key)
 {
-    if (rbuf_len == 0)
+    dictEntry *de = dictFind(rbuf_index, rock_key);
+    if (de == NULL)
         return -1;
 
-    sds rock_key = sdsdup(redis_key);
-    rock_key = encode_rock_key_for_db(dbid, rock_key);
-    const size_t rock_key_len = sdslen(rock_key);
+    const unsigned long long seq = dictGetUnsignedIntegerVal(de);
+    unsigned long long head;
+    atomicGetWithSync(rbuf_head, head);
+    if (seq < head)
+        return -1;
+
+    return SLOT_OF_SEQ(seq);
+}
 
-    int index = rbuf_e_index - 1;
-    if (index == -1)
-        index = RING_BUFFER_LEN - 1;
+/* Called in main thread. Check the ring buffer first, then the compressed cache (check rock_cache.c).
+ * If found, return the value (duplicated or decompressed), otherwise NULL.
+ */
+static sds get_val_from_ring_buf_or_cache(const sds rock_key)
+{
+    const int index = exist_in_ring_buf_and_return_slot(rock_key);
+    if (index != -1)
+        return dup_val_of_slot(index);
 
-    for (int i = 0; i < rbuf_len; ++i)
-    {
-        if (rock_key_len == sdslen(rbuf_keys[index]) && sdscmp(rock_key, rbuf_keys[index]) == 0)
-        {
-            sdsfree(rock_key);
-            // return rbuf_invalids[index] ? -1 : index;
-            return index;
-        }
+    return get_val_from_rock_cache(rock_key);
+}
 
-        --index;
-        if (index == -1)
-            index = RING_BUFFER_LEN - 1;
-    }
+/* Called in main thread. Check get_val_from_ring_buf_or_cache() */
+static sds get_val_for_db_from_ring_buf_or_cache(const int dbid, const sds redis_key)
+{
+    if (dictSize(rbuf_index) == 0 && is_rock_cache_empty())
+        return NULL;
 
+    sds rock_key = sdsdup(redis_key);
+    rock_key = encode_rock_key_for_db(dbid, rock_key);
+    sds val = get_val_from_ring_buf_or_cache(rock_key);
     sdsfree(rock_key);
-    return -1;
+    return val;
 }
 
-/* Called in main thead.
- *
- * Check whether the key and field is in ring buffer.
- * If not found, return -1. Otherise, the index in ring buffer. 
- *
- * The caller guarantees in lock mode.
- *
- * NOTE: We need check from the end of ring buffer, becuase 
- *       for duplicated keys in ring buf, the tail is newer than the head
- *       in the queue (i.e., ring buffer).
- */
-static int exist_in_ring_buf_for_hash_and_return_index(const int dbid, const sds redis_key, const sds field)
+/* Called in main thead. Check get_val_from_ring_buf_or_cache() */
+static sds get_val_for_hash_from_ring_buf_or_cache(const int dbid, const sds redis_key, const sds field)
 {
-    if (rbuf_len == 0)
-        return -1;
+    if (dictSize(rbuf_index) == 0 && is_rock_cache_empty())
+        return NULL;
 
     sds rock_key = sdsdup(redis_key);
     rock_key = encode_rock_key_for_hash(dbid, rock_key, field);
-    const size_t rock_key_len = sdslen(rock_key);
-
-    int index = rbuf_e_index - 1;
-    if (index == -1)
-        index = RING_BUFFER_LEN - 1;
-
-    for (int i = 0; i < rbuf_len; ++i)
-    {
-        if (rock_key_len == sdslen(rbuf_keys[index]) && sdscmp(rock_key, rbuf_keys[index]) == 0)
-        {
-            sdsfree(rock_key);
-            // return rbuf_invalids[index] ? -1 : index;
-            return index;
-        }
-
-        --index;
-        if (index == -1)
-            index = RING_BUFFER_LEN - 1;
-    }
-
+    sds val = get_val_from_ring_buf_or_cache(rock_key);
     sdsfree(rock_key);
-    return -1;
+    return val;
 }
 
 /* Called in main thread.
  *
  * This is the API for rock_read.c. 
- * The caller guarantees not in lock mode of write.
  *
  * When a client needs recover some keys, it needs check ring buffer first.
  * The return is a list of recover vals (as sds) with same size as redis_keys (as same order).
  * 
- * If the key is in the ring buffer, the recover val (sds of serilized value) is duplicated.
+ * If the key is in the ring buffer (or the compressed cache, check rock_cache.c), 
+ * the recover val (sds of serilized value) is duplicated.
  * Otherwise, recover val will be set to NULL. 
  * 
  * If no key in ring buf, the return list will be NULL. (and no resource allocated)
@@ -835,29 +1447,18 @@ list* get_vals_from_write_ring_buf_first_for_db(const int dbid, const list *redi
     list *r = listCreate();
     int all_not_in_ring_buf = 1;
 
-    rock_w_lock();
-
     listIter li;
     listNode *ln;
     listRewind((list*)redis_keys, &li);
     while ((ln = listNext(&li)))
     {
         sds redis_key = listNodeValue(ln);
-        const int index = exist_in_ring_buf_for_db_and_return_index(dbid, redis_key);
-        if (index == -1)
-        {
-            listAddNodeTail(r, NULL);
-        }
-        else
-        {
-            sds copy_val = sdsdup(rbuf_vals[index]);
-            listAddNodeTail(r, copy_val);
+        sds copy_val = get_val_for_db_from_ring_buf_or_cache(dbid, redis_key);
+        listAddNodeTail(r, copy_val);
+        if (copy_val)
             all_not_in_ring_buf = 0;
-        }
     }
 
-    rock_w_unlock();
-
     if (all_not_in_ring_buf)
     {
         listRelease(r);
@@ -871,35 +1472,25 @@ list* get_vals_from_write_ring_buf_first_for_db(const int dbid, const list *redi
 
 /* This is the API for rock rdb and aof.
  *
- * The caller guarantee not in lock mode and in redis process.
+ * The caller guarantee in main thread of redis process.
  * 
  * If found, return the sds value (duplicated), otherwise NULL.
  * The caller needs to release the resource if return is not NULL.
  */
 sds get_key_val_str_from_write_ring_buf_first_in_redis_process(const int dbid, const sds key)
 {
-    sds val = NULL;
-
-    rock_w_lock();
-    const int index = exist_in_ring_buf_for_db_and_return_index(dbid, key);
-    if (index != -1)
-    {
-        val = sdsdup(rbuf_vals[index]);
-    }
-    rock_w_unlock();
-
-    return val;
+    return get_val_for_db_from_ring_buf_or_cache(dbid, key);
 }
 
 /* Called in main thread.
  *
  * This is the API for rock_read.c. 
- * The caller guarantees not in lock mode of write.
  *
  * When a client needs recover some hash keys with field, it needs check ring buffer first.
  * The return is a list of recover vals (as sds) with same size as hash_keys (as same order).
  * 
- * If the key is in the ring buffer, the recover val is duplicated.
+ * If the key is in the ring buffer (or the compressed cache, check rock_cache.c), 
+ * the recover val is duplicated.
  * Otherwise, recover val will be set to NULL. 
  * 
  * If no key in ring buf, the return list will be NULL. (and no resource allocated)
@@ -914,8 +1505,6 @@ list* get_vals_from_write_ring_buf_first_for_hash(const int dbid, const list *ha
     list *r = listCreate();
     int all_not_in_ring_buf = 1;
 
-    rock_w_lock();
-
     listIter li_key;
     listNode *ln_key;
     listRewind((list*)hash_keys, &li_key);
@@ -928,21 +1517,12 @@ list* get_vals_from_write_ring_buf_first_for_hash(const int dbid, const list *ha
 
         sds hash_key = listNodeValue(ln_key);
         sds field = listNodeValue(ln_field);
-        const int index = exist_in_ring_buf_for_hash_and_return_index(dbid, hash_key, field);
-        if (index == -1)
-        {
-            listAddNodeTail(r, NULL);
-        }
-        else
-        {
-            sds copy_val = sdsdup(rbuf_vals[index]);
-            listAddNodeTail(r, copy_val);
+        sds copy_val = get_val_for_hash_from_ring_buf_or_cache(dbid, hash_key, field);
+        listAddNodeTail(r, copy_val);
+        if (copy_val)
             all_not_in_ring_buf = 0;
-        }
     }
 
-    rock_w_unlock();
-
     if (all_not_in_ring_buf)
     {
         listRelease(r);
@@ -956,24 +1536,14 @@ list* get_vals_from_write_ring_buf_first_for_hash(const int dbid, const list *ha
 
 /* This is the API for rock rdb and aof.
  *
- * The caller guarantee not in lock mode and in redis process.
+ * The caller guarantee in main thread of redis process.
  * 
  * If found, return the sds value (duplicated), otherwise NULL.
  * The caller needs to deal with the resource if return is not NULL.
  */
 sds get_field_val_str_from_write_ring_buf_first_in_redis_process(const int dbid, const sds hash_key, const sds field)
 {
-    sds val = NULL;
-
-    rock_w_lock();
-    const int index = exist_in_ring_buf_for_hash_and_return_index(dbid, hash_key, field);
-    if (index != -1)
-    {
-        val = sdsdup(rbuf_vals[index]); 
-    }
-    rock_w_unlock();
-
-    return val;
+    return get_val_for_hash_from_ring_buf_or_cache(dbid, hash_key, field);
 }
 
 /* Called in main thread */
@@ -985,6 +1555,8 @@ void init_and_start_rock_write_thread()
     serverAssert(pthread_mutex_init(&mutex_write, &mattr_write) == 0);
 #endif
     serverAssert(pthread_cond_init(&cv, NULL) == 0);
+    serverAssert(pthread_cond_init(&cv_marshal, NULL) == 0);
+    serverAssert(pthread_cond_init(&cv_written, NULL) == 0);
 
     init_write_ring_buffer();
     init_write_purge_data();
@@ -1013,43 +1585,41 @@ void join_write_thread()
 /* Create a snapshot for ring buffer for child process.
  * 
  * NOTE:
- * 1. We use write lock to guarantee the integrity of ring buffer
- * 2. We duplicate the keys and vals in ring buffer to the output of keys and vals,
- *    so the caller needs to reclaim the resource
- * 3. After return (and unlcok), the caller can use a snapshot for RocksDB,
+ * 1. Called in main thread, so the side index and the slots are stable
+ *    (check exist_in_ring_buf_and_return_slot())
+ * 2. We duplicate the keys and vals in ring buffer to the returned dict 
+ *    (only the newest val for duplicated keys), 
+ *    so the caller needs to reclaim the resource by dictRelease()
+ * 3. After return, the caller can use a snapshot for RocksDB,
  *    bcause everything check the duplicated keys and vals first, 
- *    so the snapshot of RocksDB can have newer dataset which maybe from ring buffer after unlock.
- * 4. unlike ring buffer, the newer data is lower index in keys
- * 5. the caller guarantee that keys and vals must have the same size of RING_BUFFER_LEN
+ *    so the snapshot of RocksDB can have newer dataset which maybe from ring buffer after return.
  */
-void create_snapshot_of_ring_buf_for_child_process(sds *keys, sds *vals)
+dict* create_snapshot_of_ring_buf_for_child_process()
 {
-    rock_w_lock();
+    reclaim_written_slots_of_ring_buf();
 
-    int index = rbuf_e_index - 1;
-    if (index == -1)
-        index = RING_BUFFER_LEN - 1;
-    int len = rbuf_len;
+    dict *snapshot = dictCreate(&hashDictType, NULL);
 
-    for (int i = 0; i < RING_BUFFER_LEN; ++i)
+    unsigned long long head;
+    atomicGetWithSync(rbuf_head, head);
+
+    dictIterator *di = dictGetIterator(rbuf_index);
+    dictEntry *de;
+    while ((de = dictNext(di)))
     {
-        serverAssert(keys[i] == NULL && vals[i] == NULL);
+        const unsigned long long seq = dictGetUnsignedIntegerVal(de);
+        if (seq < head)
+            continue;   // already in RocksDB
 
-        if (len != 0)
-        {
-            serverAssert(rbuf_keys[index] != NULL && rbuf_vals[index] != NULL);
-                
-            keys[i] = sdsdup(rbuf_keys[index]);
-            vals[i] = sdsdup(rbuf_vals[index]);
-
-            --len;
-            --index;
-            if (index == 0)
-                index = RING_BUFFER_LEN - 1;
-        }
+        const int slot = SLOT_OF_SEQ(seq);
+        if (!rbuf_handovers[slot] && rbuf_vals[slot] == NULL)
+            continue;   // tombstone, the key is not rock value in redis db 
+
+        serverAssert(dictAdd(snapshot, sdsdup(dictGetKey(de)), dup_val_of_slot(slot)) == DICT_OK);
     }
+    dictReleaseIterator(di);
 
-    rock_w_unlock();
+    return snapshot;
 }
 
 /* Called by main thread in cron to check whether the purge task has been finished
@@ -1111,3 +1681,58 @@ void try_to_wakeup_write_thread()
     rock_w_signal_cond();
     rock_w_unlock();
 }
+
+/* Called in main thread for INFO ROCK.
+ * The metrics are for sizing the eviction bandwidth:
+ * ring_full_stalls is how many times the eviction finds the ring buffer is full,
+ * latency is from enqueue (in main thread) to written in RocksDB (by write thread),
+ * inflight is what is waiting for write thread in ring buffer.
+ */
+sds cat_rock_write_info(sds info)
+{
+    unsigned long long head, tail;
+    atomicGetWithSync(rbuf_head, head);
+    atomicGet(rbuf_tail, tail);
+    size_t inflight_bytes, pending_free_mem;
+    atomicGet(rbuf_inflight_bytes, inflight_bytes);
+    atomicGet(rbuf_pending_free_mem, pending_free_mem);
+    long long keys, bytes, batches, latency_total, latency_max;
+    atomicGet(stat_written_keys, keys);
+    atomicGet(stat_written_bytes, bytes);
+    atomicGet(stat_written_batches, batches);
+    atomicGet(stat_latency_total_us, latency_total);
+    atomicGet(stat_latency_max_us, latency_max);
+    long long tombstones;
+    atomicGet(stat_written_tombstones, tombstones);
+
+    info = sdscatprintf(info,
+                        "rock_write_ring_buffer_size:%zu\r\n"
+                        "rock_write_ring_buffer_slots:%d\r\n"
+                        "rock_write_inflight_keys:%llu\r\n"
+                        "rock_write_inflight_bytes:%zu\r\n"
+                        "rock_write_pending_free_mem:%zu\r\n"
+                        "rock_write_ring_full_stalls:%lld\r\n"
+                        "rock_write_keys:%lld\r\n"
+                        "rock_write_bytes:%lld\r\n"
+                        "rock_write_batches:%lld\r\n"
+                        "rock_write_latency_avg_us:%lld\r\n"
+                        "rock_write_latency_max_us:%lld\r\n"
+                        "rock_write_tombstones:%lld\r\n"
+                        "rock_write_tombstone_stalls:%lld\r\n"
+                        "rock_write_clean_evictions:%lld\r\n",
+                        server.rock_write_ring_buffer_size,
+                        RING_BUFFER_SLOTS,
+                        tail - head,
+                        inflight_bytes,
+                        pending_free_mem,
+                        stat_ring_full_stalls,
+                        keys,
+                        bytes,
+                        batches,
+                        keys == 0 ? 0 : latency_total / keys,
+                        latency_max,
+                        tombstones,
+                        stat_tombstone_stalls,
+                        stat_clean_evictions);
+    return info;
+}
@@ -34,10 +34,11 @@
 #include "sds.h"
 #include "server.h"
 
-// NOTE: The less the ring_buffer_len, the more time need to evicition but less chance of time out of eviction  
-// #define RING_BUFFER_LEN  8       // In test, we can not evict to 100M (only 40M) for a long time
-#define RING_BUFFER_LEN  16         // In test, we can use tens of minutes to evict 100M
-// #define RING_BUFFER_LEN 2  // for dbug, NOTE: if setting 1, compiler will generate some warnings
+// NOTE: The capacity of ring buffer is limited by bytes (rock-write-ring-buffer-size),
+//       RING_BUFFER_SLOTS is only the max number of keys in ring buffer.
+//       It must be power of 2. 
+//       (The old 16 slots ring buffer used tens of minutes to evict 100M in test)
+#define RING_BUFFER_SLOTS   4096
 
 // extern pthread_t rock_write_thread_id;
 void join_write_thread();
@@ -52,9 +53,15 @@ void init_and_start_rock_write_thread();
 int try_evict_one_key_to_rocksdb(const int dbid, const sds key, size_t *mem);
 int try_evict_one_field_to_rocksdb(const int dbid, const sds key, const sds field, size_t *mem);
 
+// for db.c and lazyfree.c when key is deleted or overwritten
+void on_db_del_or_overwrite_for_rock_tombstone(const int dbid, const sds redis_key, const robj *o);
+void on_empty_db_for_rock_write(const int dbnum);
+
 // for main thread when loading
+int flush_all_to_rocksdb_before_exit();
 void write_to_rocksdb_in_main_for_key_when_load(redisDb *db, const sds redis_key, const robj *redis_val);
 void write_to_rocksdb_in_main_for_hash_when_load(redisDb *db, const sds redis_key, const sds field, const sds field_val);
+void wait_rock_write_ring_buf_drained();
 
 // for rock_read.c
 list* get_vals_from_write_ring_buf_first_for_db(const int dbid, const list *redis_keys);
@@ -65,7 +72,7 @@ sds get_key_val_str_from_write_ring_buf_first_in_redis_process(const int dbid, c
 sds get_field_val_str_from_write_ring_buf_first_in_redis_process(const int dbid, const sds hash_key, const sds field);
 
 // for rock_rdb_aof.c
-void create_snapshot_of_ring_buf_for_child_process(sds *keys, sds *vals);
+dict* create_snapshot_of_ring_buf_for_child_process();
 
 // for rock.c and rock_purge.c (no lock)
 void rock_w_signal_cond();
@@ -74,6 +81,12 @@ void try_to_wakeup_write_thread();
 
 // for main thread purge job
 int is_eviction_ring_buffer_empty();
+
+// for rock_evict.c to reconcile the memory of eviction
+size_t get_evicted_mem_not_freed_by_write_thread();
+
+// for INFO
+sds cat_rock_write_info(sds info);
 int has_unfinished_purge_task_for_write();
 void transfer_purge_task_to_write_thread(int db_cnt, int *db_dbids, sds *db_keys,
                                          int hash_cnt, int *hash_dbids, sds *hash_keys, sds *hash_fields);
@@ -1716,6 +1716,28 @@ void evalShaCommand(client *c) {
     }
 }
 
+/* For EVAL and EVALSHA, the declared KEYS (argv[3] ... argv[3+numkeys-1])
+ * with rock value are recovered in async mode (by the read threads) before the script runs.
+ * So the script does not need to read them from RocksDB in sync mode 
+ * which blocks the main thread.
+ * The keys not declared or hash fields will still be recovered in sync mode 
+ * when the script calls the command, check check_and_recover_rock_value_in_sync_mode().
+ */
+list* eval_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
+{
+    UNUSED(hash_keys);
+    UNUSED(hash_fields);
+
+    long long numkeys;
+    if (getLongLongFromObject(c->argv[2], &numkeys) != C_OK)
+        return NULL;    // evalGenericCommand() will reply the error
+
+    if (numkeys <= 0 || numkeys > (c->argc - 3))
+        return NULL;    // no key or evalGenericCommand() will reply the error
+
+    return generic_get_multi_keys_for_rock_in_range(c, 3, 3 + (int)numkeys);
+}
+
 void scriptCommand(client *c) {
     if (c->argc == 2 && !strcasecmp(c->argv[1]->ptr,"help")) {
         const char *help[] = {
@@ -44,7 +44,10 @@
 #include "rock_evict.h"
 #include "rock_rdb_aof.h"
 #include "rock_statsd.h"
+#include "rock_warm.h"
 #include "rock_purge.h"
+#include "rock_admit.h"
+#include "rock_cache.h"
 
 #include <time.h>
 #include <signal.h>
@@ -689,19 +692,19 @@ struct redisCommand redisCommandTable[] = {
      "write fast @keyspace",
      0,NULL,1,2,1,0,0,0},
 
-    {"expire", expire_cmd_for_rock, expireCommand,3,
+    {"expire", NULL, expireCommand,3,
      "write fast @keyspace",
      0,NULL,1,1,1,0,0,0},
 
-    {"expireat", expireat_cmd_for_rock, expireatCommand,3,
+    {"expireat", NULL, expireatCommand,3,
      "write fast @keyspace",
      0,NULL,1,1,1,0,0,0},
 
-    {"pexpire", pexpire_cmd_for_rock, pexpireCommand,3,
+    {"pexpire", NULL, pexpireCommand,3,
      "write fast @keyspace",
      0,NULL,1,1,1,0,0,0},
 
-    {"pexpireat", pexpireat_cmd_for_rock, pexpireatCommand,3,
+    {"pexpireat", NULL, pexpireatCommand,3,
      "write fast @keyspace",
      0,NULL,1,1,1,0,0,0},
 
@@ -800,19 +803,19 @@ struct redisCommand redisCommandTable[] = {
      "admin no-script ok-loading ok-stale",
      0,NULL,0,0,0,0,0,0},
 
-    {"ttl", ttl_cmd_for_rock, ttlCommand,2,
+    {"ttl", NULL, ttlCommand,2,
      "read-only fast random @keyspace",
      0,NULL,1,1,1,0,0,0},
 
-    {"touch", touch_cmd_for_rock, touchCommand,-2,
+    {"touch", NULL, touchCommand,-2,
      "read-only fast @keyspace",
      0,NULL,1,-1,1,0,0,0},
 
-    {"pttl", pttl_cmd_for_rock, pttlCommand,2,
+    {"pttl", NULL, pttlCommand,2,
      "read-only fast random @keyspace",
      0,NULL,1,1,1,0,0,0},
 
-    {"persist", persist_cmd_for_rock, persistCommand,2,
+    {"persist", NULL, persistCommand,2,
      "write fast @keyspace",
      0,NULL,1,1,1,0,0,0},
 
@@ -918,11 +921,11 @@ struct redisCommand redisCommandTable[] = {
 
     /* EVAL can modify the dataset, however it is not flagged as a write
      * command since we do the check while running commands from Lua. */
-    {"eval", NULL, evalCommand,-3,
+    {"eval", eval_cmd_for_rock, evalCommand,-3,
      "no-script may-replicate @scripting",
      0,evalGetKeys,0,0,0,0,0,0},
 
-    {"evalsha", NULL, evalShaCommand,-3,
+    {"evalsha", eval_cmd_for_rock, evalShaCommand,-3,
      "no-script may-replicate @scripting",
      0,evalGetKeys,0,0,0,0,0,0},
 
@@ -2305,6 +2308,7 @@ int serverCron(struct aeEventLoop *eventLoop, long long id, void *clientData) {
                           &ei);
 
     // We add the following features for RedRock
+    update_rocksdb_mem_in_cron();       // before the eviction for rock-total-mem
     const int evict_something = perform_rock_eviction_in_cron();
     send_metrics_to_statsd_in_cron();
     update_rocksdb_stat_in_cron();
@@ -2452,6 +2456,14 @@ void beforeSleep(struct aeEventLoop *eventLoop) {
     if (listLength(server.unblocked_clients))
         processUnblockedClients();
 
+    /* Drop the cold values which are not admitted to memory after the commands.
+     * Check rock_admit.c */
+    demote_not_admitted_cold_reads();
+
+    /* Evict some memory between event loop iterations if memory is over the watermark.
+     * Check rock_evict.c */
+    perform_rock_eviction_before_sleep();
+
     /* Send all the slaves an ACK request if at least one client blocked
      * during the previous event loop iteration. Note that we do this after
      * processUnblockedClients(), so if there are multiple pipelined WAITs
@@ -3204,6 +3216,8 @@ static void init_redrock()
     init_and_start_rock_write_thread();     // init rock write
     init_and_start_rock_read_thread();      // init rock read
     init_and_start_rock_purge_thread();     // init rock purge
+    init_rock_admit();                      // init rock admission
+    init_rock_cache();                      // init rock compressed cache
 
     evict_pool_init();      // init evcition pool
 
@@ -4471,7 +4485,10 @@ int prepareForShutdown(int flags) {
         /* Snapshotting. Perform a SYNC SAVE and exit */
         rdbSaveInfo rsi, *rsiptr;
         rsiptr = rdbPopulateSaveInfo(&rsi);
+        /* The final RDB carries the warm restart token. Check rock_warm.c */
+        set_warm_restart_token_before_final_save();
         if (rdbSave(server.rdb_filename,rsiptr) != C_OK) {
+            reset_warm_restart_token();
             /* Ooops.. error saving! The best we can do is to continue
              * operating. Note that if there was a background saving process,
              * in the next cron() Redis will be notified that the background
@@ -5431,6 +5448,18 @@ sds genRedisInfoString(const char *section) {
         server.cluster_enabled);
     }
 
+    /* Rock */
+    if (allsections || defsections || !strcasecmp(section,"rock")) {
+        if (sections++) info = sdscat(info,"\r\n");
+        info = sdscatprintf(info, "# Rock\r\n");
+        info = cat_rock_read_info(info);
+        info = cat_rock_write_info(info);
+        info = cat_rock_admit_info(info);
+        info = cat_rock_cache_info(info);
+        info = cat_rock_evict_info(info);
+        info = cat_rocksdb_mem_info(info);
+    }
+
     /* Key space */
     if (allsections || defsections || !strcasecmp(section,"keyspace")) {
         if (sections++) info = sdscat(info,"\r\n");
@@ -6506,6 +6535,7 @@ int main(int argc, char **argv) {
         ACLLoadUsersAtStartup();
         InitServerLast();
         loadDataFromDisk();
+        finish_warm_restart_after_load();
         if (server.cluster_enabled) {
             if (verifyClusterConfigWithData() == C_ERR) {
                 serverLog(LL_WARNING,
@@ -350,6 +350,7 @@ typedef enum {
 #define SLAVE_CAPA_NONE 0
 #define SLAVE_CAPA_EOF (1<<0)    /* Can parse the RDB EOF streaming format. */
 #define SLAVE_CAPA_PSYNC2 (1<<1) /* Supports PSYNC2 protocol. */
+#define SLAVE_CAPA_ROCK_SST (1<<2) /* RedRock replica, can load cold keys as rows of RocksDB. */
 
 /* Synchronous read timeout - slave side */
 #define CONFIG_REPL_SYNCIO_TIMEOUT 5
@@ -722,6 +723,7 @@ typedef struct redisDb {
     size_t rock_field_in_disk_cnt; /* How many fields already in disk */
     dict *rock_evict;           /* Rock evict for whole key for RocksDB */
     size_t rock_key_in_disk_cnt;/* How many keys already in disk */
+    dict *rock_meta;            /* Cardinality of the rock value for each key in disk */
     int id;                     /* Database ID */
     long long avg_ttl;          /* Average TTL, just for stats */
     unsigned long expires_cursor; /* Cursor of the active expire cycle. */
@@ -1516,7 +1518,23 @@ struct redisServer {
     unsigned int maxclients;            /* Max number of simultaneous clients */
     unsigned long long maxmemory;   /* Max number of memory bytes to use */
     unsigned long long maxrockmem;  /* Max number of memory bytes for RedRock to use */
+    unsigned long long rock_total_mem;  /* Budget of memory bytes for both Redis and RocksDB */
     long long maxpsmem;             /* max rock process memory bytes for RedRock to process memory-consumed command */
+    int rock_read_threads_num;      /* Number of RedRock read threads for reading RocksDB */
+    int rock_read_batch_max;        /* Max batch size of one read of RocksDB for each read thread */
+    int rock_warm_restart;          /* Reuse the RocksDB folder of last shutdown when restart */
+    int rock_marshal_in_write_thread;   /* Eviction hands over the robj to write thread for serialization */
+    size_t rock_write_ring_buffer_size; /* Max bytes in the write ring buffer waiting for RocksDB */
+    int rock_segment_entries;       /* Elements of each segment for big list, set and zset in RocksDB */
+    int rock_load_sst;              /* Write the values to RocksDB by SST files when loading RDB */
+    int rock_repl_sst;              /* Full sync cold keys to RedRock replicas as rows of RocksDB */
+    int rock_evict_size_aware;      /* Eviction considers the size of value besides LRU/LFU */
+    int rock_evict_low_watermark;   /* Eviction stops under the percent of maxrockmem */
+    int rock_evict_high_watermark;  /* Eviction starts over the percent of maxrockmem */
+    int rock_admit_min_freq;        /* Min estimated frequency of cold reads to stay in memory */
+    int rock_prefetch_window;       /* Pipelined commands parsed ahead to prefetch their rock keys */
+    size_t rock_cache_size;         /* Max memory of the compressed cache of the values in RocksDB */
+    int rock_zstd_dict_size;        /* Max size of the zstd dictionary for RocksDB compression */
     int maxmemory_policy;           /* Policy for key eviction */
     int maxmemory_samples;          /* Precision of random sampling */
     int maxmemory_eviction_tenacity;/* Aggressiveness of eviction processing */
@@ -30,6 +30,7 @@
 #include "server.h"
 #include "rock.h"
 #include "rock_hash.h"
+#include "rock_evict.h"
 
 #include <math.h>
 #include <ctype.h>
@@ -1245,7 +1246,10 @@ void hlenCommand(client *c) {
     if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
         checkType(c,o,OBJ_HASH)) return;
 
-    addReplyLongLong(c,hashTypeLength(o));
+    if (is_rock_value(o))
+        addReplyLongLong(c,get_cardinality_of_rock_value(c->db->id,c->argv[1]->ptr));
+    else
+        addReplyLongLong(c,hashTypeLength(o));
 }
 
 static int hlen_command_check_and_reply(client *c)
@@ -1266,7 +1270,7 @@ list* hlen_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
     if (hlen_command_check_and_reply((client*)c))
         return shared.rock_cmd_fail;
 
-    return generic_get_one_key_for_rock(c, 1);
+    return generic_get_one_key_for_cardinality_for_rock(c, 1);
 }
 
 void hstrlenCommand(client *c) {
@@ -29,6 +29,7 @@
 
 #include "server.h"
 #include "rock.h"
+#include "rock_evict.h"
 
 /*-----------------------------------------------------------------------------
  * List API
@@ -386,7 +387,10 @@ list* linsert_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields
 void llenCommand(client *c) {
     robj *o = lookupKeyReadOrReply(c,c->argv[1],shared.czero);
     if (o == NULL || checkType(c,o,OBJ_LIST)) return;
-    addReplyLongLong(c,listTypeLength(o));
+    if (is_rock_value(o))
+        addReplyLongLong(c,get_cardinality_of_rock_value(c->db->id,c->argv[1]->ptr));
+    else
+        addReplyLongLong(c,listTypeLength(o));
 }
 
 static int llen_command_check_and_reply(client *c)
@@ -406,7 +410,7 @@ list* llen_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
     if (llen_command_check_and_reply((client*)c))
         return shared.rock_cmd_fail;
 
-    return generic_get_one_key_for_rock(c, 1);
+    return generic_get_one_key_for_cardinality_for_rock(c, 1);
 }
 
 /* LINDEX <key> <index> */
@@ -29,6 +29,7 @@
 
 #include "server.h"
 #include "rock.h"
+#include "rock_evict.h"
 
 /*-----------------------------------------------------------------------------
  * Set Commands
@@ -540,7 +541,10 @@ void scardCommand(client *c) {
     if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
         checkType(c,o,OBJ_SET)) return;
 
-    addReplyLongLong(c,setTypeSize(o));
+    if (is_rock_value(o))
+        addReplyLongLong(c,get_cardinality_of_rock_value(c->db->id,c->argv[1]->ptr));
+    else
+        addReplyLongLong(c,setTypeSize(o));
 }
 
 static int scard_command_check_and_reply(client *c)
@@ -562,7 +566,7 @@ list* scard_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
     if (scard_command_check_and_reply((client*)c))
         return shared.rock_cmd_fail;
 
-    return generic_get_one_key_for_rock(c, 1);
+    return generic_get_one_key_for_cardinality_for_rock(c, 1);
 }
 
 /* Handle the "SPOP key <count>" variant. The normal version of the
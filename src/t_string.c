@@ -28,6 +28,7 @@
  */
 
 #include "rock.h"
+#include "rock_evict.h"
 
 #include "server.h"
 #include <math.h> /* isnan(), isinf() */
@@ -1071,7 +1072,10 @@ void strlenCommand(client *c) {
     robj *o;
     if ((o = lookupKeyReadOrReply(c,c->argv[1],shared.czero)) == NULL ||
         checkType(c,o,OBJ_STRING)) return;
-    addReplyLongLong(c,stringObjectLen(o));
+    if (is_rock_value(o))
+        addReplyLongLong(c,get_cardinality_of_rock_value(c->db->id,c->argv[1]->ptr));
+    else
+        addReplyLongLong(c,stringObjectLen(o));
 }
 
 list* strlen_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
@@ -1079,7 +1083,7 @@ list* strlen_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
     UNUSED(hash_keys);
     UNUSED(hash_fields);
 
-    return generic_get_one_key_for_rock(c, 1);
+    return generic_get_one_key_for_cardinality_for_rock(c, 1);
 }
 
 /* STRALGO -- Implement complex algorithms on strings.
@@ -58,6 +58,7 @@
 
 #include "server.h"
 #include "rock.h"
+#include "rock_evict.h"
 
 #include <math.h>
 
@@ -3968,7 +3969,10 @@ void zcardCommand(client *c) {
     if ((zobj = lookupKeyReadOrReply(c,key,shared.czero)) == NULL ||
         checkType(c,zobj,OBJ_ZSET)) return;
 
-    addReplyLongLong(c,zsetLength(zobj));
+    if (is_rock_value(zobj))
+        addReplyLongLong(c,get_cardinality_of_rock_value(c->db->id,c->argv[1]->ptr));
+    else
+        addReplyLongLong(c,zsetLength(zobj));
 }
 
 static int zcard_command_check_and_reply(client *c)
@@ -3991,7 +3995,7 @@ list* zcard_cmd_for_rock(const client *c, list **hash_keys, list **hash_fields)
     if (zcard_command_check_and_reply((client*)c))
         return shared.rock_cmd_fail;
 
-    return generic_get_one_key_for_rock(c, 1);
+    return generic_get_one_key_for_cardinality_for_rock(c, 1);
 }
 
 void zscoreCommand(client *c) {
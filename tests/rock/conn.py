@@ -1,4 +1,5 @@
 import redis
+import time
 
 #redis_ip = "127.0.0.1"
 redis_ip = "192.168.56.3"
@@ -24,6 +25,31 @@ def rock_evict_hash(key, *fields):
     r.execute_command("rockevicthash", key, *fields)
 
 
+# For the tests of big list, set or zset saved in RocksDB as segments (check rock_segment.c),
+# the values have seg_len elements, more than seg_entries for rock-segment-entries
+seg_entries = 4096
+seg_len = 10000
+
+
+# return the old config
+def set_segment_entries(entries):
+    old = r.config_get("rock-segment-entries")["rock-segment-entries"]
+    r.execute_command("config", "set", "rock-segment-entries", entries)
+    return old
+
+
+# ROCKEVICT replies ALREADY_WHOLE_ROCK_VAL for a key whose value is still in RocksDB.
+# NOTE: a key in memory is evicted by the check
+def is_cold(key):
+    res = r.execute_command("rockevict", key)
+    return res[1] == "ALREADY_WHOLE_ROCK_VAL"
+
+
+def rock_write_tombstones():
+    time.sleep(0.1)     # wait for write thread
+    return int(r.info("rock")["rock_write_tombstones"])
+
+
 def _main():
     r.set(name="k1", value="123")
     # print(r.get(name="k1"))
@@ -0,0 +1,81 @@
+from conn import r, rock_evict, is_cold
+
+
+# LLEN/SCARD/ZCARD/HLEN/STRLEN on a cold key reply from the cardinality in memory,
+# and the value stays in RocksDB
+key = "_test_cold_card_"
+
+
+def check_card(cmd, expected):
+    rock_evict(key)
+    if not is_cold(key):
+        raise Exception(f"cold_card: {cmd} not evicted")
+    res = r.execute_command(cmd, key)
+    if res != expected:
+        print(res)
+        raise Exception(f"cold_card: {cmd} reply")
+    if not is_cold(key):
+        raise Exception(f"cold_card: {cmd} recovered the value")
+
+
+def strlen():
+    r.execute_command("del", key)
+    r.execute_command("set", key, "abc" * 100)
+    check_card("strlen", 300)
+
+
+def llen():
+    r.execute_command("del", key)
+    r.execute_command("rpush", key, *[f"e{i}" for i in range(100)])
+    check_card("llen", 100)
+
+
+def scard():
+    r.execute_command("del", key)
+    r.execute_command("sadd", key, *[f"m{i}" for i in range(100)])
+    check_card("scard", 100)
+
+
+def zcard():
+    r.execute_command("del", key)
+    r.execute_command("zadd", key, *[x for i in range(100) for x in (i, f"m{i}")])
+    check_card("zcard", 100)
+
+
+# assume a hash no more than 4 fields will not be in a rock hash (check test_rock_hash.py)
+def hlen():
+    r.execute_command("del", key)
+    r.execute_command("hset", key, "f1", "v1", "f2", "v2", "f3", "v3")
+    check_card("hlen", 3)
+
+
+# the cardinality follows the value after it is recovered, changed and evicted again
+def after_change():
+    r.execute_command("del", key)
+    r.execute_command("rpush", key, "a", "b", "c")
+    rock_evict(key)
+    r.execute_command("rpush", key, "d")
+    check_card("llen", 4)
+
+
+def test_all():
+    strlen()
+    llen()
+    scard()
+    zcard()
+    hlen()
+    after_change()
+    r.execute_command("del", key)
+
+
+def _main():
+    cnt = 0
+    while (1):
+        test_all()
+        cnt = cnt + 1
+        if cnt % 10 == 0:
+            print(f"test cold card OK cnt = {cnt}")
+
+
+if __name__ == '__main__':
+    _main()
@@ -0,0 +1,113 @@
+from conn import r, rock_evict, is_cold
+import time
+
+
+# TTL/EXPIRE/PERSIST/TOUCH work on the key in memory and do not read the cold value
+key = "_test_cold_expire_"
+val = "cold_val" * 100
+
+
+def build_cold_key():
+    r.execute_command("del", key)
+    r.execute_command("set", key, val)
+    rock_evict(key)
+    if not is_cold(key):
+        raise Exception("cold_expire: not evicted")
+
+
+def check_still_cold(name):
+    if not is_cold(key):
+        raise Exception(f"cold_expire: {name} recovered the value")
+
+
+def ttl_and_expire():
+    build_cold_key()
+    res = r.execute_command("ttl", key)
+    if res != -1:
+        print(res)
+        raise Exception("cold_expire: ttl without expire")
+    res = r.execute_command("expire", key, 100)
+    if res != 1:
+        print(res)
+        raise Exception("cold_expire: expire")
+    res = r.execute_command("ttl", key)
+    if res <= 0 or res > 100:
+        print(res)
+        raise Exception("cold_expire: ttl")
+    res = r.execute_command("pexpireat", key, int(time.time() * 1000) + 200000)
+    if res != 1:
+        print(res)
+        raise Exception("cold_expire: pexpireat")
+    res = r.execute_command("pttl", key)
+    if res <= 100000 or res > 200000:
+        print(res)
+        raise Exception("cold_expire: pttl")
+    check_still_cold("ttl and expire")
+
+
+def persist():
+    build_cold_key()
+    r.execute_command("expire", key, 100)
+    res = r.execute_command("persist", key)
+    if res != 1:
+        print(res)
+        raise Exception("cold_expire: persist")
+    res = r.execute_command("ttl", key)
+    if res != -1:
+        print(res)
+        raise Exception("cold_expire: ttl after persist")
+    check_still_cold("persist")
+
+
+def touch():
+    build_cold_key()
+    res = r.execute_command("touch", key, "_test_cold_expire_not_exist_")
+    if res != 1:
+        print(res)
+        raise Exception("cold_expire: touch")
+    check_still_cold("touch")
+
+
+# the cold key expires and the value can not be read any more
+def expired():
+    build_cold_key()
+    r.execute_command("pexpire", key, 100)
+    check_still_cold("pexpire")
+    time.sleep(0.2)
+    res = r.execute_command("get", key)
+    if res is not None:
+        print(res)
+        raise Exception("cold_expire: get after expired")
+
+
+# the value is correct after the expire commands
+def value_after_expire():
+    build_cold_key()
+    r.execute_command("expire", key, 100)
+    r.execute_command("persist", key)
+    res = r.execute_command("get", key)
+    if res != val:
+        print(res)
+        raise Exception("cold_expire: get")
+
+
+def test_all():
+    ttl_and_expire()
+    persist()
+    touch()
+    expired()
+    value_after_expire()
+    r.execute_command("del", key)
+
+
+def _main():
+    cnt = 0
+    while (1):
+        test_all()
+        cnt = cnt + 1
+        if cnt % 10 == 0:
+            print(f"test cold expire OK cnt = {cnt}")
+
+
+if __name__ == '__main__':
+    _main()
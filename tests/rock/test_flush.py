@@ -0,0 +1,140 @@
+from conn import r, redis_ip, redis_port
+import redis
+import time
+
+
+# RedRock replica for the swapdb diskless load, check test_repl_sst.py
+replica_port = 6380
+
+key = "_test_flush_"
+hash_key = "_test_flush_hash_"
+
+
+def make_client(port, db):
+    pool = redis.ConnectionPool(host=redis_ip,
+                                port=port,
+                                db=db,
+                                decode_responses=True,
+                                encoding='utf-8',
+                                socket_connect_timeout=2)
+    return redis.StrictRedis(connection_pool=pool)
+
+
+# assume a hash more than 4 fields will be in a rock hash (check test_rock_hash.py)
+def build_cold_keys(c, val):
+    c.execute_command("del", key, hash_key)
+    c.execute_command("set", key, val)
+    c.execute_command("hset", hash_key, "f1", val, "f2", val, "f3", val, "f4", val, "f5", val, "f6", val)
+    c.execute_command("rockevict", key)
+    c.execute_command("rockevicthash", hash_key, "f1", "f2", "f3")
+
+
+def check_cold_keys(c, val, name):
+    res = c.execute_command("get", key)
+    if res != val:
+        print(res)
+        raise Exception(f"flush: {name} get")
+    res = c.execute_command("hmget", hash_key, "f1", "f2", "f3", "f4")
+    if res != [val, val, val, val]:
+        print(res)
+        raise Exception(f"flush: {name} hmget")
+
+
+def check_empty(c, name):
+    res = c.execute_command("dbsize")
+    if res != 0:
+        print(res)
+        raise Exception(f"flush: {name} dbsize")
+
+
+def flushdb():
+    c1 = make_client(redis_port, 1)
+    build_cold_keys(r, "db0_val")
+    build_cold_keys(c1, "db1_val")
+
+    # the range tombstone is only for db 1
+    c1.execute_command("flushdb")
+    check_empty(c1, "flushdb db1")
+    check_cold_keys(r, "db0_val", "flushdb db0")
+
+    # the new records after the range tombstone are not deleted
+    build_cold_keys(c1, "db1_new_val")
+    check_cold_keys(c1, "db1_new_val", "flushdb db1 again")
+
+
+def flushall():
+    c1 = make_client(redis_port, 1)
+    build_cold_keys(r, "db0_val")
+    build_cold_keys(c1, "db1_val")
+
+    r.execute_command("flushall")
+    check_empty(r, "flushall db0")
+    check_empty(c1, "flushall db1")
+
+    build_cold_keys(r, "db0_new_val")
+    check_cold_keys(r, "db0_new_val", "flushall db0 again")
+
+
+# Let the full sync of the replica fail in the middle of the diskless load.
+# The master sends the RDB slowly, then refuses the replica and kills the connection.
+def fail_diskless_load(replica):
+    r.execute_command("config", "set", "repl-diskless-sync", "yes")
+    r.execute_command("config", "set", "repl-diskless-sync-delay", 0)
+    r.execute_command("config", "set", "rdb-key-save-delay", 100000)
+    for i in range(100):
+        r.execute_command("set", f"{key}{i}", "master_val")
+
+    replica.execute_command("replicaof", redis_ip, redis_port)
+    time.sleep(2)
+    r.execute_command("config", "set", "requirepass", "_test_flush_pass_")
+    r.execute_command("client", "kill", "type", "replica")
+    time.sleep(2)
+    replica.execute_command("replicaof", "no", "one")
+
+    r.execute_command("config", "set", "requirepass", "")
+    r.execute_command("config", "set", "rdb-key-save-delay", 0)
+    for i in range(100):
+        r.execute_command("del", f"{key}{i}")
+
+
+def swapdb_load_fail():
+    replica = make_client(replica_port, 0)
+    replica.execute_command("replicaof", "no", "one")
+    replica.execute_command("flushall")
+    replica.execute_command("config", "set", "repl-diskless-load", "swapdb")
+
+    # all values in memory, the backup is restored
+    replica.execute_command("set", key, "replica_val")
+    fail_diskless_load(replica)
+    res = replica.execute_command("get", key)
+    if res != "replica_val":
+        print(res)
+        raise Exception("flush: swapdb restore")
+
+    # some values in RocksDB, no backup and the old data is flushed
+    build_cold_keys(replica, "replica_val")
+    fail_diskless_load(replica)
+    check_empty(replica, "swapdb no backup")
+    build_cold_keys(replica, "replica_new_val")
+    check_cold_keys(replica, "replica_new_val", "swapdb after flush")
+
+    replica.execute_command("config", "set", "repl-diskless-load", "disabled")
+
+
+def test_all():
+    flushdb()
+    flushall()
+    swapdb_load_fail()
+
+
+def _main():
+    cnt = 0
+    while (1):
+        test_all()
+        cnt = cnt + 1
+        if cnt % 10 == 0:
+            print(f"test flush OK cnt = {cnt}")
+
+
+if __name__ == '__main__':
+    _main()
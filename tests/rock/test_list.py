@@ -1,4 +1,4 @@
-from conn import r, rock_evict
+from conn import r, rock_evict, seg_entries, seg_len, set_segment_entries, rock_write_tombstones
 
 
 key = "_test_rock_list_"
@@ -300,6 +300,47 @@ def blmove():
         raise Exception("blmove fail2")
 
 
+def segments():
+    old_entries = set_segment_entries(seg_entries)
+    r.execute_command("del", key)
+    elements = [f"seg{i}" for i in range(seg_len)]
+    r.rpush(key, *elements)
+    rock_evict(key)
+    res = r.lrange(key, 0, -1)
+    if res != elements:
+        print(len(res))
+        raise Exception("segments fail")
+    # partial overwrite, then evict again
+    r.lset(key, seg_len // 2, "changed")
+    elements[seg_len // 2] = "changed"
+    rock_evict(key)
+    res = r.lrange(key, 0, -1)
+    if res != elements:
+        print(len(res))
+        raise Exception("segments fail2")
+    # fewer segments
+    r.ltrim(key, 0, seg_len // 2)
+    elements = elements[:seg_len // 2 + 1]
+    rock_evict(key)
+    res = r.lrange(key, 0, -1)
+    if res != elements:
+        print(len(res))
+        raise Exception("segments fail3")
+    # delete a segmented key, one tombstone for the head and one for all segments
+    tombstones = rock_write_tombstones()
+    r.execute_command("del", key)
+    if rock_write_tombstones() != tombstones + 2:
+        raise Exception("segments fail4")
+    # a small value of the same key does not see the old segments
+    r.rpush(key, "a", "b")
+    rock_evict(key)
+    res = r.lrange(key, 0, -1)
+    if res != ["a", "b"]:
+        print(res)
+        raise Exception("segments fail5")
+    set_segment_entries(old_entries)
+
+
 def test_all():
     lpush()
     rpush()
@@ -321,6 +362,7 @@ def test_all():
     brpop()
     brpoplpush()
     blmove()
+    segments()
 
 
 def _main():
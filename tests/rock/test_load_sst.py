@@ -0,0 +1,100 @@
+from conn import r, rock_evict, seg_entries, seg_len, set_segment_entries
+
+
+# When RDB loads and the memory is over maxrockmem, the values go to RocksDB
+# by SST file ingestion for rock-load-sst (check rock_load.c), or by the writes of main thread
+key = "_test_load_sst_"
+list_key = "_test_load_sst_list_"
+hash_key = "_test_load_sst_hash_"
+key_num = 5000
+
+
+def val_of(i):
+    return f"load_val{i}" * 100
+
+
+def build_keys():
+    for i in range(key_num):
+        r.execute_command("set", f"{key}{i}", val_of(i))
+    # more than rock-segment-entries (seg_entries in conn.py) for the segments in RocksDB
+    r.execute_command("del", list_key)
+    r.execute_command("rpush", list_key, *[f"e{i}" for i in range(seg_len)])
+    rock_evict(list_key)
+    # assume a hash more than 4 fields will be in a rock hash (check test_rock_hash.py)
+    r.execute_command("del", hash_key)
+    r.execute_command("hset", hash_key, *[x for i in range(100) for x in (f"f{i}", val_of(i))])
+
+
+def del_keys():
+    for i in range(key_num):
+        r.execute_command("del", f"{key}{i}")
+    r.execute_command("del", list_key, hash_key)
+
+
+def check_dataset(name):
+    for i in range(key_num):
+        res = r.execute_command("get", f"{key}{i}")
+        if res != val_of(i):
+            print(res)
+            raise Exception(f"load_sst: {name} get")
+    res = r.execute_command("lrange", list_key, 0, -1)
+    if res != [f"e{i}" for i in range(seg_len)]:
+        print(len(res))
+        raise Exception(f"load_sst: {name} lrange")
+    res = r.execute_command("hgetall", hash_key)
+    if res != {f"f{i}": val_of(i) for i in range(100)}:
+        print(len(res))
+        raise Exception(f"load_sst: {name} hgetall")
+
+
+# ROCKEVICT replies ALREADY_WHOLE_ROCK_VAL for the keys loaded to RocksDB
+def cold_key_num():
+    cnt = 0
+    for i in range(key_num):
+        res = r.execute_command("rockevict", f"{key}{i}")
+        if res[1] == "ALREADY_WHOLE_ROCK_VAL":
+            cnt = cnt + 1
+    return cnt
+
+
+# the used memory is over maxrockmem during the load, so a part of the keys go to RocksDB
+def reload_and_check(load_sst):
+    r.execute_command("config", "set", "rock-load-sst", load_sst)
+    build_keys()
+    used = int(r.info("rock")["rock_evict_used_mem"])
+    old_maxrockmem = r.config_get("maxrockmem")["maxrockmem"]
+    r.execute_command("config", "set", "maxrockmem", used // 2)
+    try:
+        r.execute_command("debug", "reload")
+        if cold_key_num() == 0:
+            raise Exception(f"load_sst: rock-load-sst = {load_sst} no key loaded to RocksDB")
+    finally:
+        r.execute_command("config", "set", "maxrockmem", old_maxrockmem)
+    check_dataset(f"rock-load-sst = {load_sst}")
+
+    # the values are read back from RocksDB, do it again after eviction
+    r.execute_command("rockevict", list_key)
+    r.execute_command("rockevicthash", hash_key, "f1", "f2", "f3")
+    check_dataset(f"after eviction rock-load-sst = {load_sst}")
+    del_keys()
+
+
+def test_all():
+    old_entries = set_segment_entries(seg_entries)
+    reload_and_check("yes")
+    reload_and_check("no")
+    r.execute_command("config", "set", "rock-load-sst", "yes")
+    set_segment_entries(old_entries)
+
+
+def _main():
+    cnt = 0
+    while (1):
+        test_all()
+        cnt = cnt + 1
+        if cnt % 10 == 0:
+            print(f"test load sst OK cnt = {cnt}")
+
+
+if __name__ == '__main__':
+    _main()
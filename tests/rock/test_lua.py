@@ -35,9 +35,46 @@ def lua():
         raise Exception("lua")
 
 
+many_cnt = 200
+
+
+def init_many():
+    keys = []
+    for i in range(0, many_cnt):
+        k = key + "_many_" + str(i)
+        r.execute_command("set", k, "val_" + str(i))
+        keys.append(k)
+    rock_evict(*keys)
+
+
+def lua_many():
+    # the first half keys are declared in KEYS which will be recovered
+    # before the script runs, the other half are not declared
+    # which will be recovered when the script calls the command
+    mylua = """
+    local res = {}
+    for i = 1, #KEYS do
+        res[#res+1] = redis.call("get", KEYS[i])
+    end
+    local cnt = tonumber(ARGV[1])
+    for i = #KEYS, cnt-1 do
+        res[#res+1] = redis.call("get", ARGV[2] .. i)
+    end
+    return res
+    """
+    declared = [key + "_many_" + str(i) for i in range(0, many_cnt // 2)]
+    cmd = r.register_script(mylua)
+    res = cmd(keys=declared, args=[many_cnt, key + "_many_"])
+    if res != ["val_" + str(i) for i in range(0, many_cnt)]:
+        print(res)
+        raise Exception("lua_many")
+
+
 def test_all():
     init()
     lua()
+    init_many()
+    lua_many()
 
 
 def _main():
@@ -22,10 +22,35 @@ def hexists(key):
          raise Exception("hexists fail")
 
 
+# a hash read back from RocksDB and not modified is evicted again without writing RocksDB,
+# and it must be written again after HSET makes it dirty
+def hash_clean_and_dirty(key):
+    r.execute_command("del", key)
+    r.hset(key, "field1", "foo")
+    rock_evict(key)
+    if r.hget(key, "field1") != "foo":
+        raise Exception("hash_clean_and_dirty fail")
+    clean = int(r.info("rock")["rock_write_clean_evictions"])
+    rock_evict(key)
+    if int(r.info("rock")["rock_write_clean_evictions"]) != clean + 1:
+        raise Exception("hash_clean_and_dirty fail2")
+    if r.hget(key, "field1") != "foo":
+        raise Exception("hash_clean_and_dirty fail3")
+    r.hset(key, "field2", "bar")
+    rock_evict(key)
+    if int(r.info("rock")["rock_write_clean_evictions"]) != clean + 1:
+        raise Exception("hash_clean_and_dirty fail4")
+    res = r.hgetall(key)
+    if res != {"field1": "foo", "field2": "bar"}:
+        print(res)
+        raise Exception("hash_clean_and_dirty fail5")
+
+
 def _main(key):
     cnt = 0
     while (1):
         hexists(key)
+        hash_clean_and_dirty(key)
         cnt = cnt + 1
         if cnt % 1000 == 0:
             print(f"test str OK cnt = {cnt}")
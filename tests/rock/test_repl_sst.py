@@ -0,0 +1,104 @@
+from conn import r, rock_evict, rock_evict_hash, redis_ip, redis_port, seg_entries, set_segment_entries
+import redis
+import time
+
+
+# RedRock replica which has the capability of rock-sst-v2
+replica_port = 6380
+# real redis 6.2 replica which does not have the capability, so the master sends plain values
+plain_replica_port = 6381
+
+key = "_test_repl_sst_"
+list_key = "_test_repl_sst_list_"
+hash_key = "_test_repl_sst_hash_"
+list_len = 10000
+
+
+def make_client(port):
+    pool = redis.ConnectionPool(host=redis_ip,
+                                port=port,
+                                db=0,
+                                decode_responses=True,
+                                encoding='utf-8',
+                                socket_connect_timeout=2)
+    return redis.StrictRedis(connection_pool=pool)
+
+
+def build_cold_keys():
+    r.execute_command("del", key, list_key, hash_key)
+    r.execute_command("set", key, "repl_val" * 100)
+    # more than rock-segment-entries (seg_entries in conn.py) for the segments in RocksDB
+    r.execute_command("rpush", list_key, *[f"e{i}" for i in range(list_len)])
+    # assume a hash more than 4 fields will be in a rock hash (check test_rock_hash.py)
+    r.execute_command("hset", hash_key, "f1", "v1", "f2", "v2", "f3", "v3", "f4", "v4", "f5", "v5", "f6", "v6")
+    rock_evict(key, list_key)
+    rock_evict_hash(hash_key, "f1", "f2", "f3")
+
+
+def full_sync(replica):
+    replica.execute_command("replicaof", "no", "one")
+    replica.execute_command("flushall")
+    replica.execute_command("replicaof", redis_ip, redis_port)
+    for _ in range(100):
+        time.sleep(0.1)
+        info = replica.info("replication")
+        if info["master_link_status"] == "up" and info["master_sync_in_progress"] == 0:
+            return
+    raise Exception("repl_sst: full sync timeout")
+
+
+def check_dataset(replica, name):
+    res = replica.execute_command("get", key)
+    if res != "repl_val" * 100:
+        print(res)
+        raise Exception(f"repl_sst: {name} get")
+    res = replica.execute_command("lrange", list_key, 0, -1)
+    if res != [f"e{i}" for i in range(list_len)]:
+        print(len(res))
+        raise Exception(f"repl_sst: {name} lrange")
+    res = replica.execute_command("hgetall", hash_key)
+    if res != {"f1": "v1", "f2": "v2", "f3": "v3", "f4": "v4", "f5": "v5", "f6": "v6"}:
+        print(res)
+        raise Exception(f"repl_sst: {name} hgetall")
+
+
+def sync_and_check(repl_sst):
+    r.execute_command("config", "set", "rock-repl-sst", repl_sst)
+    build_cold_keys()
+
+    # the cold keys are sent as ROCK_COLD keys and ROCK_ROW rows to RedRock replica
+    replica = make_client(replica_port)
+    full_sync(replica)
+    check_dataset(replica, f"replica rock-repl-sst = {repl_sst}")
+    # the values are read back from RocksDB of replica, do it again after eviction
+    replica.execute_command("replicaof", "no", "one")
+    replica.execute_command("rockevict", key, list_key)
+    replica.execute_command("rockevicthash", hash_key, "f4", "f5")
+    check_dataset(replica, f"replica after eviction rock-repl-sst = {repl_sst}")
+
+    # the replica without rock-sst-v2 always gets the plain values
+    plain_replica = make_client(plain_replica_port)
+    full_sync(plain_replica)
+    check_dataset(plain_replica, f"plain replica rock-repl-sst = {repl_sst}")
+    plain_replica.execute_command("replicaof", "no", "one")
+
+
+def test_all():
+    old_entries = set_segment_entries(seg_entries)
+    sync_and_check("yes")
+    sync_and_check("no")
+    r.execute_command("config", "set", "rock-repl-sst", "yes")
+    set_segment_entries(old_entries)
+
+
+def _main():
+    cnt = 0
+    while (1):
+        test_all()
+        cnt = cnt + 1
+        if cnt % 10 == 0:
+            print(f"test repl sst OK cnt = {cnt}")
+
+
+if __name__ == '__main__':
+    _main()
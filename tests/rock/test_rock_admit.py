@@ -0,0 +1,126 @@
+from conn import r, rock_evict, is_cold
+import os
+
+
+# the admission of cold reads under memory pressure (check rock_admit.c)
+key_prefix = "_test_rock_admit_"
+val = "admit_val" * 100
+
+
+def admit_stat(name):
+    return int(r.info("rock")[name])
+
+
+# the used memory is about 95% of maxrockmem, 
+# i.e., over rock-evict-low-watermark (default 90) but under rock-evict-high-watermark (default 100),
+# so it is under pressure but the eviction does not start
+def set_pressure():
+    old = r.config_get("maxrockmem")["maxrockmem"]
+    used = admit_stat("rock_evict_used_mem")
+    r.execute_command("config", "set", "maxrockmem", used * 100 // 95)
+    return old
+
+
+# a new key every time, because the frequency of the sketch is kept across the tests
+def build_cold_key():
+    key = key_prefix + os.urandom(8).hex()
+    r.execute_command("set", key, val)
+    rock_evict(key)
+    if not is_cold(key):
+        raise Exception("rock_admit: not evicted")
+    return key
+
+
+# ROCKEVICT of a key in memory writes it to RocksDB, so it is the check for a key not demoted
+def is_in_memory(key):
+    res = r.execute_command("rockevict", key)
+    return res[1] == "CAN_EVICT_AND_WRITTEN_TO_ROCKSDB"
+
+
+# a rarely read cold value is demoted after the command
+def demote():
+    key = build_cold_key()
+    not_admitted = admit_stat("rock_admit_not_admitted")
+    demoted = admit_stat("rock_admit_demoted")
+    res = r.execute_command("get", key)
+    if res != val:
+        print(res)
+        raise Exception("rock_admit: get of demotion")
+    if admit_stat("rock_admit_not_admitted") != not_admitted + 1:
+        raise Exception("rock_admit: admitted")
+    if admit_stat("rock_admit_demoted") != demoted + 1:
+        raise Exception("rock_admit: not demoted")
+    if not is_cold(key):
+        raise Exception("rock_admit: not cold after demotion")
+    r.execute_command("del", key)
+
+
+# a frequently read cold value is admitted and stays in memory
+def admit():
+    key = build_cold_key()
+    for _ in range(3):
+        res = r.execute_command("get", key)
+        if res != val:
+            print(res)
+            raise Exception("rock_admit: get of admission")
+    admitted = admit_stat("rock_admit_admitted")
+    rock_evict(key)
+    r.execute_command("get", key)
+    if admit_stat("rock_admit_admitted") != admitted + 1:
+        raise Exception("rock_admit: not admitted")
+    if not is_in_memory(key):
+        raise Exception("rock_admit: not in memory after admission")
+    r.execute_command("del", key)
+
+
+# a modified value is not clean and stays in memory even if it is not admitted
+def modified():
+    key = build_cold_key()
+    res = r.execute_command("append", key, "_append")
+    if res != len(val) + len("_append"):
+        print(res)
+        raise Exception("rock_admit: append")
+    if not is_in_memory(key):
+        raise Exception("rock_admit: modified value demoted")
+    res = r.execute_command("get", key)
+    if res != val + "_append":
+        print(res)
+        raise Exception("rock_admit: get after append")
+    r.execute_command("del", key)
+
+
+# no pressure, every cold read is admitted
+def no_pressure(old_maxrockmem):
+    r.execute_command("config", "set", "maxrockmem", old_maxrockmem)
+    key = build_cold_key()
+    not_admitted = admit_stat("rock_admit_not_admitted")
+    r.execute_command("get", key)
+    if admit_stat("rock_admit_not_admitted") != not_admitted:
+        raise Exception("rock_admit: not admitted without pressure")
+    if not is_in_memory(key):
+        raise Exception("rock_admit: not in memory without pressure")
+    r.execute_command("del", key)
+
+
+def test_all():
+    old_maxrockmem = set_pressure()
+    try:
+        demote()
+        admit()
+        modified()
+    finally:
+        r.execute_command("config", "set", "maxrockmem", old_maxrockmem)
+    no_pressure(old_maxrockmem)
+
+
+def _main():
+    cnt = 0
+    while (1):
+        test_all()
+        cnt = cnt + 1
+        if cnt % 10 == 0:
+            print(f"test rock admit OK cnt = {cnt}")
+
+
+if __name__ == '__main__':
+    _main()
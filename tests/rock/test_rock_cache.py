@@ -0,0 +1,107 @@
+from conn import r, rock_evict, is_cold
+import os
+import time
+
+
+# the compressed cache of the values in RocksDB (check rock_cache.c)
+key = "_test_rock_cache_"
+other_key = "_test_rock_cache_other_"
+key_num = 50
+
+
+def cache_stat(name):
+    return int(r.info("rock")[name])
+
+
+# the value random enough for LZF
+def random_val():
+    return os.urandom(1000).hex()
+
+
+# the cache gets the value when the main thread reclaims the written slot of ring buffer,
+# which happens on the next append to the ring buffer
+def evict_to_cache(*keys):
+    rock_evict(*keys)
+    time.sleep(0.1)     # wait for write thread
+    r.execute_command("set", other_key, random_val())
+    rock_evict(other_key)
+
+
+def hit():
+    r.execute_command("config", "set", "rock-cache-size", "64mb")
+    val = random_val()
+    r.execute_command("set", key, val)
+    puts = cache_stat("rock_cache_puts")
+    evict_to_cache(key)
+    if cache_stat("rock_cache_puts") <= puts:
+        raise Exception("rock_cache: not put")
+    if not is_cold(key):
+        raise Exception("rock_cache: not evicted")
+
+    hits = cache_stat("rock_cache_hits")
+    res = r.execute_command("get", key)
+    if res != val:
+        print(res)
+        raise Exception("rock_cache: get of hit")
+    if cache_stat("rock_cache_hits") != hits + 1:
+        raise Exception("rock_cache: not hit")
+
+
+# the values (about 2KB each, less than 1/8 of the limit) are over the limit of the cache
+# and the least recently used values go,
+# then the reads of them miss the cache and go to RocksDB
+def eviction():
+    r.execute_command("config", "set", "rock-cache-size", "64kb")
+    vals = [random_val() for _ in range(key_num)]
+    for i in range(key_num):
+        r.execute_command("set", f"{key}{i}", vals[i])
+    evicted = cache_stat("rock_cache_evicted")
+    evict_to_cache(*[f"{key}{i}" for i in range(key_num)])
+    if cache_stat("rock_cache_evicted") <= evicted:
+        raise Exception("rock_cache: no eviction")
+    if cache_stat("rock_cache_used_memory") > 64 * 1024:
+        raise Exception("rock_cache: over the limit")
+
+    misses = cache_stat("rock_cache_misses")
+    for i in range(key_num):
+        res = r.execute_command("get", f"{key}{i}")
+        if res != vals[i]:
+            print(res)
+            raise Exception("rock_cache: get after eviction")
+    if cache_stat("rock_cache_misses") <= misses:
+        raise Exception("rock_cache: no miss")
+
+
+# changing a cold key drops the stale entry of the cache
+def overwrite():
+    r.execute_command("config", "set", "rock-cache-size", "64mb")
+    r.execute_command("set", key, random_val())
+    evict_to_cache(key)
+    val = random_val()
+    r.execute_command("set", key, val)
+    evict_to_cache(key)
+    res = r.execute_command("get", key)
+    if res != val:
+        print(res)
+        raise Exception("rock_cache: get after overwrite")
+
+
+def test_all():
+    hit()
+    eviction()
+    overwrite()
+    r.execute_command("config", "set", "rock-cache-size", 0)
+    r.execute_command("del", key, other_key, *[f"{key}{i}" for i in range(key_num)])
+
+
+def _main():
+    cnt = 0
+    while (1):
+        test_all()
+        cnt = cnt + 1
+        if cnt % 10 == 0:
+            print(f"test rock cache OK cnt = {cnt}")
+
+
+if __name__ == '__main__':
+    _main()
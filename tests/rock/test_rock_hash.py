@@ -1,5 +1,6 @@
 from conn import r, rock_evict_hash
 import redis
+import time
 
 
 key = "_test_rock_hash2_"
@@ -117,6 +118,33 @@ def hmget():
         raise Exception("rock_hash: hmget")
 
 
+def hmget_dup_fields():
+    # more than 32 (HASH_SCAN_MIN_FIELDS in rock_read.c) cold fields for the scan of the whole hash
+    field_num = 64
+    cold_num = 40
+    r.execute_command("del", key)
+    for i in range(field_num):
+        r.execute_command("hset", key, f"g{i}", f"v{i}")
+    rock_evict_hash(key, *[f"g{i}" for i in range(cold_num)])
+    time.sleep(1)   # the rows are written to RocksDB
+
+    # the newer value of the last cold field is still in the write ring buffer
+    last = f"g{cold_num-1}"
+    r.execute_command("hset", key, last, "new_val")
+    rock_evict_hash(key, last)
+
+    # the repeated field makes the number the same as the cold fields, but the last one is not needed
+    fields = [f"g{i}" for i in range(cold_num-1)] + ["g0"]
+    res = r.execute_command("hmget", key, *fields)
+    if res != [f"v{i}" for i in range(cold_num-1)] + ["v0"]:
+        print(res)
+        raise Exception("rock_hash: hmget dup fields")
+    res = r.execute_command("hget", key, last)
+    if res != "new_val":
+        print(res)
+        raise Exception("rock_hash: hmget dup fields, the field in ring buffer")
+
+
 def hmset():
     build_rock_hash(key)
     rock_evict_hash(key, "f1", "f2")
@@ -203,6 +231,7 @@ def test_all():
     hkeys()
     hlen()
     hmget()
+    hmget_dup_fields()
     hmset()
     hset()
     hsetnx()
@@ -0,0 +1,119 @@
+from conn import r
+import redis
+import time
+
+
+# the eviction between rock-evict-high-watermark and rock-evict-low-watermark (check rock_evict.c)
+key = "_test_rock_watermark_"
+key_num = 5000
+val = "watermark_val" * 100
+
+
+def evict_stat(name):
+    return int(r.info("rock")[name])
+
+
+def freed():
+    return evict_stat("rock_evict_freed_in_cron") + evict_stat("rock_evict_freed_before_sleep")
+
+
+def build_keys():
+    for i in range(key_num):
+        r.execute_command("set", f"{key}{i}", val)
+
+
+def del_keys():
+    for i in range(key_num):
+        r.execute_command("del", f"{key}{i}")
+
+
+# set maxrockmem for the used memory to be the percent of it
+def set_used_percent(percent):
+    used = evict_stat("rock_evict_used_mem")
+    r.execute_command("config", "set", "maxrockmem", used * 100 // percent)
+
+
+# between the watermarks, the eviction does not start
+def not_start():
+    set_used_percent(93)
+    before = freed()
+    time.sleep(1)
+    if evict_stat("rock_evict_active") != 0:
+        raise Exception("watermark: active under high watermark")
+    if freed() != before:
+        raise Exception("watermark: evicted under high watermark")
+
+
+# over the high watermark, the eviction goes on until under the low watermark
+def evict_to_low():
+    set_used_percent(97)
+    before = freed()
+    for _ in range(50):
+        time.sleep(0.1)
+        if evict_stat("rock_evict_active") == 0 and freed() > before:
+            break
+    if freed() <= before:
+        raise Exception("watermark: no eviction over high watermark")
+    if evict_stat("rock_evict_active") != 0:
+        raise Exception("watermark: still active")
+    used = evict_stat("rock_evict_used_mem")
+    low = evict_stat("rock_evict_low_watermark")
+    if used > low:
+        print(used, low)
+        raise Exception("watermark: not under low watermark")
+
+    # the values are intact
+    for i in range(0, key_num, 100):
+        res = r.execute_command("get", f"{key}{i}")
+        if res != val:
+            print(res)
+            raise Exception("watermark: get after eviction")
+
+
+# the low watermark must be less than the high watermark
+def invalid_config():
+    try:
+        r.execute_command("config", "set", "rock-evict-low-watermark", 95)
+    except redis.exceptions.ResponseError:
+        pass
+    else:
+        raise Exception("watermark: low >= high accepted")
+    try:
+        r.execute_command("config", "set", "rock-evict-high-watermark", 90)
+    except redis.exceptions.ResponseError:
+        pass
+    else:
+        raise Exception("watermark: high <= low accepted")
+
+
+def test_all():
+    old_maxrockmem = r.config_get("maxrockmem")["maxrockmem"]
+    old_low = r.config_get("rock-evict-low-watermark")["rock-evict-low-watermark"]
+    old_high = r.config_get("rock-evict-high-watermark")["rock-evict-high-watermark"]
+    r.execute_command("config", "set", "rock-evict-high-watermark", 100)
+    r.execute_command("config", "set", "rock-evict-low-watermark", 90)
+    r.execute_command("config", "set", "rock-evict-high-watermark", 95)
+    build_keys()
+    try:
+        not_start()
+        evict_to_low()
+        invalid_config()
+    finally:
+        r.execute_command("config", "set", "maxrockmem", old_maxrockmem)
+        r.execute_command("config", "set", "rock-evict-high-watermark", 100)
+        r.execute_command("config", "set", "rock-evict-low-watermark", old_low)
+        r.execute_command("config", "set", "rock-evict-high-watermark", old_high)
+    del_keys()
+
+
+def _main():
+    cnt = 0
+    while (1):
+        test_all()
+        cnt = cnt + 1
+        if cnt % 10 == 0:
+            print(f"test rock watermark OK cnt = {cnt}")
+
+
+if __name__ == '__main__':
+    _main()
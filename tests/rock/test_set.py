@@ -1,4 +1,4 @@
-from conn import r, rock_evict
+from conn import r, rock_evict, seg_entries, seg_len, set_segment_entries, rock_write_tombstones
 
 
 key = "_test_rock_set_"
@@ -242,6 +242,39 @@ def suionstore():
         raise Exception("suionstore fail")
 
 
+def segments():
+    old_entries = set_segment_entries(seg_entries)
+    r.execute_command("del", key)
+    members = {f"seg{i}" for i in range(seg_len)}
+    r.sadd(key, *members)
+    rock_evict(key)
+    res = r.smembers(key)
+    if res != members:
+        print(len(res))
+        raise Exception("segments fail")
+    # partial overwrite, then evict again
+    r.srem(key, "seg0", "seg1")
+    r.sadd(key, "new0", "new1")
+    members = (members - {"seg0", "seg1"}) | {"new0", "new1"}
+    rock_evict(key)
+    res = r.smembers(key)
+    if res != members:
+        print(len(res))
+        raise Exception("segments fail2")
+    # delete a segmented key, one tombstone for the head and one for all segments
+    tombstones = rock_write_tombstones()
+    r.execute_command("del", key)
+    if rock_write_tombstones() != tombstones + 2:
+        raise Exception("segments fail3")
+    r.sadd(key, "a")
+    rock_evict(key)
+    res = r.smembers(key)
+    if res != {"a"}:
+        print(res)
+        raise Exception("segments fail4")
+    set_segment_entries(old_entries)
+
+
 def test_all():
     sadd()
     sadd_int()
@@ -259,6 +292,7 @@ def test_all():
     srem()
     suion()
     suionstore()
+    segments()
 
 
 def _main():
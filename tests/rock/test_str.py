@@ -268,6 +268,53 @@ def strlen():
         raise Exception("strlen fail")
 
 
+def rock_write_stat(name):
+    return int(r.info("rock")[name])
+
+
+# a key read back from RocksDB and not modified is evicted again without writing RocksDB,
+# and it must be written again after it is modified
+def evict_clean_and_dirty():
+    val = "clean_val" * 100
+    r.set(key, val)
+    rock_evict(key)
+    time.sleep(0.1)     # wait for write thread
+    check = r.get(key)
+    if check != val:
+        print(check)
+        raise Exception("evict_clean_and_dirty fail")
+    clean = rock_write_stat("rock_write_clean_evictions")
+    written = rock_write_stat("rock_write_keys")
+    rock_evict(key)
+    if rock_write_stat("rock_write_clean_evictions") != clean + 1:
+        raise Exception("evict_clean_and_dirty fail2")
+    time.sleep(0.1)
+    if rock_write_stat("rock_write_keys") != written:
+        raise Exception("evict_clean_and_dirty fail3")
+    check = r.get(key)
+    if check != val:
+        print(check)
+        raise Exception("evict_clean_and_dirty fail4")
+    # dirty after clean
+    r.append(key, "_dirty")
+    rock_evict(key)
+    if rock_write_stat("rock_write_clean_evictions") != clean + 1:
+        raise Exception("evict_clean_and_dirty fail5")
+    time.sleep(0.1)
+    if rock_write_stat("rock_write_keys") != written + 1:
+        raise Exception("evict_clean_and_dirty fail6")
+    check = r.get(key)
+    if check != val + "_dirty":
+        print(check)
+        raise Exception("evict_clean_and_dirty fail7")
+    # clean again after read back
+    rock_evict(key)
+    check = r.get(key)
+    if check != val + "_dirty":
+        print(check)
+        raise Exception("evict_clean_and_dirty fail8")
+
+
 def test_all():
     append()
     append_long_str()
@@ -287,6 +334,7 @@ def test_all():
     setex()
     setrange()
     strlen()
+    evict_clean_and_dirty()
 
 
 def _main():
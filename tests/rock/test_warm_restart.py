@@ -0,0 +1,163 @@
+import os
+import redis
+import shutil
+import subprocess
+import time
+
+
+# The test starts and shuts down its own RedRock with rock-warm-restart (check rock_warm.c),
+# so run it on the machine of the binary
+redis_server = "../../src/redis-server"
+warm_port = 6390
+work_dir = "/tmp/_test_warm_restart_"
+log_file = f"{work_dir}/redrock.log"
+manifest_path = f"{work_dir}/rocksdb{warm_port}.manifest"
+rdb_path = f"{work_dir}/dump.rdb"
+
+key = "_test_warm_restart_"
+hash_key = "_test_warm_restart_hash_"
+key_num = 100
+
+
+# the log is truncated for each start
+def start_server():
+    open(log_file, "w").close()
+    proc = subprocess.Popen([redis_server,
+                             "--port", str(warm_port),
+                             "--dir", work_dir,
+                             "--dbfilename", "dump.rdb",
+                             "--logfile", log_file,
+                             "--rocksdb_folder", work_dir,
+                             "--rock-warm-restart", "yes"])
+    c = redis.StrictRedis(host="127.0.0.1", port=warm_port, db=0, decode_responses=True, encoding='utf-8')
+    for _ in range(100):
+        time.sleep(0.1)
+        try:
+            if c.ping():
+                return proc, c
+        except redis.exceptions.ConnectionError:
+            pass
+        except redis.exceptions.BusyLoadingError:
+            pass
+    proc.kill()
+    raise Exception("warm_restart: server not started")
+
+
+def shutdown_server(proc, c):
+    try:
+        c.execute_command("shutdown", "save")
+    except redis.exceptions.ConnectionError:
+        pass
+    proc.wait(timeout=60)
+
+
+def log_has(text):
+    with open(log_file) as f:
+        return text in f.read()
+
+
+def build_cold_keys(c):
+    for i in range(key_num):
+        c.execute_command("set", f"{key}{i}", f"val{i}" * 100)
+        c.execute_command("rockevict", f"{key}{i}")
+    # assume a hash more than 4 fields will be in a rock hash (check test_rock_hash.py)
+    c.execute_command("hset", hash_key, "f1", "v1", "f2", "v2", "f3", "v3", "f4", "v4", "f5", "v5", "f6", "v6")
+    c.execute_command("rockevicthash", hash_key, "f1", "f2", "f3")
+
+
+def check_dataset(c, name):
+    for i in range(key_num):
+        res = c.execute_command("get", f"{key}{i}")
+        if res != f"val{i}" * 100:
+            print(res)
+            raise Exception(f"warm_restart: {name} get")
+    res = c.execute_command("hgetall", hash_key)
+    if res != {"f1": "v1", "f2": "v2", "f3": "v3", "f4": "v4", "f5": "v5", "f6": "v6"}:
+        print(res)
+        raise Exception(f"warm_restart: {name} hgetall")
+
+
+# the keys in the manifest are loaded as cold keys without writing to RocksDB again
+def valid_manifest():
+    proc, c = start_server()
+    build_cold_keys(c)
+    shutdown_server(proc, c)
+    if not os.path.exists(manifest_path):
+        raise Exception("warm_restart: no manifest after shutdown")
+
+    proc, c = start_server()
+    if not log_has("reuse the data in RocksDB"):
+        raise Exception("warm_restart: valid manifest not used")
+    if os.path.exists(manifest_path):
+        raise Exception("warm_restart: manifest not removed after load")
+    res = c.execute_command("rockevict", f"{key}0")
+    if res[1] != "ALREADY_WHOLE_ROCK_VAL":
+        print(res)
+        raise Exception("warm_restart: key not cold after warm restart")
+    check_dataset(c, "valid manifest")
+    shutdown_server(proc, c)
+
+
+# the token of the RDB does not match the manifest, the stale data in RocksDB is purged
+def wrong_token():
+    proc, c = start_server()
+    build_cold_keys(c)
+    shutdown_server(proc, c)
+    shutil.copy(manifest_path, f"{manifest_path}.old")
+
+    # another clean shutdown gives the RDB a new token
+    proc, c = start_server()
+    shutdown_server(proc, c)
+    shutil.move(f"{manifest_path}.old", manifest_path)
+
+    proc, c = start_server()
+    if not log_has("no RDB matches the manifest") or not log_has("start RocksDB purge job"):
+        raise Exception("warm_restart: wrong token not purged")
+    check_dataset(c, "wrong token")
+    shutdown_server(proc, c)
+
+
+# the RDB of BGSAVE has no token, the stale data in RocksDB is purged
+def missing_token():
+    proc, c = start_server()
+    build_cold_keys(c)
+    c.execute_command("bgsave")
+    for _ in range(100):
+        time.sleep(0.1)
+        if c.info("persistence")["rdb_bgsave_in_progress"] == 0:
+            break
+    shutil.copy(rdb_path, f"{rdb_path}.bgsave")
+    shutdown_server(proc, c)
+    shutil.move(f"{rdb_path}.bgsave", rdb_path)
+
+    proc, c = start_server()
+    if not log_has("no RDB matches the manifest") or not log_has("start RocksDB purge job"):
+        raise Exception("warm_restart: missing token not purged")
+    check_dataset(c, "missing token")
+    shutdown_server(proc, c)
+
+
+def run_case(case):
+    shutil.rmtree(work_dir, ignore_errors=True)
+    os.makedirs(work_dir)
+    case()
+
+
+def test_all():
+    run_case(valid_manifest)
+    run_case(wrong_token)
+    run_case(missing_token)
+    shutil.rmtree(work_dir, ignore_errors=True)
+
+
+def _main():
+    cnt = 0
+    while (1):
+        test_all()
+        cnt = cnt + 1
+        if cnt % 10 == 0:
+            print(f"test warm restart OK cnt = {cnt}")
+
+
+if __name__ == '__main__':
+    _main()
@@ -1,4 +1,4 @@
-from conn import r, rock_evict
+from conn import r, rock_evict, seg_entries, seg_len, set_segment_entries, rock_write_tombstones
 
 
 key = "_test_rock_zset_"
@@ -399,6 +399,37 @@ def bzpopmax():
         raise Exception("bzpopmin fail")
 
 
+def segments():
+    old_entries = set_segment_entries(seg_entries)
+    r.execute_command("del", key)
+    mapping = {f"seg{i}": i for i in range(seg_len)}
+    r.zadd(key, mapping)
+    rock_evict(key)
+    res = r.zrange(key, 0, -1, withscores=True)
+    if res != [(f"seg{i}", float(i)) for i in range(seg_len)]:
+        print(len(res))
+        raise Exception("segments fail")
+    # partial overwrite (the score moves the member to another segment), then evict again
+    r.zadd(key, {"seg0": seg_len})
+    rock_evict(key)
+    res = r.zrange(key, 0, -1, withscores=True)
+    if res != [(f"seg{i}", float(i)) for i in range(1, seg_len)] + [("seg0", float(seg_len))]:
+        print(len(res))
+        raise Exception("segments fail2")
+    # delete a segmented key, one tombstone for the head and one for all segments
+    tombstones = rock_write_tombstones()
+    r.execute_command("del", key)
+    if rock_write_tombstones() != tombstones + 2:
+        raise Exception("segments fail3")
+    r.zadd(key, {"a": 1})
+    rock_evict(key)
+    res = r.zrange(key, 0, -1, withscores=True)
+    if res != [("a", 1.0)]:
+        print(res)
+        raise Exception("segments fail4")
+    set_segment_entries(old_entries)
+
+
 def test_all():
     zadd()
     zcard()
@@ -430,6 +461,7 @@ def test_all():
     zunionstore()
     bzpopmin()
     bzpopmax()
+    segments()
 
 
 def _main():